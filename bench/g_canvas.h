@@ -0,0 +1,26 @@
+// Stand-in for Pd's g_canvas.h: only the line traverser, which the classes use
+// to see which of their signal inlets are connected (src/connect.c). In the
+// harness the "canvas" is a flat list of connections made with
+// stub_connect_signal().
+
+#ifndef __g_canvas_h_
+#define __g_canvas_h_
+
+#include "m_pd.h"
+
+typedef struct _outconnect t_outconnect;
+
+typedef struct _linetraverser
+{
+  t_canvas *tr_x;
+  t_object *tr_ob;
+  int tr_outno;
+  t_object *tr_ob2;
+  int tr_inno;
+  t_outconnect *tr_nextoc;
+} t_linetraverser;
+
+EXTERN void linetraverser_start(t_linetraverser *t, t_canvas *x);
+EXTERN t_outconnect *linetraverser_next(t_linetraverser *t);
+
+#endif // __g_canvas_h_
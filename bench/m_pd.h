@@ -0,0 +1,172 @@
+// Minimal stand-in for Pure Data's m_pd.h, used only by the headless benchmark
+// in this directory. It declares just enough of the Pd API for the classes in
+// `src/` to compile unchanged and be driven without a running Pd. The layouts
+// below are NOT binary compatible with Pd; never build the real externals
+// against this header.
+
+#ifndef __m_pd_h_
+
+#define __m_pd_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <endian.h>
+
+#define PD_MAJOR_VERSION 0
+#define PD_MINOR_VERSION 54
+#define PD_BUGFIX_VERSION 0
+
+#define EXTERN extern
+
+#define MAXPDSTRING 1000
+#define MAXPDARG 5
+
+typedef intptr_t t_int;
+typedef float t_float;
+typedef float t_floatarg;
+typedef float t_sample;
+
+typedef struct _symbol
+{
+  const char *s_name;
+  struct _class **s_thing; // what's bound to it; nothing, here
+  struct _symbol *s_next;
+} t_symbol;
+
+typedef struct _class t_class;
+typedef t_class *t_pd;
+
+typedef struct _gobj
+{
+  t_pd g_pd;
+} t_gobj;
+
+typedef struct _inlet t_inlet;
+typedef struct _outlet t_outlet;
+
+struct _glist;
+#define t_glist struct _glist
+#define t_canvas struct _glist
+
+typedef struct _text
+{
+  t_gobj te_g;
+} t_text;
+
+typedef struct _text t_object;
+
+#define ob_pd te_g.g_pd
+
+typedef enum
+{
+  A_NULL,
+  A_FLOAT,
+  A_SYMBOL,
+  A_POINTER,
+  A_SEMI,
+  A_COMMA,
+  A_DEFFLOAT,
+  A_DEFSYM,
+  A_DOLLAR,
+  A_DOLLSYM,
+  A_GIMME,
+  A_CANT
+} t_atomtype;
+
+#define A_DEFSYMBOL A_DEFSYM
+
+typedef union word
+{
+  t_float w_float;
+  t_symbol *w_symbol;
+  int w_index;
+} t_word;
+
+typedef struct _atom
+{
+  t_atomtype a_type;
+  union word a_w;
+} t_atom;
+
+typedef void (*t_method)(void);
+typedef void *(*t_newmethod)(void);
+typedef t_int *(*t_perfroutine)(t_int *args);
+
+typedef struct _signal
+{
+  int s_n;
+  t_sample *s_vec;
+  t_float s_sr;
+  int s_nchans;
+  int s_length;
+  int s_nalloc; // room in s_vec, in samples (the shim's own)
+} t_signal;
+
+#define CLASS_DEFAULT 0
+#define CLASS_PD 1
+#define CLASS_GOBJ 2
+#define CLASS_PATCHABLE 3
+#define CLASS_NOINLET 8
+#define CLASS_MULTICHANNEL 0x10
+
+EXTERN t_symbol s_signal;
+EXTERN t_symbol s_float;
+EXTERN t_symbol s_symbol;
+EXTERN t_symbol s_list;
+EXTERN t_symbol s_bang;
+EXTERN t_symbol s_;
+
+EXTERN t_symbol *gensym(const char *s);
+
+EXTERN t_class *class_new(t_symbol *name, t_newmethod newmethod,
+  t_method freemethod, size_t size, int flags, t_atomtype arg1, ...);
+EXTERN void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+  t_atomtype arg1, ...);
+EXTERN void class_domainsignalin(t_class *c, int onset);
+
+#define CLASS_MAINSIGNALIN(c, type, field) \
+  class_domainsignalin(c, (char *)(&((type *)0)->field) - (char *)0)
+
+EXTERN t_pd *pd_new(t_class *cls);
+EXTERN void pd_float(t_pd *x, t_float f);
+EXTERN void pd_list(t_pd *x, t_symbol *s, int argc, t_atom *argv);
+
+EXTERN t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1,
+  t_symbol *s2);
+EXTERN void inlet_free(t_inlet *x);
+EXTERN t_outlet *outlet_new(t_object *owner, t_symbol *s);
+EXTERN void outlet_free(t_outlet *x);
+EXTERN int obj_issignaloutlet(const t_object *x, int m);
+
+EXTERN t_glist *canvas_getcurrent(void);
+EXTERN void canvas_update_dsp(void);
+
+EXTERN void *getbytes(size_t nbytes);
+EXTERN void *resizebytes(void *old, size_t oldsize, size_t newsize);
+EXTERN void freebytes(void *x, size_t nbytes);
+
+EXTERN void post(const char *fmt, ...);
+EXTERN void pd_error(const void *object, const char *fmt, ...);
+EXTERN void logpost(const void *object, int level, const char *fmt, ...);
+
+#define SETFLOAT(atom, f) ((atom)->a_type = A_FLOAT, (atom)->a_w.w_float = (f))
+#define SETSYMBOL(atom, s) ((atom)->a_type = A_SYMBOL, \
+  (atom)->a_w.w_symbol = (s))
+
+EXTERN t_float atom_getfloatarg(int which, int argc, const t_atom *argv);
+EXTERN t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv);
+
+// arrays: only what's needed to read a float array's values
+typedef struct _garray t_garray;
+EXTERN t_class *garray_class;
+EXTERN t_pd *pd_findbyclass(t_symbol *s, const t_class *c);
+EXTERN int garray_getfloatwords(t_garray *x, int *size, t_word **vec);
+EXTERN void garray_usedindsp(t_garray *x);
+
+EXTERN double clock_getlogicaltime(void);
+EXTERN double clock_gettimesince(double prevsystime);
+
+EXTERN void dsp_add(t_perfroutine f, int n, ...);
+EXTERN void signal_setmultiout(t_signal **sig, int nchans);
+
+#endif // __m_pd_h_
@@ -0,0 +1,320 @@
+// Headless benchmark for the oscillator classes.
+//
+// Each class is compiled unchanged against the Pd shim in this directory
+// (m_pd.h + pd_stub.c). For every combination of block size and instance count
+// the harness creates that many objects, runs their "dsp" methods to collect
+// the perform routines they hand to dsp_add(), and then runs the chains back to
+// back the way Pd's scheduler does, timing the whole thing.
+//
+// Every instance gets its own input and output vectors and its own frequency
+// (log-spaced across 55 Hz - 3.5 kHz), so with enough instances the table
+// reads spread over the whole table and the working set grows like it does
+// in a real patch. That's what shows where e.g. the 64K-entry tables in
+// cubic_osc~ / fold_osc~ stop fitting in cache.
+//
+// Results are ns per output sample and cycles per output sample. On x86 the
+// cycle count comes from the TSC, which ticks at a fixed rate that may differ
+// from the actual core clock under turbo/powersave.
+//
+// By default nothing is connected to the objects' inlets, so the classes pick
+// the perform routines for float-only inlets (see src/connect.h); -s makes every
+// signal inlet look connected to measure the general routines instead.
+//
+// osc_bank~ has no inlets; each instance gets -v voices, all playing.
+//
+// -m "selector args..." sends a message to every instance before DSP starts,
+// e.g. -m "bandlimit 1" or -m "kernel sse2". Classes that don't know the message are skipped.
+//
+// usage: oscbench [-c class] [-b 64,256,...] [-i 1,10,...] [-r sr] [-t ms] [-s]
+//                 [-v voices] [-m message] [-csv]
+//
+// build with `make bench` from the repo root.
+
+#include "pd_stub.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static inline unsigned long long bench_cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLES 0
+static inline unsigned long long bench_cycles(void) { return 0; }
+#endif
+
+void triangle_tilde_setup(void);
+void simple_osc_tilde_setup(void);
+void cubic_osc_tilde_setup(void);
+void fold_osc_tilde_setup(void);
+void simple_phasor_tilde_setup(void);
+void tri_phase_tilde_setup(void);
+void tabfudge_osc_tilde_setup(void);
+void modern_osc_tilde_setup(void);
+void osc_bank_tilde_setup(void);
+void wave_osc_tilde_setup(void);
+void fm_op_tilde_setup(void);
+
+typedef struct _benchclass
+{
+  const char *name;
+  void (*setup)(void);
+  int phase_input; // main inlet takes a 0-1 phase rather than a frequency
+  int bank; // no inlets; created with -v voices, all set playing by message
+} t_benchclass;
+
+static t_benchclass classes[] = {
+  {"simple_osc~", simple_osc_tilde_setup, 0},
+  {"cubic_osc~", cubic_osc_tilde_setup, 0},
+  {"fold_osc~", fold_osc_tilde_setup, 0},
+  {"tabfudge_osc~", tabfudge_osc_tilde_setup, 0},
+  {"modern_osc~", modern_osc_tilde_setup, 0},
+  {"simple_phasor~", simple_phasor_tilde_setup, 0},
+  {"tri_phase~", tri_phase_tilde_setup, 0},
+  {"triangle~", triangle_tilde_setup, 1},
+  {"osc_bank~", osc_bank_tilde_setup, 0, 1},
+  {"wave_osc~", wave_osc_tilde_setup, 0},
+  {"fm_op~", fm_op_tilde_setup, 0},
+};
+
+#define NCLASSES (int)(sizeof(classes) / sizeof(classes[0]))
+#define MAXLIST 32
+
+typedef struct _instance
+{
+  t_pd *obj;
+  t_sample **ins;
+  t_sample **outs;
+  int nin;
+  int nout;
+  t_int *chain;
+} t_instance;
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int parse_list(const char *s, int *dest)
+{
+  int n = 0;
+  while (*s && n < MAXLIST) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || v <= 0) break;
+    dest[n++] = (int)v;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+// -s: pretend there's a signal connected to every signal inlet
+static int connect_inlets = 0;
+
+// -v: voices per osc_bank~
+static int bank_voices = 64;
+
+// -m: message for every instance, selector then floats or symbols
+#define MAXMSG 8
+static const char *msg_sel = NULL;
+static t_atom msg_args[MAXMSG];
+static int msg_argc = 0;
+
+static void parse_msg(char *s)
+{
+  msg_sel = strtok(s, " ");
+  for (char *tok; msg_argc < MAXMSG && (tok = strtok(NULL, " ")); msg_argc++) {
+    char *end;
+    double f = strtod(tok, &end);
+    if (*end) {
+      msg_args[msg_argc].a_type = A_SYMBOL;
+      msg_args[msg_argc].a_w.w_symbol = gensym(tok);
+    } else {
+      msg_args[msg_argc].a_type = A_FLOAT;
+      msg_args[msg_argc].a_w.w_float = (t_float)f;
+    }
+  }
+}
+
+static void bank_init(t_pd *obj, double freq)
+{
+  for (int v = 0; v < bank_voices; v++) {
+    t_atom a[3];
+    a[0].a_type = a[1].a_type = a[2].a_type = A_FLOAT;
+    a[0].a_w.w_float = v + 1;
+    a[1].a_w.w_float = (t_float)(freq * (1.0 + (double)v / bank_voices));
+    a[2].a_w.w_float = 1.0f / bank_voices;
+    stub_send(obj, "list", 3, a);
+  }
+}
+
+static t_sample *alloc_vec(int n)
+{
+  return (t_sample *)calloc(n, sizeof(t_sample));
+}
+
+static void instance_init(t_instance *inst, const t_benchclass *bc, int which,
+  int ninstances, int n, t_float sr)
+{
+  // log-spaced frequencies, so instances don't all read the same table lines
+  double freq = 55.0 * pow(64.0, (double)which / (ninstances > 1 ?
+    ninstances - 1 : 1));
+
+  if (bc->bank) {
+    t_atom arg;
+    arg.a_type = A_FLOAT;
+    arg.a_w.w_float = bank_voices;
+    inst->obj = stub_new(bc->name, 1, &arg);
+    bank_init(inst->obj, freq);
+  } else {
+    inst->obj = stub_new(bc->name, 0, NULL);
+  }
+  if (msg_sel) stub_send(inst->obj, msg_sel, msg_argc, msg_args);
+  inst->nin = stub_nsiginlets(inst->obj);
+  inst->nout = stub_nsigoutlets(inst->obj);
+  inst->ins = (t_sample **)calloc(inst->nin, sizeof(t_sample *));
+  inst->outs = (t_sample **)calloc(inst->nout, sizeof(t_sample *));
+
+  for (int i = 0; i < inst->nin; i++) {
+    inst->ins[i] = alloc_vec(n);
+    if (i == 0 && bc->phase_input) {
+      // one block of ramp; the wrap at the block boundary doesn't matter here
+      double ph = (double)which / ninstances;
+      for (int j = 0; j < n; j++) {
+        inst->ins[i][j] = (t_sample)ph;
+        ph += freq / sr;
+        ph -= floor(ph);
+      }
+    } else {
+      // what Pd copies into an unconnected signal inlet every block
+      t_float f = i == 0 ? (t_float)freq : stub_inlet_scalar(inst->obj, i);
+      for (int j = 0; j < n; j++) inst->ins[i][j] = f;
+    }
+  }
+  for (int i = 0; i < inst->nout; i++) inst->outs[i] = alloc_vec(n);
+
+  if (connect_inlets) {
+    for (int i = 0; i < inst->nin; i++) {
+      stub_connect_signal(inst->obj, stub_siginlet(inst->obj, i));
+    }
+  }
+
+  inst->chain = stub_dsp(inst->obj, sr, n, inst->ins, inst->outs);
+}
+
+static void instance_free(t_instance *inst)
+{
+  stub_freechain(inst->chain);
+  stub_free(inst->obj);
+  for (int i = 0; i < inst->nin; i++) free(inst->ins[i]);
+  for (int i = 0; i < inst->nout; i++) free(inst->outs[i]);
+  free(inst->ins);
+  free(inst->outs);
+}
+
+static void run_config(const t_benchclass *bc, int n, int ninstances,
+  t_float sr, double min_ns, int csv)
+{
+  t_instance *insts = (t_instance *)calloc(ninstances, sizeof(t_instance));
+  long passes = 0;
+  double t0, elapsed;
+  unsigned long long c0, cycles;
+  double samples;
+
+  for (int i = 0; i < ninstances; i++) {
+    instance_init(&insts[i], bc, i, ninstances, n, sr);
+  }
+
+  // warm up: first touch of the tables and buffers shouldn't be timed
+  for (int i = 0; i < ninstances; i++) stub_run(insts[i].chain);
+
+  t0 = now_ns();
+  c0 = bench_cycles();
+  do {
+    for (int i = 0; i < ninstances; i++) stub_run(insts[i].chain);
+    passes++;
+    elapsed = now_ns() - t0;
+  } while (elapsed < min_ns || passes < 3);
+  cycles = bench_cycles() - c0;
+
+  samples = (double)passes * n * ninstances;
+  if (csv) {
+    printf("%s,%d,%d,%.4f,", bc->name, n, ninstances, elapsed / samples);
+    if (HAVE_CYCLES) printf("%.4f\n", cycles / samples);
+    else printf("\n");
+  } else {
+    printf("%-16s %6d %9d %11.3f ", bc->name, n, ninstances, elapsed / samples);
+    if (HAVE_CYCLES) printf("%14.3f\n", cycles / samples);
+    else printf("%14s\n", "n/a");
+  }
+  fflush(stdout);
+
+  for (int i = 0; i < ninstances; i++) instance_free(&insts[i]);
+  free(insts);
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "usage: oscbench [-c class] [-b blocksizes] [-i instancecounts] "
+    "[-r samplerate] [-t min_ms] [-s] [-v voices] [-m message] [-csv]\n"
+    "  lists are comma separated, e.g. -b 64,4096 -i 1,100,2000\n"
+    "  -s treats every signal inlet as connected\n"
+    "  -v sets the voices per osc_bank~ (default 64), all playing\n"
+    "  -m sends a message to each instance, e.g. -m \"bandlimit 1\"\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int blocks[MAXLIST] = {64, 256, 1024, 4096};
+  int nblocks = 4;
+  int counts[MAXLIST] = {1, 10, 100, 500, 1000, 2000};
+  int ncounts = 6;
+  const char *only = NULL;
+  t_float sr = 44100;
+  double min_ms = 50;
+  int csv = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-c") && i + 1 < argc) only = argv[++i];
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      if (!(nblocks = parse_list(argv[++i], blocks))) usage();
+    } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+      if (!(ncounts = parse_list(argv[++i], counts))) usage();
+    } else if (!strcmp(argv[i], "-r") && i + 1 < argc) sr = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) min_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s")) connect_inlets = 1;
+    else if (!strcmp(argv[i], "-v") && i + 1 < argc) {
+      if ((bank_voices = atoi(argv[++i])) < 1) usage();
+    }
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc) parse_msg(argv[++i]);
+    else if (!strcmp(argv[i], "-csv")) csv = 1;
+    else usage();
+  }
+
+  stub_quiet = 1;
+  for (int c = 0; c < NCLASSES; c++) classes[c].setup();
+
+  if (csv) printf("class,block,instances,ns_per_sample,cycles_per_sample\n");
+  else printf("%-16s %6s %9s %11s %14s\n", "class", "block", "instances",
+    "ns/sample", "cycles/sample");
+
+  for (int c = 0; c < NCLASSES; c++) {
+    if (only && strcmp(only, classes[c].name)) continue;
+    if (msg_sel && !stub_understands(classes[c].name, msg_sel)) continue;
+    for (int b = 0; b < nblocks; b++) {
+      for (int k = 0; k < ncounts; k++) {
+        run_config(&classes[c], blocks[b], counts[k], sr, min_ms * 1e6, csv);
+      }
+    }
+  }
+
+  return 0;
+}
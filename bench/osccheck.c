@@ -0,0 +1,386 @@
+// Checks of what the classes do, rather than how fast.
+//
+// events: messages to tri_phase~ (phase, softness, low, hi) and
+//   simple_phasor~ (phase) at points in logical time between samples, with
+//   blocks of 64, have to come out the same as with blocks of 1, where every
+//   sample is a block of its own (events.h). Some of them are in the last
+//   half sample of a block, and several land in one block. Block size 1
+//   only has the scalar loops, so with a SIMD kernel set an ulp or so of
+//   difference (FMA) is allowed.
+//
+// sync: modern_osc~ and simple_phasor~ at 150 Hz, hard synced to a
+//   [phasor~]-style master. At 220 Hz the master has to restart them once
+//   every one of its periods, at the point between samples where it wrapped:
+//   the output has to follow the ideal synced phase (away from modern_osc~'s
+//   polyBLEP), and simple_phasor~, which can't get to the end of a cycle on
+//   its own before the next restart, has to drop exactly once per period.
+//   At -220 Hz the master runs backwards and never wraps, and a master of
+//   NaN and +-inf is no master at all: both have to come out the same as one
+//   that stays still.
+//
+// Every check is built against the same Pd shim as oscbench, whose logical
+// time only moves when this moves it: a message at sample s (a fraction of
+// one, say) is sent with the time at s, and each block is run with the time
+// at its end, the way Pd's scheduler does.
+//
+// usage: osccheck [-c check] [-m message]
+//
+// -m sends a message to every instance, e.g. -m "kernel scalar". The exit
+// status is 1 if anything failed, so `make check` can be run as a check.
+
+#include "pd_stub.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SR 44100
+#define LENGTH 1024 // samples per run
+#define TOLERANCE 1e-5 // for the SIMD kernels against the scalar loops
+#define MAXMSG 8
+
+void simple_phasor_tilde_setup(void);
+void tri_phase_tilde_setup(void);
+void modern_osc_tilde_setup(void);
+
+static t_symbol *msg_sel;
+static t_atom msg_args[MAXMSG];
+static int msg_argc;
+
+// a message at `at` samples from the start of the run
+typedef struct _timed {
+  double at;
+  const char *sel;
+  t_float value;
+} t_timed;
+
+// one class with its signal inlets: the frequency (and only that) connected
+// or not, and an extra message to send it first (NULL for none)
+typedef struct _setup {
+  const char *name;
+  t_float freq; // creation argument
+  int connect;
+  const char *sel;
+  t_float value;
+} t_setup;
+
+static double ms(double samples)
+{
+  return samples * 1000.0 / SR;
+}
+
+// the frequency signal, the same whatever the block size
+static t_sample freq_at(int i)
+{
+  return 220 + 150 * sin(i * 0.01);
+}
+
+// Run `s` over LENGTH samples in blocks of n into out, with the messages in
+// `msgs` (in order of time) and, if `sync` isn't NULL, LENGTH samples of it
+// into the sync inlet (signal inlet 1). Returns 0 if the class can't be set
+// up.
+static int run(const t_setup *s, const t_timed *msgs, int nmsgs,
+  const t_sample *sync, int n, t_sample *out)
+{
+  t_atom a;
+  t_pd *x;
+  t_sample *ins[4], *outs[1];
+  t_int *chain;
+  int nin, m = 0;
+
+  stub_settime(0);
+  SETFLOAT(&a, s->freq);
+  x = stub_new(s->name, 1, &a);
+  if (!x) return 0;
+  if (s->sel) {
+    SETFLOAT(&a, s->value);
+    stub_send(x, s->sel, 1, &a);
+  }
+  if (msg_sel) stub_send(x, msg_sel->s_name, msg_argc, msg_args);
+  nin = stub_nsiginlets(x);
+  if (nin > 4 || stub_nsigoutlets(x) != 1) {
+    stub_free(x);
+    return 0;
+  }
+  for (int i = 0; i < nin; i++) {
+    ins[i] = (t_sample *)calloc(n, sizeof(t_sample));
+    for (int j = 0; j < n; j++) ins[i][j] = stub_inlet_scalar(x, i);
+  }
+  outs[0] = (t_sample *)calloc(n, sizeof(t_sample));
+  if (s->connect) stub_connect_signal(x, 0);
+  if (sync) {
+    if (nin < 2) {
+      stub_free(x);
+      return 0;
+    }
+    stub_connect_signal(x, stub_siginlet(x, 1));
+  }
+  chain = stub_dsp(x, SR, n, ins, outs);
+
+  for (int b = 0; b < LENGTH; b += n) {
+    for (; m < nmsgs && msgs[m].at < b + n; m++) {
+      stub_settime(ms(msgs[m].at));
+      SETFLOAT(&a, msgs[m].value);
+      stub_send(x, msgs[m].sel, 1, &a);
+    }
+    if (s->connect) {
+      for (int j = 0; j < n; j++) ins[0][j] = freq_at(b + j);
+    }
+    if (sync) memcpy(ins[1], sync + b, n * sizeof(t_sample));
+    stub_settime(ms(b + n));
+    stub_run(chain);
+    memcpy(out + b, outs[0], n * sizeof(t_sample));
+  }
+
+  stub_freechain(chain);
+  stub_free(x);
+  for (int i = 0; i < nin; i++) free(ins[i]);
+  free(outs[0]);
+  return 1;
+}
+
+/* -------------------------------- events -------------------------------- */
+
+// ft1 on both, the rest only on tri_phase~ (simple_phasor~ has no such
+// methods, so sending them does nothing and they're left out)
+static const t_timed events[] = {
+  {10.3, "ft1", 0.25},
+  {63.7, "ft1", 0.5}, // the last half sample of the first block
+  {100.4, "softness", 0.3},
+  {100.6, "low", -0.5}, // the same sample as the one before
+  {127.95, "hi", 0.8},
+  {128.2, "ft1", 0.9},
+  {300.5, "low", -1.5},
+  {300.6, "hi", 1.5},
+  {300.7, "softness", 0.8},
+  {511.6, "ft1", 0.1},
+  {700.1, "ft1", 0.75},
+  {767.99, "ft1", 0},
+};
+
+#define NEVENTS (int)(sizeof(events) / sizeof(events[0]))
+
+static const t_setup events_setups[] = {
+  {"tri_phase~", 220, 0, NULL, 0},
+  {"tri_phase~", 220, 1, NULL, 0},
+  {"tri_phase~", 220, 0, "bandlimit", 1},
+  {"tri_phase~", 220, 1, "bandlimit", 1},
+  {"simple_phasor~", 220, 0, NULL, 0},
+  {"simple_phasor~", 220, 1, NULL, 0},
+};
+
+static int check_events(void)
+{
+  static t_sample ref[LENGTH], out[LENGTH];
+  t_timed msgs[NEVENTS];
+  int fails = 0;
+
+  for (int k = 0; k < (int)(sizeof(events_setups) / sizeof(events_setups[0]));
+       k++) {
+    const t_setup *s = &events_setups[k];
+    int phasor = !strcmp(s->name, "simple_phasor~"), nmsgs = 0, worst = 0;
+    double err = 0;
+
+    for (int m = 0; m < NEVENTS; m++) {
+      if (!phasor || !strcmp(events[m].sel, "ft1")) msgs[nmsgs++] = events[m];
+    }
+    if (!run(s, msgs, nmsgs, NULL, 1, ref)
+        || !run(s, msgs, nmsgs, NULL, 64, out)) {
+      printf("%-16s couldn't be set up\n", s->name);
+      fails++;
+      continue;
+    }
+    for (int i = 0; i < LENGTH; i++) {
+      double d = fabs(out[i] - ref[i]);
+      // a phasor a hair either side of a wrap is right either way
+      if (phasor && d > 0.5) d = 1 - d;
+      if (!(d <= err)) {
+        err = d;
+        worst = i;
+      }
+    }
+    printf("%-16s %-6s %-14s events  %8.2g at %-4d %s\n", s->name,
+           s->connect ? "signal" : "float", s->sel ? "bandlimit 1" : "",
+           err, worst, err <= TOLERANCE ? "ok" : "FAIL (differs from block 1)");
+    if (!(err <= TOLERANCE)) fails++;
+  }
+  return fails;
+}
+
+/* --------------------------------- sync --------------------------------- */
+
+#define SYNC_SLAVE 150
+#define SYNC_MASTER 220
+
+// a [phasor~] at f Hz: the fraction of the cycle it's at, in [0, 1)
+static void sync_master(t_sample *sig, double f)
+{
+  for (int i = 0; i < LENGTH; i++) {
+    double m = i * f / SR;
+    sig[i] = (t_sample)(m - floor(m));
+  }
+}
+
+// how far out and where, for the worst sample of out against ref from `from`
+static double sync_diff(const t_sample *out, const t_sample *ref, int from,
+  int *worst)
+{
+  double err = 0;
+  *worst = from;
+  for (int i = from; i < LENGTH; i++) {
+    double d = fabs(out[i] - ref[i]);
+    if (!(d <= err)) {
+      err = d;
+      *worst = i;
+    }
+  }
+  return err;
+}
+
+static int sync_report(const char *name, const char *what, double err,
+  int worst, const char *fail)
+{
+  int ok = err <= TOLERANCE;
+  printf("%-16s %-21s sync    %8.2g at %-4d %s\n", name, what, err, worst,
+         ok ? "ok" : fail);
+  return !ok;
+}
+
+static int check_sync(void)
+{
+  static const char *names[] = {"modern_osc~", "simple_phasor~"};
+  static t_sample master[LENGTH], still[LENGTH], out[LENGTH], ref[LENGTH];
+  int fails = 0;
+
+  for (int k = 0; k < 2; k++) {
+    t_setup s = {names[k], SYNC_SLAVE, 0, NULL, 0};
+    int cosine = k == 0, worst, drops = 0, wraps = 0;
+    double err = 0;
+
+    // forwards: the ideal phase is the time since the master's last wrap,
+    // which is where the master is over its frequency. modern_osc~ is a
+    // sample late, and its polyBLEP changes the samples either side of a
+    // restart, which are left out.
+    sync_master(master, SYNC_MASTER);
+    if (!run(&s, NULL, 0, master, 64, out)) {
+      printf("%-16s couldn't be set up\n", s.name);
+      fails++;
+      continue;
+    }
+    worst = 0;
+    for (int i = 1; i < LENGTH - 1; i++) {
+      double m = i * (double)SYNC_MASTER / SR, p, d;
+      m -= floor(m);
+      p = m * SYNC_SLAVE / SYNC_MASTER;
+      if (cosine) {
+        double to = m * SR / SYNC_MASTER, from = (1 - m) * SR / SYNC_MASTER;
+        if (to < 2 || from < 2) continue;
+        d = fabs(out[i + 1] - cos(2 * 3.14159265358979323846 * p));
+      } else {
+        d = fabs(out[i] - p);
+        drops += out[i] < out[i - 1];
+        wraps += master[i] < master[i - 1];
+      }
+      if (!(d <= err)) {
+        err = d;
+        worst = i;
+      }
+    }
+    fails += sync_report(s.name, "master 220 Hz", err, worst,
+                         "FAIL (not where the master wrapped)");
+    if (!cosine) {
+      printf("%-16s %-21s sync    %4d drops, %4d wraps %s\n", s.name,
+             "master 220 Hz", drops, wraps,
+             drops == wraps ? "ok" : "FAIL (not once per period)");
+      if (drops != wraps) fails++;
+    }
+
+    // a master that never wraps, to compare the others to
+    for (int i = 0; i < LENGTH; i++) still[i] = 0.25f;
+    run(&s, NULL, 0, still, 64, ref);
+
+    sync_master(master, -SYNC_MASTER);
+    run(&s, NULL, 0, master, 64, out);
+    err = sync_diff(out, ref, 0, &worst);
+    fails += sync_report(s.name, "master -220 Hz", err, worst,
+                         "FAIL (restarted going backwards)");
+
+    // moving on without wrapping, with every third sample NaN or +-inf
+    for (int i = 0; i < LENGTH; i++) {
+      still[i] = i % 3 ? 0.1f + 0.8f * i / LENGTH
+        : i % 9 == 0 ? NAN : i % 9 == 3 ? INFINITY : -INFINITY;
+    }
+    run(&s, NULL, 0, still, 64, out);
+    err = sync_diff(out, ref, 0, &worst);
+    fails += sync_report(s.name, "master NaN and inf", err, worst,
+                         "FAIL (restarted on a bad value)");
+  }
+  return fails;
+}
+
+/* -------------------------------------------------------------------------- */
+
+typedef struct _check {
+  const char *name;
+  int (*fn)(void);
+} t_check;
+
+static const t_check checks[] = {
+  {"events", check_events},
+  {"sync", check_sync},
+};
+
+#define NCHECKS (int)(sizeof(checks) / sizeof(checks[0]))
+
+static void parse_msg(char *s)
+{
+  char *tok = strtok(s, " ");
+  msg_sel = tok ? gensym(tok) : NULL;
+  while (msg_argc < MAXMSG && (tok = strtok(NULL, " "))) {
+    char *end;
+    double f = strtod(tok, &end);
+    if (*end) {
+      msg_args[msg_argc].a_type = A_SYMBOL;
+      msg_args[msg_argc].a_w.w_symbol = gensym(tok);
+    } else {
+      msg_args[msg_argc].a_type = A_FLOAT;
+      msg_args[msg_argc].a_w.w_float = (t_float)f;
+    }
+    msg_argc++;
+  }
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: osccheck [-c check] [-m message]\n  checks:");
+  for (int i = 0; i < NCHECKS; i++) fprintf(stderr, " %s", checks[i].name);
+  fprintf(stderr,
+    "\n  -m sends a message to each instance, e.g. -m \"kernel scalar\"\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const char *only = NULL;
+  int fails = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-c") && i + 1 < argc) only = argv[++i];
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc) parse_msg(argv[++i]);
+    else usage();
+  }
+
+  stub_quiet = 1;
+  simple_phasor_tilde_setup();
+  tri_phase_tilde_setup();
+  modern_osc_tilde_setup();
+
+  for (int i = 0; i < NCHECKS; i++) {
+    if (only && strcmp(only, checks[i].name)) continue;
+    fails += checks[i].fn();
+  }
+
+  if (fails) printf("%d failed\n", fails);
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,455 @@
+// Worst-case time per block under hostile input.
+//
+// A perform routine in Pd's audio thread has to take about the same time
+// whatever comes in, or one bad signal (a modulation spike, a division by 0
+// upstream, a NaN from a filter that blew up) makes the whole patch drop out.
+// This feeds every signal inlet of every class, one at a time and all at once,
+// with patterns built to find slow paths: NaN, +-inf, the largest floats,
+// denormals, random bit patterns, and spikes or a random mix of all of those
+// on top of a normal signal, so any branch on the input mispredicts. Each
+// class runs once with its inlets connected (the per-sample routines) and once
+// without (the float-only ones, getting one value per block).
+//
+// The figure is the slowest block, in cycles: every block of the sequence is
+// timed over a few repeats, the fastest repeat is kept (that takes interrupts
+// and the like out) and the slowest block of those is compared to the same
+// for a plain signal. More than -l times that (default 4), three times over,
+// is a failure, and so is any output that isn't a number when only the main
+// inlet (the frequency, or triangle~'s phase) got the hostile input; NaN and
+// inf there should stop the phase, not reach the output.
+//
+// osc_bank~ has no signal inlets, so its voices get the same patterns as
+// frequencies by message, a new one every block.
+//
+// The exit status is 1 if anything failed, so `make fuzz` can be run as a
+// check. Building it with -fsanitize=address on top also catches reads
+// outside the tables.
+//
+// usage: oscfuzz [-c class] [-b blocksize] [-n blocks] [-l limit] [-m message]
+//
+// -m sends a message to every instance, e.g. -m "kernel scalar".
+
+#include "pd_stub.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static inline unsigned long long bench_cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLES 0
+static inline unsigned long long bench_cycles(void) { return 0; }
+#endif
+
+#define SR 44100
+#define REPEATS 5
+#define BENIGN_FREQ 440.0
+#define BANK_VOICES 8
+
+void triangle_tilde_setup(void);
+void simple_osc_tilde_setup(void);
+void cubic_osc_tilde_setup(void);
+void fold_osc_tilde_setup(void);
+void simple_phasor_tilde_setup(void);
+void tri_phase_tilde_setup(void);
+void tabfudge_osc_tilde_setup(void);
+void modern_osc_tilde_setup(void);
+void osc_bank_tilde_setup(void);
+void wave_osc_tilde_setup(void);
+void fm_op_tilde_setup(void);
+
+typedef struct _fuzzclass
+{
+  const char *name;
+  void (*setup)(void);
+  int phase_input; // main inlet takes a 0-1 phase rather than a frequency
+  int bank; // no inlets; the patterns go to the voices' frequencies
+} t_fuzzclass;
+
+static t_fuzzclass classes[] = {
+  {"simple_osc~", simple_osc_tilde_setup, 0},
+  {"cubic_osc~", cubic_osc_tilde_setup, 0},
+  {"fold_osc~", fold_osc_tilde_setup, 0},
+  {"tabfudge_osc~", tabfudge_osc_tilde_setup, 0},
+  {"modern_osc~", modern_osc_tilde_setup, 0},
+  {"simple_phasor~", simple_phasor_tilde_setup, 0},
+  {"tri_phase~", tri_phase_tilde_setup, 0},
+  {"triangle~", triangle_tilde_setup, 1},
+  {"osc_bank~", osc_bank_tilde_setup, 0, 1},
+  {"wave_osc~", wave_osc_tilde_setup, 0},
+  {"fm_op~", fm_op_tilde_setup, 0},
+};
+
+#define NCLASSES (int)(sizeof(classes) / sizeof(classes[0]))
+
+// xorshift32, so every repeat can replay the same sequence
+static uint32_t rng_next(uint32_t *s)
+{
+  uint32_t x = *s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *s = x;
+}
+
+static float rng_bits(uint32_t *s)
+{
+  uint32_t b = rng_next(s);
+  float f;
+  memcpy(&f, &b, sizeof(f));
+  return f;
+}
+
+static float rng_sign(uint32_t *s)
+{
+  return rng_next(s) & 1 ? -1.0f : 1.0f;
+}
+
+// a big value anywhere from 1e6 to the largest float, either sign
+static float rng_huge(uint32_t *s)
+{
+  return rng_sign(s) * powf(10.0f, 6.0f + (rng_next(s) % 3200) * 0.01f);
+}
+
+// the patterns, each a sample from what the inlet would normally get
+static float pat_nan(uint32_t *s, float b) { return NAN; }
+static float pat_inf(uint32_t *s, float b) { return INFINITY; }
+static float pat_neginf(uint32_t *s, float b) { return -INFINITY; }
+static float pat_max(uint32_t *s, float b) { return rng_sign(s) * 3.4e38f; }
+static float pat_huge(uint32_t *s, float b) { return rng_huge(s); }
+static float pat_denormal(uint32_t *s, float b)
+{
+  return rng_sign(s) * (float)(rng_next(s) & 0x7fffff) * 1.4e-45f;
+}
+static float pat_bits(uint32_t *s, float b) { return rng_bits(s); }
+static float pat_spikes(uint32_t *s, float b)
+{
+  return rng_next(s) % 16 ? b : rng_huge(s);
+}
+static float pat_mixed(uint32_t *s, float b)
+{
+  switch (rng_next(s) % 6) {
+    case 0: return NAN;
+    case 1: return rng_sign(s) * INFINITY;
+    case 2: return rng_huge(s);
+    case 3: return pat_denormal(s, b);
+    default: return b;
+  }
+}
+
+typedef struct _pattern
+{
+  const char *name;
+  float (*next)(uint32_t *s, float benign);
+} t_pattern;
+
+static const t_pattern patterns[] = {
+  {"nan", pat_nan},
+  {"inf", pat_inf},
+  {"-inf", pat_neginf},
+  {"max", pat_max},
+  {"huge", pat_huge},
+  {"denormal", pat_denormal},
+  {"bits", pat_bits},
+  {"spikes", pat_spikes},
+  {"mixed", pat_mixed},
+};
+
+#define NPATTERNS (int)(sizeof(patterns) / sizeof(patterns[0]))
+
+static int blocksize = 64, nblocks = 1000;
+static double limit = 4.0;
+
+#define MAXMSG 8
+static t_symbol *msg_sel;
+static t_atom msg_args[MAXMSG];
+static int msg_argc;
+
+static void parse_msg(char *s)
+{
+  char *tok = strtok(s, " ");
+  msg_sel = tok ? gensym(tok) : NULL;
+  while (msg_argc < MAXMSG && (tok = strtok(NULL, " "))) {
+    char *end;
+    double f = strtod(tok, &end);
+    if (*end) {
+      msg_args[msg_argc].a_type = A_SYMBOL;
+      msg_args[msg_argc].a_w.w_symbol = gensym(tok);
+    } else {
+      msg_args[msg_argc].a_type = A_FLOAT;
+      msg_args[msg_argc].a_w.w_float = (t_float)f;
+    }
+    msg_argc++;
+  }
+}
+
+typedef struct _fuzz
+{
+  const t_fuzzclass *fc;
+  t_pd *obj;
+  t_sample **ins, **outs;
+  t_float *scalars; // what each inlet gets when it's left alone
+  int nin, nout;
+  t_int *chain;
+  double ramp; // triangle~'s phase
+} t_fuzz;
+
+static void bank_voice(t_pd *obj, int v, t_float freq)
+{
+  t_atom a[3];
+  a[0].a_type = a[1].a_type = a[2].a_type = A_FLOAT;
+  a[0].a_w.w_float = v + 1;
+  a[1].a_w.w_float = freq;
+  a[2].a_w.w_float = 1.0f / BANK_VOICES;
+  stub_send(obj, "list", 3, a);
+}
+
+static int fuzz_init(t_fuzz *z, const t_fuzzclass *fc, int connected)
+{
+  memset(z, 0, sizeof(*z));
+  z->fc = fc;
+  if (fc->bank) {
+    t_atom arg;
+    arg.a_type = A_FLOAT;
+    arg.a_w.w_float = BANK_VOICES;
+    z->obj = stub_new(fc->name, 1, &arg);
+    for (int v = 0; z->obj && v < BANK_VOICES; v++) {
+      bank_voice(z->obj, v, (t_float)(BENIGN_FREQ * (v + 1)));
+    }
+  } else {
+    z->obj = stub_new(fc->name, 0, NULL);
+  }
+  if (!z->obj) return 0;
+  if (msg_sel) stub_send(z->obj, msg_sel->s_name, msg_argc, msg_args);
+  z->nin = stub_nsiginlets(z->obj);
+  z->nout = stub_nsigoutlets(z->obj);
+  z->ins = (t_sample **)calloc(z->nin + 1, sizeof(t_sample *));
+  z->outs = (t_sample **)calloc(z->nout + 1, sizeof(t_sample *));
+  z->scalars = (t_float *)calloc(z->nin + 1, sizeof(t_float));
+  for (int i = 0; i < z->nin; i++) {
+    z->ins[i] = (t_sample *)calloc(blocksize, sizeof(t_sample));
+    z->scalars[i] = i == 0 ? (t_float)BENIGN_FREQ
+                           : stub_inlet_scalar(z->obj, i);
+  }
+  for (int i = 0; i < z->nout; i++) {
+    z->outs[i] = (t_sample *)calloc(blocksize, sizeof(t_sample));
+  }
+  if (connected) {
+    for (int i = 0; i < z->nin; i++) {
+      stub_connect_signal(z->obj, stub_siginlet(z->obj, i));
+    }
+  }
+  z->chain = stub_dsp(z->obj, SR, blocksize, z->ins, z->outs);
+  return 1;
+}
+
+static void fuzz_free(t_fuzz *z)
+{
+  stub_freechain(z->chain);
+  stub_free(z->obj);
+  for (int i = 0; i < z->nin; i++) free(z->ins[i]);
+  for (int i = 0; i < z->nout; i++) free(z->outs[i]);
+  free(z->ins);
+  free(z->outs);
+  free(z->scalars);
+}
+
+// what inlet i would normally get at sample j
+static float fuzz_benign(t_fuzz *z, int i, int j)
+{
+  if (i || !z->fc->phase_input) return z->scalars[i];
+  return (float)(z->ramp + j * (BENIGN_FREQ / SR));
+}
+
+// Fill the inlets for the next block: `target` (-1 for all of them) gets the
+// pattern, the rest what they'd normally get. Without a connection an inlet
+// gets one value for the whole block, like Pd copies a float in.
+static void fuzz_fill(t_fuzz *z, const t_pattern *pat, int target,
+  int connected, uint32_t *seed)
+{
+  if (z->fc->bank) {
+    for (int v = 0; pat && v < BANK_VOICES; v++) {
+      bank_voice(z->obj, v, pat->next(seed, (float)(BENIGN_FREQ * (v + 1))));
+    }
+    return;
+  }
+  for (int i = 0; i < z->nin; i++) {
+    int hit = pat && (target < 0 || target == i);
+    for (int j = 0; j < blocksize; j++) {
+      float b = fuzz_benign(z, i, j);
+      if (j && !connected) z->ins[i][j] = z->ins[i][0];
+      else z->ins[i][j] = hit ? pat->next(seed, b) : b;
+    }
+  }
+  z->ramp += blocksize * (BENIGN_FREQ / SR);
+  z->ramp -= floor(z->ramp);
+}
+
+// The slowest block of the sequence, each block timed at its fastest over the
+// repeats. *finite is cleared if any output wasn't a number.
+static double fuzz_run(t_fuzz *z, const t_pattern *pat, int target,
+  int connected, unsigned long long *best, int *finite)
+{
+  double worst = 0;
+
+  for (int b = 0; b < nblocks; b++) best[b] = ~0ull;
+  *finite = 1;
+  for (int r = 0; r < REPEATS; r++) {
+    uint32_t seed = 0x9e3779b9u;
+    for (int b = 0; b < nblocks; b++) {
+      unsigned long long c0;
+      fuzz_fill(z, pat, target, connected, &seed);
+      c0 = bench_cycles();
+      stub_run(z->chain);
+      c0 = bench_cycles() - c0;
+      best[b] = c0 < best[b] ? c0 : best[b];
+      for (int i = 0; i < z->nout; i++) {
+        for (int j = 0; j < blocksize; j++) {
+          uint32_t bits;
+          memcpy(&bits, &z->outs[i][j], sizeof(bits));
+          if ((bits & 0x7f800000u) == 0x7f800000u) *finite = 0;
+        }
+      }
+    }
+  }
+  for (int b = 0; b < nblocks; b++) {
+    worst = best[b] > worst ? (double)best[b] : worst;
+  }
+  return worst;
+}
+
+static void inlet_name(char *buf, size_t size, const t_fuzz *z, int target)
+{
+  if (z->fc->bank) snprintf(buf, size, "voices");
+  else if (target < 0) snprintf(buf, size, "all");
+  else snprintf(buf, size, "%d", target);
+}
+
+// every pattern on every inlet of one class; returns the number of failures
+static int fuzz_class(const t_fuzzclass *fc, unsigned long long *best)
+{
+  int fails = 0;
+
+  for (int connected = 1; connected >= 0; connected--) {
+    t_fuzz z;
+    double base;
+    int finite, ntargets;
+
+    if (!fuzz_init(&z, fc, connected)) {
+      fprintf(stderr, "oscfuzz: couldn't create %s\n", fc->name);
+      return 1;
+    }
+    // osc_bank~ has no inlets to connect
+    if (fc->bank && !connected) {
+      fuzz_free(&z);
+      continue;
+    }
+    fuzz_fill(&z, NULL, 0, connected, NULL);
+    stub_run(z.chain);
+    base = fuzz_run(&z, NULL, 0, connected, best, &finite);
+    printf("%-15s %-6s %-6s %-9s %9.0f %7s %s\n", fc->name,
+           connected ? "signal" : "float", "-", "plain", base, "1.00",
+           finite ? "ok" : "FAIL (output not a number)");
+    fails += !finite;
+
+    ntargets = fc->bank ? 1 : z.nin + (z.nin > 1);
+    for (int t = 0; t < ntargets; t++) {
+      int target = t < z.nin ? t : -1;
+      char name[16];
+      inlet_name(name, sizeof(name), &z, target);
+      for (int p = 0; p < NPATTERNS; p++) {
+        double worst = fuzz_run(&z, &patterns[p], target, connected, best,
+                                &finite);
+        double ratio;
+        int slow, fin;
+        // a timing that's over gets two more tries, in case something else on
+        // the machine got in the way
+        for (int retry = 0; retry < 2 && base > 0 && worst > limit * base;
+             retry++) {
+          double again = fuzz_run(&z, &patterns[p], target, connected, best,
+                                  &fin);
+          worst = again < worst ? again : worst;
+          finite &= fin;
+        }
+        ratio = base > 0 ? worst / base : 0;
+        slow = HAVE_CYCLES && ratio > limit;
+        // only the main inlet is guaranteed to keep hostile input out of the
+        // output
+        int bad = !finite && (fc->bank || target == 0);
+        printf("%-15s %-6s %-6s %-9s %9.0f %7.2f %s\n", fc->name,
+               connected ? "signal" : "float", name, patterns[p].name, worst,
+               ratio, slow ? "FAIL (too slow)"
+                      : bad ? "FAIL (output not a number)" : "ok");
+        fflush(stdout);
+        fails += slow || bad;
+      }
+      // back to normal before the next inlet
+      fuzz_fill(&z, NULL, 0, connected, NULL);
+      if (fc->bank) {
+        for (int v = 0; v < BANK_VOICES; v++) {
+          bank_voice(z.obj, v, (t_float)(BENIGN_FREQ * (v + 1)));
+        }
+      }
+    }
+    fuzz_free(&z);
+  }
+  return fails;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "usage: oscfuzz [-c class] [-b blocksize] [-n blocks] [-l limit] "
+    "[-m message]\n"
+    "  -l fails a class if a block takes more than limit times as long as\n"
+    "     with a plain signal (default 4)\n"
+    "  -m sends a message to each instance, e.g. -m \"kernel scalar\"\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const char *only = NULL;
+  int fails = 0;
+  unsigned long long *best;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-c") && i + 1 < argc) only = argv[++i];
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      if ((blocksize = atoi(argv[++i])) < 1) usage();
+    }
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      if ((nblocks = atoi(argv[++i])) < 1) usage();
+    }
+    else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+      if ((limit = atof(argv[++i])) <= 0) usage();
+    }
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc) parse_msg(argv[++i]);
+    else usage();
+  }
+  if (!(best = (unsigned long long *)malloc(nblocks * sizeof(*best)))) {
+    return 1;
+  }
+
+  stub_quiet = 1;
+  for (int c = 0; c < NCLASSES; c++) classes[c].setup();
+
+  printf("%-15s %-6s %-6s %-9s %9s %7s %s\n", "class", "inlets", "inlet",
+         "pattern", "worst", "ratio", "");
+  for (int c = 0; c < NCLASSES; c++) {
+    if (only && strcmp(only, classes[c].name)) continue;
+    if (msg_sel && !stub_understands(classes[c].name, msg_sel->s_name)) {
+      continue;
+    }
+    fails += fuzz_class(&classes[c], best);
+  }
+
+  free(best);
+  if (fails) printf("%d failed\n", fails);
+  return fails ? 1 : 0;
+}
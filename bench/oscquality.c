@@ -0,0 +1,319 @@
+// Quality versus cost of the cosine oscillators.
+//
+// Every way the library has of making a cosine (table size, interpolation,
+// oversampling, polynomial) is run across a frequency sweep, built against
+// the same Pd shim as oscbench. For each frequency the output is analysed
+// with an FFT and reported as:
+//
+//   THD+N: everything that isn't the fundamental, relative to it
+//   SFDR: the fundamental over the single largest other component
+//   alias: everything outside the fundamental and its in-band harmonics, i.e.
+//     what folded back from above Nyquist (plus any noise), relative to the
+//     fundamental
+//   cycles/sample: of the perform routine, one instance, 64 sample blocks
+//
+// All in dB. To keep the analysis exact the sample rate is 65536 Hz and the
+// FFT 65536 points: every test frequency is an odd whole number of Hz, so it
+// has a whole number of cycles in the window, the phase increment is exact,
+// and each harmonic lands exactly on a bin. No window function, no leakage.
+// The frequencies are also given as what they'd be at 48 kHz.
+//
+// The frequency is steady, so simple_osc~ and modern_osc~ would run their
+// rotor (rotor.h) rather than the table; the table variants turn it off and
+// the rotor gets its own.
+//
+// additive~ is run with one partial, once with its oscillators (the same
+// table as modern_osc~'s linear 4096) and once per IFFT frame size, so the
+// IFFT mode's error shows up next to the oscillators it stands in for. Its
+// cycles/sample are for that one partial, so say little about the mode's
+// cost; oscthreads has that.
+//
+// usage: oscquality [-c class] [-p points] [-m message] [-csv]
+//
+// -m sends a message to every instance on top of the variant's own, e.g.
+// -m "kernel scalar". Build and run with `make quality`, which also writes
+// bench/quality.csv and, with gnuplot around, bench/quality.png
+// (bench/quality.gp).
+
+#include "pd_stub.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static inline unsigned long long bench_cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLES 0
+static inline unsigned long long bench_cycles(void) { return 0; }
+#endif
+
+#define SR 65536
+#define NFFT 65536 // a power of 2, and SR / NFFT Hz per bin
+#define BLOCK 64
+#define WARMUP 8192 // samples before the analysis, for filters to settle
+
+void simple_osc_tilde_setup(void);
+void cubic_osc_tilde_setup(void);
+void tabfudge_osc_tilde_setup(void);
+void modern_osc_tilde_setup(void);
+void wave_osc_tilde_setup(void);
+void additive_tilde_setup(void);
+
+typedef struct _variant
+{
+  const char *name;
+  const char *classname;
+  const char *msg; // sent before DSP starts, or NULL
+  int array; // the frequency goes in an array rather than inlet 0 (additive~)
+} t_variant;
+
+static const t_variant variants[] = {
+  {"linear 4096", "modern_osc~", "rotor 0"},
+  {"poly 5", "modern_osc~", "approx 5"},
+  {"poly 7", "modern_osc~", "approx 7"},
+  {"poly 9", "modern_osc~", "approx 9"},
+  {"linear 16384", "simple_osc~", "rotor 0"},
+  {"rotor", "simple_osc~", NULL},
+  {"linear 16384 tabfudge", "tabfudge_osc~", NULL},
+  {"cubic 65536 1x", "cubic_osc~", "oversample 1"},
+  {"cubic 65536 2x", "cubic_osc~", "oversample 2"},
+  {"cubic 65536 4x", "cubic_osc~", "oversample 4"},
+  {"mipmap 2048 sine", "wave_osc~", "shape sine"},
+  {"additive osc", "additive~", NULL, 1},
+  {"additive ifft 1024", "additive~", "mode ifft 1024", 1},
+  {"additive ifft 4096", "additive~", "mode ifft 4096", 1},
+};
+
+#define NVARIANTS (int)(sizeof(variants) / sizeof(variants[0]))
+
+#define MAXMSG 8
+
+static int parse_msg(char *s, t_symbol **sel, t_atom *args)
+{
+  int argc = 0;
+  char *tok = strtok(s, " ");
+  *sel = tok ? gensym(tok) : NULL;
+  while (argc < MAXMSG && (tok = strtok(NULL, " "))) {
+    char *end;
+    double f = strtod(tok, &end);
+    if (*end) {
+      args[argc].a_type = A_SYMBOL;
+      args[argc].a_w.w_symbol = gensym(tok);
+    } else {
+      args[argc].a_type = A_FLOAT;
+      args[argc].a_w.w_float = (t_float)f;
+    }
+    argc++;
+  }
+  return argc;
+}
+
+static void send_msg(t_pd *x, const char *msg)
+{
+  char buf[256];
+  t_symbol *sel;
+  t_atom args[MAXMSG];
+  int argc;
+
+  snprintf(buf, sizeof(buf), "%s", msg);
+  argc = parse_msg(buf, &sel, args);
+  if (sel) stub_send(x, sel->s_name, argc, args);
+}
+
+// in-place radix-2 FFT of re/im, n a power of 2
+static void fft(double *re, double *im, int n)
+{
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j |= bit;
+    if (i < j) {
+      double t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    for (int k = 0; k < len / 2; k++) {
+      // each twiddle straight from cos/sin, so errors don't build up
+      double wr = cos(-2.0 * M_PI * k / len), wi = sin(-2.0 * M_PI * k / len);
+      for (int i = k; i < n; i += len) {
+        int j = i + len / 2;
+        double xr = re[j] * wr - im[j] * wi;
+        double xi = re[j] * wi + im[j] * wr;
+        re[j] = re[i] - xr;
+        im[j] = im[i] - xi;
+        re[i] += xr;
+        im[i] += xi;
+      }
+    }
+  }
+}
+
+typedef struct _result
+{
+  double thdn, sfdr, alias, cycles;
+} t_result;
+
+// run a variant at `freq` Hz (a whole number) and analyse NFFT samples of it
+static int measure(const t_variant *v, const char *extra, int freq,
+  double *re, double *im, t_result *r)
+{
+  t_atom args[2];
+  t_pd *x;
+  t_sample *ins[8], *outs[8];
+  int nin, nout, ok = 0;
+  t_int *chain;
+  unsigned long long c0, best = 0;
+
+  if (v->array) {
+    // one partial, amplitude 1
+    t_word *f = stub_array("oscquality-freq", 1);
+    t_word *a = stub_array("oscquality-amp", 1);
+    if (!f || !a) return 0;
+    f[0].w_float = (t_float)freq;
+    a[0].w_float = 1;
+    SETSYMBOL(&args[0], gensym("oscquality-freq"));
+    SETSYMBOL(&args[1], gensym("oscquality-amp"));
+    x = stub_new(v->classname, 2, args);
+  } else x = stub_new(v->classname, 0, NULL);
+  if (!x) return 0;
+  if (v->msg) send_msg(x, v->msg);
+  if (extra) send_msg(x, extra);
+  nin = stub_nsiginlets(x);
+  nout = stub_nsigoutlets(x);
+  if (nin < !v->array || nin > 8 || nout < 1 || nout > 8) goto done;
+  for (int i = 0; i < nin; i++) {
+    // what Pd copies into an unconnected signal inlet every block
+    t_float f = i == 0 ? (t_float)freq : stub_inlet_scalar(x, i);
+    ins[i] = (t_sample *)calloc(BLOCK, sizeof(t_sample));
+    for (int j = 0; j < BLOCK; j++) ins[i][j] = f;
+  }
+  for (int i = 0; i < nout; i++)
+    outs[i] = (t_sample *)calloc(BLOCK, sizeof(t_sample));
+  chain = stub_dsp(x, SR, BLOCK, ins, outs);
+
+  for (int s = 0; s < WARMUP; s += BLOCK) stub_run(chain);
+  for (int s = 0; s < NFFT; s += BLOCK) {
+    stub_run(chain);
+    for (int j = 0; j < BLOCK; j++) {
+      re[s + j] = outs[0][j];
+      im[s + j] = 0;
+    }
+  }
+  // the time is the best of a few more runs of the same length
+  for (int rep = 0; rep < 5 && HAVE_CYCLES; rep++) {
+    c0 = bench_cycles();
+    for (int s = 0; s < NFFT; s += BLOCK) stub_run(chain);
+    c0 = bench_cycles() - c0;
+    if (!rep || c0 < best) best = c0;
+  }
+  r->cycles = HAVE_CYCLES ? (double)best / NFFT : NAN;
+
+  fft(re, im, NFFT);
+  {
+    double fund = 0, rest = 0, spur = 0, harm = 0;
+    for (int b = 0; b <= NFFT / 2; b++) {
+      // one-sided power
+      double p = (re[b] * re[b] + im[b] * im[b])
+        * (b && b < NFFT / 2 ? 2.0 : 1.0);
+      if (b == freq) {
+        fund = p;
+        continue;
+      }
+      rest += p;
+      if (p > spur) spur = p;
+      if (b && b % freq == 0) harm += p; // the in-band harmonics
+    }
+    if (fund > 0) {
+      // a floor far below anything float output can reach, for clean output
+      double tiny = fund * 1e-30;
+      r->thdn = 10 * log10((rest + tiny) / fund);
+      r->sfdr = 10 * log10(fund / (spur + tiny));
+      r->alias = 10 * log10((rest - harm + tiny) / fund);
+      ok = 1;
+    }
+  }
+
+  stub_freechain(chain);
+  for (int i = 0; i < nin; i++) free(ins[i]);
+  for (int i = 0; i < nout; i++) free(outs[i]);
+done:
+  stub_free(x);
+  return ok;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "usage: oscquality [-c class] [-p points] [-m message] [-csv]\n"
+    "  -p sets the number of frequencies in the sweep (default 24)\n"
+    "  -m sends a message to each instance, e.g. -m \"kernel scalar\"\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const char *only = NULL, *extra = NULL;
+  int points = 24, csv = 0;
+  double *re = (double *)malloc(NFFT * sizeof(double));
+  double *im = (double *)malloc(NFFT * sizeof(double));
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-c") && i + 1 < argc) only = argv[++i];
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+      if ((points = atoi(argv[++i])) < 2) usage();
+    }
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc) extra = argv[++i];
+    else if (!strcmp(argv[i], "-csv")) csv = 1;
+    else usage();
+  }
+  if (!re || !im) return 1;
+
+  stub_quiet = 1;
+  simple_osc_tilde_setup();
+  cubic_osc_tilde_setup();
+  tabfudge_osc_tilde_setup();
+  modern_osc_tilde_setup();
+  wave_osc_tilde_setup();
+  additive_tilde_setup();
+
+  if (csv) {
+    printf("variant,class,freq,freq_48k,thdn_db,sfdr_db,alias_db,"
+           "cycles_per_sample\n");
+  } else {
+    printf("%-22s %8s %9s %9s %9s %14s\n", "variant", "Hz@48k", "THD+N",
+           "SFDR", "alias", "cycles/sample");
+  }
+
+  for (int v = 0; v < NVARIANTS; v++) {
+    if (only && strcmp(only, variants[v].classname)) continue;
+    for (int p = 0; p < points; p++) {
+      // log-spaced from 21 Hz to 45% of the sample rate, rounded to odd
+      int freq = (int)(21.0 * pow(0.45 * SR / 21.0, (double)p / (points - 1)));
+      t_result r = {0, 0, 0, 0};
+      freq |= 1;
+      if (!measure(&variants[v], extra, freq, re, im, &r)) {
+        fprintf(stderr, "oscquality: %s at %d Hz failed\n", variants[v].name,
+                freq);
+        continue;
+      }
+      if (csv) {
+        printf("%s,%s,%d,%.1f,%.2f,%.2f,%.2f,%.3f\n", variants[v].name,
+               variants[v].classname, freq, freq * 48000.0 / SR, r.thdn,
+               r.sfdr, r.alias, r.cycles);
+      } else {
+        printf("%-22s %8.0f %9.1f %9.1f %9.1f %14.3f\n", variants[v].name,
+               freq * 48000.0 / SR, r.thdn, r.sfdr, r.alias, r.cycles);
+      }
+      fflush(stdout);
+    }
+  }
+
+  free(re);
+  free(im);
+  return 0;
+}
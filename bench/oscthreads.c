@@ -0,0 +1,194 @@
+// How additive~ scales with threads.
+//
+// For each partial count, additive~ is run with each number of workers on
+// the same arrays, built against the same Pd shim as oscbench: frequencies
+// log-spaced from 30 Hz to 15 kHz, all partials playing. Reported per
+// configuration:
+//
+//   us/block: wall clock time of one perform call, the mean over the run
+//   load: that as a share of the block's duration in real time, i.e. how
+//     much of one core's audio deadline it takes (1.0 = all of it)
+//   speedup: the 1 worker time over this one (if -j doesn't start at 1,
+//     the first count's time times its workers stands in for it)
+//   efficiency: speedup / workers
+//
+// By default the worker counts go up in powers of 2 to the number of CPUs,
+// and include that. Other processes on the machine show up in the numbers,
+// as they would in Pd.
+//
+// usage: oscthreads [-p partials,...] [-j workers,...] [-b block] [-r sr]
+//                   [-t min_ms] [-m message] [-csv]
+//
+// build and run with `make threads` from the repo root.
+
+#include "pd_stub.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAXLIST 32
+#define MAXMSG 8
+
+void additive_tilde_setup(void);
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int parse_list(const char *s, int *dest)
+{
+  int n = 0;
+  while (*s && n < MAXLIST) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || v <= 0) break;
+    dest[n++] = (int)v;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+// -m: message for every instance, selector then floats or symbols
+static const char *msg_sel = NULL;
+static t_atom msg_args[MAXMSG];
+static int msg_argc = 0;
+
+static void parse_msg(char *s)
+{
+  msg_sel = strtok(s, " ");
+  for (char *tok; msg_argc < MAXMSG && (tok = strtok(NULL, " ")); msg_argc++) {
+    char *end;
+    double f = strtod(tok, &end);
+    if (*end) {
+      msg_args[msg_argc].a_type = A_SYMBOL;
+      msg_args[msg_argc].a_w.w_symbol = gensym(tok);
+    } else {
+      msg_args[msg_argc].a_type = A_FLOAT;
+      msg_args[msg_argc].a_w.w_float = (t_float)f;
+    }
+  }
+}
+
+// microseconds per block for `partials` partials on `workers` workers
+static double run_config(int partials, int workers, int n, t_float sr,
+  double min_ns)
+{
+  t_word *freqs = stub_array("oscthreads-freqs", partials);
+  t_word *amps = stub_array("oscthreads-amps", partials);
+  t_atom args[3];
+  t_sample *out = (t_sample *)calloc(n, sizeof(t_sample));
+  t_pd *x;
+  t_int *chain;
+  long blocks = 0;
+  double t0, elapsed;
+
+  if (!freqs || !amps || !out) {
+    fprintf(stderr, "oscthreads: out of memory\n");
+    exit(1);
+  }
+  for (int i = 0; i < partials; i++) {
+    freqs[i].w_float = (t_float)(30.0 * pow(500.0, (double)i / partials));
+    amps[i].w_float = 1.0f / partials;
+  }
+  SETSYMBOL(&args[0], gensym("oscthreads-freqs"));
+  SETSYMBOL(&args[1], gensym("oscthreads-amps"));
+  SETFLOAT(&args[2], workers);
+  x = stub_new("additive~", 3, args);
+  if (msg_sel) stub_send(x, msg_sel, msg_argc, msg_args);
+  chain = stub_dsp(x, sr, n, NULL, &out);
+
+  // warm up: the first blocks ramp the partials in and start the threads
+  for (int i = 0; i < 16; i++) stub_run(chain);
+
+  t0 = now_ns();
+  do {
+    stub_run(chain);
+    blocks++;
+    elapsed = now_ns() - t0;
+  } while (elapsed < min_ns || blocks < 16);
+
+  stub_freechain(chain);
+  stub_free(x);
+  free(out);
+  return elapsed / blocks * 1e-3;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "usage: oscthreads [-p partials] [-j workers] [-b block] [-r samplerate] "
+    "[-t min_ms] [-m message] [-csv]\n"
+    "  lists are comma separated, e.g. -p 1000,5000 -j 1,2,4,8\n"
+    "  -j defaults to powers of 2 up to the number of CPUs\n"
+    "  -m sends a message to each instance, e.g. -m \"kernel sse2\"\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int partials[MAXLIST] = {1000, 2000, 5000};
+  int npartials = 3;
+  int workers[MAXLIST];
+  int nworkers = 0;
+  int n = 64;
+  t_float sr = 48000;
+  double min_ms = 200;
+  int csv = 0;
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+      if (!(npartials = parse_list(argv[++i], partials))) usage();
+    } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      if (!(nworkers = parse_list(argv[++i], workers))) usage();
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      if ((n = atoi(argv[++i])) < 1) usage();
+    } else if (!strcmp(argv[i], "-r") && i + 1 < argc) sr = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) min_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc) parse_msg(argv[++i]);
+    else if (!strcmp(argv[i], "-csv")) csv = 1;
+    else usage();
+  }
+  if (!nworkers) {
+    if (ncpus < 1) ncpus = 1;
+    for (long j = 1; j < ncpus && nworkers < MAXLIST - 1; j *= 2)
+      workers[nworkers++] = (int)j;
+    workers[nworkers++] = (int)ncpus;
+  }
+
+  stub_quiet = 1;
+  additive_tilde_setup();
+
+  if (csv) printf("partials,workers,block,us_per_block,load,speedup,"
+                  "efficiency\n");
+  else printf("%-9s %8s %6s %10s %7s %8s %11s   (%ld CPUs)\n", "partials",
+              "workers", "block", "us/block", "load", "speedup",
+              "efficiency", ncpus);
+
+  for (int p = 0; p < npartials; p++) {
+    double base = 0;
+    for (int j = 0; j < nworkers; j++) {
+      double us = run_config(partials[p], workers[j], n, sr, min_ms * 1e6);
+      double load = us * 1e-6 / (n / sr);
+      // against 1 worker: the first count's time, as if it scaled perfectly
+      if (!j) base = us * workers[j];
+      if (csv) {
+        printf("%d,%d,%d,%.3f,%.4f,%.3f,%.3f\n", partials[p], workers[j], n,
+               us, load, base / us, base / us / workers[j]);
+      } else {
+        printf("%-9d %8d %6d %10.2f %7.3f %8.2f %11.2f\n", partials[p],
+               workers[j], n, us, load, base / us, base / us / workers[j]);
+      }
+      fflush(stdout);
+    }
+  }
+
+  return 0;
+}
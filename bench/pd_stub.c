@@ -0,0 +1,704 @@
+// Just enough of Pd's runtime (class registry, inlets/outlets, memory, dsp_add)
+// to instantiate the oscillator classes and run their perform routines from a
+// plain executable. Nothing here is meant to be fast except stub_run(); the
+// rest only runs at setup time.
+
+#include "pd_stub.h"
+#include "g_canvas.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int stub_quiet = 0;
+
+t_symbol s_signal = {"signal", NULL};
+t_symbol s_float = {"float", NULL};
+t_symbol s_symbol = {"symbol", NULL};
+t_symbol s_list = {"list", NULL};
+t_symbol s_bang = {"bang", NULL};
+t_symbol s_ = {"", NULL};
+
+static t_symbol *symlist = NULL;
+
+t_symbol *gensym(const char *s)
+{
+  t_symbol *builtins[] = {&s_signal, &s_float, &s_symbol, &s_list, &s_bang, &s_};
+  for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+    if (!strcmp(builtins[i]->s_name, s)) return builtins[i];
+  }
+  for (t_symbol *sym = symlist; sym; sym = sym->s_next) {
+    if (!strcmp(sym->s_name, s)) return sym;
+  }
+  t_symbol *sym = (t_symbol *)calloc(1, sizeof(t_symbol));
+  sym->s_name = strdup(s);
+  sym->s_next = symlist;
+  symlist = sym;
+  return sym;
+}
+
+/* ------------------------------ classes -------------------------------- */
+
+typedef struct _stubmethod
+{
+  t_symbol *m_sel;
+  t_method m_fn;
+  t_atomtype m_args[MAXPDARG + 1];
+  struct _stubmethod *m_next;
+} t_stubmethod;
+
+struct _class
+{
+  t_symbol *c_name;
+  t_newmethod c_new;
+  t_method c_free;
+  size_t c_size;
+  int c_flags;
+  t_atomtype c_args[MAXPDARG + 1];
+  int c_floatsignalin; // byte offset of the main signal inlet's float, or 0
+  t_stubmethod *c_methods;
+  t_class *c_next;
+};
+
+static t_class *classlist = NULL;
+
+static void collect_args(t_atomtype *dest, t_atomtype first, va_list ap)
+{
+  int i = 0;
+  t_atomtype t = first;
+  while (t != A_NULL && i < MAXPDARG) {
+    dest[i++] = t;
+    t = (t_atomtype)va_arg(ap, int);
+  }
+  dest[i] = A_NULL;
+}
+
+t_class *class_new(t_symbol *name, t_newmethod newmethod,
+  t_method freemethod, size_t size, int flags, t_atomtype arg1, ...)
+{
+  t_class *c = (t_class *)calloc(1, sizeof(t_class));
+  va_list ap;
+  c->c_name = name;
+  c->c_new = newmethod;
+  c->c_free = freemethod;
+  c->c_size = size;
+  c->c_flags = flags;
+  va_start(ap, arg1);
+  collect_args(c->c_args, arg1, ap);
+  va_end(ap);
+  c->c_next = classlist;
+  classlist = c;
+  return c;
+}
+
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+  t_atomtype arg1, ...)
+{
+  t_stubmethod *m = (t_stubmethod *)calloc(1, sizeof(t_stubmethod));
+  va_list ap;
+  m->m_sel = sel;
+  m->m_fn = fn;
+  va_start(ap, arg1);
+  collect_args(m->m_args, arg1, ap);
+  va_end(ap);
+  m->m_next = c->c_methods;
+  c->c_methods = m;
+}
+
+void class_domainsignalin(t_class *c, int onset)
+{
+  c->c_floatsignalin = onset;
+}
+
+static t_class *findclass(const char *name)
+{
+  for (t_class *c = classlist; c; c = c->c_next) {
+    if (!strcmp(c->c_name->s_name, name)) return c;
+  }
+  return NULL;
+}
+
+static t_stubmethod *findmethod(t_class *c, const char *sel)
+{
+  for (t_stubmethod *m = c->c_methods; m; m = m->m_next) {
+    if (!strcmp(m->m_sel->s_name, sel)) return m;
+  }
+  return NULL;
+}
+
+/* --------------------------- objects, inlets --------------------------- */
+
+// inlets and outlets aren't reachable from the (opaque) t_object here, so
+// each object gets a side record that the harness looks up by pointer
+static t_class inlet_sentinel;
+
+struct _inlet
+{
+  t_pd i_pd; // points at inlet_sentinel so pd_float() can tell inlets apart
+  t_object *i_owner;
+  t_symbol *i_type;
+  t_float i_scalar;
+  struct _inlet *i_next;
+};
+
+struct _outlet
+{
+  t_object *o_owner;
+  t_symbol *o_type;
+  struct _outlet *o_next;
+};
+
+typedef struct _stubobject
+{
+  t_object *s_obj;
+  t_inlet *s_inlets;
+  t_outlet *s_outlets;
+  struct _stubobject *s_next;
+} t_stubobject;
+
+static t_stubobject *objlist = NULL;
+
+static t_stubobject *findobject(const t_object *x)
+{
+  for (t_stubobject *so = objlist; so; so = so->s_next) {
+    if (so->s_obj == x) return so;
+  }
+  return NULL;
+}
+
+static t_stubobject *getobject(t_object *x)
+{
+  t_stubobject *so = findobject(x);
+  if (!so) {
+    so = (t_stubobject *)calloc(1, sizeof(t_stubobject));
+    so->s_obj = x;
+    so->s_next = objlist;
+    objlist = so;
+  }
+  return so;
+}
+
+t_pd *pd_new(t_class *cls)
+{
+  t_pd *x = (t_pd *)calloc(1, cls->c_size);
+  *x = cls;
+  return x;
+}
+
+void pd_float(t_pd *x, t_float f)
+{
+  if (*x == &inlet_sentinel) {
+    ((t_inlet *)x)->i_scalar = f;
+  } else if ((*x)->c_floatsignalin) {
+    *(t_float *)((char *)x + (*x)->c_floatsignalin) = f;
+  }
+}
+
+// only objects of the classes here; nothing is ever bound to a symbol
+void pd_list(t_pd *x, t_symbol *s, int argc, t_atom *argv)
+{
+  (void)s;
+  stub_send(x, "list", argc, argv);
+}
+
+t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1, t_symbol *s2)
+{
+  t_stubobject *so = getobject(owner);
+  t_inlet *in = (t_inlet *)calloc(1, sizeof(t_inlet));
+  t_inlet **tail = &so->s_inlets;
+  (void)dest;
+  (void)s2;
+  in->i_pd = &inlet_sentinel;
+  in->i_owner = owner;
+  in->i_type = s1;
+  while (*tail) tail = &(*tail)->i_next;
+  *tail = in;
+  return in;
+}
+
+void inlet_free(t_inlet *x)
+{
+  t_stubobject *so = findobject(x->i_owner);
+  if (so) {
+    for (t_inlet **ip = &so->s_inlets; *ip; ip = &(*ip)->i_next) {
+      if (*ip == x) {
+        *ip = x->i_next;
+        break;
+      }
+    }
+  }
+  free(x);
+}
+
+t_outlet *outlet_new(t_object *owner, t_symbol *s)
+{
+  t_stubobject *so = getobject(owner);
+  t_outlet *out = (t_outlet *)calloc(1, sizeof(t_outlet));
+  t_outlet **tail = &so->s_outlets;
+  out->o_owner = owner;
+  out->o_type = s;
+  while (*tail) tail = &(*tail)->o_next;
+  *tail = out;
+  return out;
+}
+
+void outlet_free(t_outlet *x)
+{
+  t_stubobject *so = findobject(x->o_owner);
+  if (so) {
+    for (t_outlet **op = &so->s_outlets; *op; op = &(*op)->o_next) {
+      if (*op == x) {
+        *op = x->o_next;
+        break;
+      }
+    }
+  }
+  free(x);
+}
+
+/* ----------------------------- connections ----------------------------- */
+
+// one canvas holding everything; its "lines" are the signal connections the
+// harness declared with stub_connect_signal()
+struct _glist
+{
+  int gl_unused;
+};
+
+static t_canvas stub_canvas;
+
+struct _outconnect
+{
+  t_object *oc_to;
+  int oc_inno;
+  struct _outconnect *oc_next;
+};
+
+static t_outconnect *connections = NULL;
+
+t_glist *canvas_getcurrent(void)
+{
+  return &stub_canvas;
+}
+
+// the harness builds the chains itself (stub_dsp), so there's nothing to redo
+void canvas_update_dsp(void)
+{
+}
+
+int obj_issignaloutlet(const t_object *x, int m)
+{
+  (void)x;
+  (void)m;
+  return 1;
+}
+
+void linetraverser_start(t_linetraverser *t, t_canvas *x)
+{
+  t->tr_x = x;
+  t->tr_nextoc = connections;
+}
+
+t_outconnect *linetraverser_next(t_linetraverser *t)
+{
+  t_outconnect *oc = t->tr_nextoc;
+  if (!oc) return NULL;
+  t->tr_ob = NULL;
+  t->tr_outno = 0;
+  t->tr_ob2 = oc->oc_to;
+  t->tr_inno = oc->oc_inno;
+  t->tr_nextoc = oc->oc_next;
+  return oc;
+}
+
+void stub_connect_signal(t_pd *x, int inlet)
+{
+  t_outconnect *oc = (t_outconnect *)calloc(1, sizeof(t_outconnect));
+  oc->oc_to = (t_object *)x;
+  oc->oc_inno = inlet;
+  oc->oc_next = connections;
+  connections = oc;
+}
+
+static void disconnect_all(t_object *x)
+{
+  t_outconnect **op = &connections;
+  while (*op) {
+    if ((*op)->oc_to == x) {
+      t_outconnect *oc = *op;
+      *op = oc->oc_next;
+      free(oc);
+    } else {
+      op = &(*op)->oc_next;
+    }
+  }
+}
+
+/* ------------------------------- misc ---------------------------------- */
+
+void *getbytes(size_t nbytes)
+{
+  return calloc(1, nbytes ? nbytes : 1);
+}
+
+void *resizebytes(void *old, size_t oldsize, size_t newsize)
+{
+  char *p = (char *)realloc(old, newsize ? newsize : 1);
+  if (p && newsize > oldsize) memset(p + oldsize, 0, newsize - oldsize);
+  return p;
+}
+
+void freebytes(void *x, size_t nbytes)
+{
+  (void)nbytes;
+  free(x);
+}
+
+void post(const char *fmt, ...)
+{
+  va_list ap;
+  if (stub_quiet) return;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+void logpost(const void *object, int level, const char *fmt, ...)
+{
+  va_list ap;
+  (void)object;
+  (void)level;
+  if (stub_quiet) return;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+void pd_error(const void *object, const char *fmt, ...)
+{
+  va_list ap;
+  (void)object;
+  va_start(ap, fmt);
+  fputs("error: ", stderr);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+t_float atom_getfloatarg(int which, int argc, const t_atom *argv)
+{
+  if (which < 0 || which >= argc || argv[which].a_type != A_FLOAT) return 0;
+  return argv[which].a_w.w_float;
+}
+
+t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv)
+{
+  if (which < 0 || which >= argc || argv[which].a_type != A_SYMBOL) return &s_;
+  return argv[which].a_w.w_symbol;
+}
+
+/* -------------------------------- dsp ---------------------------------- */
+
+static t_int *chain = NULL;
+static int chainsize = 0;
+
+/* -------------------------------- arrays ------------------------------- */
+
+static t_class garray_stubclass;
+t_class *garray_class = &garray_stubclass;
+
+struct _garray
+{
+  t_pd g_pd; // garray_class
+  t_symbol *g_name;
+  int g_n;
+  t_word *g_vec;
+  struct _garray *g_next;
+};
+
+static t_garray *arraylist = NULL;
+
+t_word *stub_array(const char *name, int n)
+{
+  t_symbol *s = gensym(name);
+  t_garray *a;
+  t_word *vec = (t_word *)calloc(n > 0 ? n : 1, sizeof(t_word));
+
+  if (!vec) return NULL;
+  for (a = arraylist; a && a->g_name != s; a = a->g_next)
+    ;
+  if (!a) {
+    if (!(a = (t_garray *)calloc(1, sizeof(t_garray)))) {
+      free(vec);
+      return NULL;
+    }
+    a->g_pd = garray_class;
+    a->g_name = s;
+    a->g_next = arraylist;
+    arraylist = a;
+  }
+  free(a->g_vec);
+  a->g_vec = vec;
+  a->g_n = n;
+  return vec;
+}
+
+t_pd *pd_findbyclass(t_symbol *s, const t_class *c)
+{
+  if (c != garray_class) return NULL;
+  for (t_garray *a = arraylist; a; a = a->g_next) {
+    if (a->g_name == s) return &a->g_pd;
+  }
+  return NULL;
+}
+
+int garray_getfloatwords(t_garray *x, int *size, t_word **vec)
+{
+  *size = x->g_n;
+  *vec = x->g_vec;
+  return 1;
+}
+
+void garray_usedindsp(t_garray *x)
+{
+}
+
+/* ----------------------------- logical time ---------------------------- */
+
+static double stub_time = 0;
+
+void stub_settime(double ms)
+{
+  stub_time = ms;
+}
+
+double clock_getlogicaltime(void)
+{
+  return stub_time;
+}
+
+double clock_gettimesince(double prevsystime)
+{
+  return stub_time - prevsystime;
+}
+
+static t_int *stub_done(t_int *w)
+{
+  (void)w;
+  return 0;
+}
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+  va_list ap;
+  chain = (t_int *)realloc(chain, (chainsize + n + 1) * sizeof(t_int));
+  chain[chainsize++] = (t_int)f;
+  va_start(ap, n);
+  for (int i = 0; i < n; i++) chain[chainsize++] = va_arg(ap, t_int);
+  va_end(ap);
+}
+
+/* ---------------------------- harness API ------------------------------ */
+
+t_pd *stub_new(const char *name, int argc, t_atom *argv)
+{
+  t_class *c = findclass(name);
+  t_float f[MAXPDARG] = {0};
+  int nf = 0;
+
+  if (!c) return NULL;
+  if (c->c_args[0] == A_GIMME) {
+    return ((t_pd *(*)(t_symbol *, int, t_atom *))c->c_new)(gensym(name),
+      argc, argv);
+  }
+  for (int i = 0; c->c_args[i] != A_NULL; i++) {
+    if (c->c_args[i] != A_FLOAT && c->c_args[i] != A_DEFFLOAT) return NULL;
+    f[nf++] = atom_getfloatarg(i, argc, argv);
+  }
+  switch (nf) {
+    case 0: return ((t_pd *(*)(void))c->c_new)();
+    case 1: return ((t_pd *(*)(t_floatarg))c->c_new)(f[0]);
+    case 2: return ((t_pd *(*)(t_floatarg, t_floatarg))c->c_new)(f[0], f[1]);
+    case 3: return ((t_pd *(*)(t_floatarg, t_floatarg, t_floatarg))c->c_new)(
+              f[0], f[1], f[2]);
+    default: return NULL;
+  }
+}
+
+void stub_free(t_pd *x)
+{
+  t_stubobject *so;
+  if ((*x)->c_free) ((void (*)(t_pd *))(*x)->c_free)(x);
+  disconnect_all((t_object *)x);
+  so = findobject((t_object *)x);
+  if (so) {
+    while (so->s_inlets) inlet_free(so->s_inlets);
+    while (so->s_outlets) outlet_free(so->s_outlets);
+    for (t_stubobject **sp = &objlist; *sp; sp = &(*sp)->s_next) {
+      if (*sp == so) {
+        *sp = so->s_next;
+        break;
+      }
+    }
+    free(so);
+  }
+  free(x);
+}
+
+int stub_nsiginlets(t_pd *x)
+{
+  t_stubobject *so = findobject((t_object *)x);
+  int n = (*x)->c_floatsignalin ? 1 : 0;
+  for (t_inlet *in = so ? so->s_inlets : NULL; in; in = in->i_next) {
+    if (in->i_type == &s_signal) n++;
+  }
+  return n;
+}
+
+int stub_siginlet(t_pd *x, int sig)
+{
+  t_stubobject *so = findobject((t_object *)x);
+  int inlet = 1; // past the main one, which every object has
+  if ((*x)->c_floatsignalin && sig-- == 0) return 0;
+  for (t_inlet *in = so ? so->s_inlets : NULL; in; in = in->i_next, inlet++) {
+    if (in->i_type == &s_signal && sig-- == 0) return inlet;
+  }
+  return -1;
+}
+
+int stub_nsigoutlets(t_pd *x)
+{
+  t_stubobject *so = findobject((t_object *)x);
+  int n = 0;
+  for (t_outlet *out = so ? so->s_outlets : NULL; out; out = out->o_next) {
+    if (out->o_type == &s_signal) n++;
+  }
+  return n;
+}
+
+t_float stub_inlet_scalar(t_pd *x, int inlet)
+{
+  t_stubobject *so = findobject((t_object *)x);
+  if (inlet == 0 && (*x)->c_floatsignalin) {
+    return *(t_float *)((char *)x + (*x)->c_floatsignalin);
+  }
+  if ((*x)->c_floatsignalin) inlet--;
+  for (t_inlet *in = so ? so->s_inlets : NULL; in; in = in->i_next) {
+    if (in->i_type != &s_signal) continue;
+    if (inlet-- == 0) return in->i_scalar;
+  }
+  return 0;
+}
+
+// Pd allocates a new signal here; the harness already gave the outlet enough
+// room, so this only checks it
+void signal_setmultiout(t_signal **sig, int nchans)
+{
+  if (nchans < 1 || nchans * (*sig)->s_length > (*sig)->s_nalloc) {
+    fprintf(stderr, "signal_setmultiout: no room for %d channels\n", nchans);
+    abort();
+  }
+  (*sig)->s_nchans = nchans;
+}
+
+t_int *stub_dsp_mc(t_pd *x, t_float sr, int n, const int *nchans,
+  t_sample **ins, t_sample **outs, int *outchans)
+{
+  int nin = stub_nsiginlets(x), nout = stub_nsigoutlets(x), most = 1;
+  t_signal *sigs = (t_signal *)calloc(nin + nout, sizeof(t_signal));
+  t_signal **sp = (t_signal **)calloc(nin + nout, sizeof(t_signal *));
+  t_stubmethod *m = findmethod(*x, "dsp");
+  t_int *result;
+
+  for (int i = 0; i < nin; i++) {
+    if (nchans && nchans[i] > most) most = nchans[i];
+  }
+  for (int i = 0; i < nin + nout; i++) {
+    sigs[i].s_n = sigs[i].s_length = n;
+    sigs[i].s_nchans = i < nin && nchans ? nchans[i] : 1;
+    sigs[i].s_nalloc = i < nin ? sigs[i].s_nchans * n : most * n;
+    sigs[i].s_sr = sr;
+    sigs[i].s_vec = i < nin ? ins[i] : outs[i - nin];
+    sp[i] = &sigs[i];
+  }
+
+  chain = NULL;
+  chainsize = 0;
+  if (m) ((void (*)(t_pd *, t_signal **))m->m_fn)(x, sp);
+  dsp_add(stub_done, 0);
+  result = chain;
+  chain = NULL;
+  chainsize = 0;
+
+  for (int i = 0; outchans && i < nout; i++) outchans[i] = sp[nin + i]->s_nchans;
+  free(sp);
+  free(sigs);
+  return result;
+}
+
+t_int *stub_dsp(t_pd *x, t_float sr, int n, t_sample **ins, t_sample **outs)
+{
+  return stub_dsp_mc(x, sr, n, NULL, ins, outs, NULL);
+}
+
+void stub_freechain(t_int *c)
+{
+  free(c);
+}
+
+int stub_understands(const char *name, const char *sel)
+{
+  t_class *c = findclass(name);
+  return c && findmethod(c, sel);
+}
+
+int stub_send(t_pd *x, const char *sel, int argc, t_atom *argv)
+{
+  t_stubmethod *m = findmethod(*x, sel);
+  t_float f[MAXPDARG] = {0};
+  int nf = 0;
+
+  if (!m) return 0;
+  if (m->m_args[0] == A_GIMME) {
+    ((void (*)(t_pd *, t_symbol *, int, t_atom *))m->m_fn)(x, gensym(sel),
+      argc, argv);
+    return 1;
+  }
+  if ((m->m_args[0] == A_SYMBOL || m->m_args[0] == A_DEFSYM)
+      && m->m_args[1] == A_NULL) {
+    ((void (*)(t_pd *, t_symbol *))m->m_fn)(x, atom_getsymbolarg(0, argc,
+      argv));
+    return 1;
+  }
+  if (m->m_args[0] == A_SYMBOL && m->m_args[1] == A_SYMBOL
+      && m->m_args[2] == A_NULL) {
+    ((void (*)(t_pd *, t_symbol *, t_symbol *))m->m_fn)(x,
+      atom_getsymbolarg(0, argc, argv), atom_getsymbolarg(1, argc, argv));
+    return 1;
+  }
+  if (m->m_args[0] == A_SYMBOL
+      && (m->m_args[1] == A_FLOAT || m->m_args[1] == A_DEFFLOAT)
+      && m->m_args[2] == A_NULL) {
+    ((void (*)(t_pd *, t_symbol *, t_floatarg))m->m_fn)(x,
+      atom_getsymbolarg(0, argc, argv), atom_getfloatarg(1, argc, argv));
+    return 1;
+  }
+  for (int i = 0; m->m_args[i] != A_NULL; i++) {
+    if (m->m_args[i] != A_FLOAT && m->m_args[i] != A_DEFFLOAT) return 0;
+    f[nf++] = atom_getfloatarg(i, argc, argv);
+  }
+  switch (nf) {
+    case 0: ((void (*)(t_pd *))m->m_fn)(x); break;
+    case 1: ((void (*)(t_pd *, t_floatarg))m->m_fn)(x, f[0]); break;
+    case 2: ((void (*)(t_pd *, t_floatarg, t_floatarg))m->m_fn)(x, f[0], f[1]);
+      break;
+    case 3: ((void (*)(t_pd *, t_floatarg, t_floatarg, t_floatarg))m->m_fn)(x,
+      f[0], f[1], f[2]);
+      break;
+    default: return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,69 @@
+// Harness-side API of the Pd shim in pd_stub.c. These calls stand in for what
+// Pd itself does when it loads a class, creates an object and builds the DSP
+// chain, so that oscbench can drive the perform routines directly.
+
+#ifndef PD_STUB_H
+#define PD_STUB_H
+
+#include "m_pd.h"
+
+// silence post() while benchmarking
+extern int stub_quiet;
+
+// instantiate a registered class the way Pd would for "[name args...("
+t_pd *stub_new(const char *name, int argc, t_atom *argv);
+void stub_free(t_pd *x);
+
+// pretend a signal outlet is connected to inlet number `inlet` (counting all
+// inlets, like Pd's line traverser does); without this every inlet looks like
+// it only gets floats
+void stub_connect_signal(t_pd *x, int inlet);
+
+// signal inlets include the main (leftmost) one
+int stub_nsiginlets(t_pd *x);
+int stub_nsigoutlets(t_pd *x);
+
+// the inlet number (counting all inlets, for stub_connect_signal()) of signal
+// inlet number `sig`, or -1 if there's no such inlet
+int stub_siginlet(t_pd *x, int sig);
+
+// the scalar Pd would copy into an unconnected signal inlet
+t_float stub_inlet_scalar(t_pd *x, int inlet);
+
+// call the class's "dsp" method and collect what it passed to dsp_add() into
+// a chain terminated like Pd's, ready for stub_run(); free with stub_freechain
+t_int *stub_dsp(t_pd *x, t_float sr, int n, t_sample **ins, t_sample **outs);
+
+// same with multichannel inputs: inlet i has nchans[i] channels of n samples
+// one after the other, and every outlet needs room for as many channels as
+// the most any inlet has. The channels the class gave each outlet go in
+// outchans (if that's not NULL).
+t_int *stub_dsp_mc(t_pd *x, t_float sr, int n, const int *nchans,
+  t_sample **ins, t_sample **outs, int *outchans);
+void stub_freechain(t_int *chain);
+
+// send a message to an object; returns 0 if the class has no such method
+int stub_send(t_pd *x, const char *sel, int argc, t_atom *argv);
+
+// whether class `name` has a method for `sel`
+int stub_understands(const char *name, const char *sel);
+
+// a float array called `name` with n elements, all 0, for pd_findbyclass() to
+// find; an existing one is resized. Returns its values for the harness to
+// fill in (or NULL if out of memory).
+t_word *stub_array(const char *name, int n);
+
+// Pd's logical time, what clock_getlogicaltime() returns (in ms here, Pd has
+// units of its own). It only moves when the harness moves it: for a message on
+// sample s of a block, set it to the block's start plus s samples, send, and
+// set it to the block's end before stub_run(), which is when Pd runs DSP.
+void stub_settime(double ms);
+
+// same loop as Pd's dsp_tick()
+static inline void stub_run(t_int *chain)
+{
+  t_int *ip = chain;
+  while (ip) ip = (*(t_perfroutine)(*ip))(ip);
+}
+
+#endif
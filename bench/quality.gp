@@ -0,0 +1,39 @@
+# Plots bench/quality.csv (from `make quality`) into bench/quality.png: one
+# panel per measure, one line per variant, against the frequency at 48 kHz.
+
+set datafile separator ","
+set terminal pngcairo size 1400,1000 font ",10"
+set output "bench/quality.png"
+set multiplot layout 2,2
+set logscale x
+set grid
+set key bottom left font ",8"
+set xlabel "frequency at 48 kHz (Hz)"
+
+# the variants, in the order they're in the file
+n = int(system("tail -n +2 bench/quality.csv | cut -d, -f1 | uniq | wc -l"))
+array names[n]
+do for [i=1:n] {
+  names[i] = system(sprintf("tail -n +2 bench/quality.csv | cut -d, -f1 | uniq | sed -n %dp", i))
+}
+row(i, col) = (strcol(1) eq names[i]) ? column(col) : NaN
+
+set title "THD+N"
+set ylabel "dB"
+plot for [i=1:n] "bench/quality.csv" skip 1 \
+  using 4:(row(i, 5)) with linespoints title names[i]
+
+set title "SFDR"
+plot for [i=1:n] "bench/quality.csv" skip 1 \
+  using 4:(row(i, 6)) with linespoints title names[i]
+
+set title "aliasing"
+plot for [i=1:n] "bench/quality.csv" skip 1 \
+  using 4:(row(i, 7)) with linespoints title names[i]
+
+set title "cost"
+set ylabel "cycles/sample"
+plot for [i=1:n] "bench/quality.csv" skip 1 \
+  using 4:(row(i, 8)) with linespoints title names[i]
+
+unset multiplot
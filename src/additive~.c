@@ -0,0 +1,737 @@
+// Additive synthesis from two arrays: one sine per element, for resynthesis
+// with thousands of partials, spread over several threads.
+//
+// [additive~ <frequencies> <amplitudes> <threads>]: partial i plays at
+// frequencies[i] Hz with amplitude amplitudes[i], as many partials as the
+// shorter array has elements. The arrays are read every block, so writing to
+// them changes the sound from the next one on, with the amplitudes ramped
+// over the block so partials don't click. The oscillators are osc_bank~'s:
+// the same table and SIMD kernels, a vector's worth of partials side by side,
+// and groups that stay silent for the block skipped.
+//
+// The partials are split into one run per worker (pool.h), by default one
+// worker per CPU with Pd's own thread as the first. Each worker adds up its
+// partials into a buffer of its own, and Pd's thread adds the buffers up.
+// The split doesn't change from block to block, so neither does the order
+// the partials are added up in, and the output is the same every run. With
+// only a few partials per worker waking the others costs more than it saves,
+// so fewer of them are used.
+//
+// With `mode ifft` the partials are drawn into a spectrum instead, once a
+// frame, and an inverse FFT (fft.h) turns that into sound: each partial is
+// 8 bins of a 4 term Blackman-Harris window's spectrum, worked out once and
+// looked up for where between bins the partial falls (the FFT-1 method of
+// Rodet and Depalle). The frame is then divided by the window and overlap-
+// added under triangles, a quarter frame apart, only its middle half used
+// so the division doesn't blow up the window's edges. That costs 8 complex
+// multiply-adds per partial per hop rather than one table lookup per
+// partial per sample, plus the FFT, which for a few hundred partials and up
+// is a lot less. What's given up: frequencies and amplitudes are only read
+// once a hop (a quarter frame), with the amplitudes going linearly and the
+// frequencies crossfading from one frame to the next, and the leakage of the
+// window past its 8 bins is left out, which puts an error about 90 dB down
+// on each partial. The workers split the partials the same way, each drawing
+// into a spectrum of its own.
+//
+// Messages:
+//
+//   set <frequencies> <amplitudes>: read from other arrays
+//   threads <n>: run on n workers, 0 for one per CPU
+//   mode osc: one oscillator per partial (the default)
+//   mode ifft [frame]: inverse FFT with frames of that many samples, a power
+//     of 2 from 128 to 16384, 1024 by default
+//   kernel, stats: see kernels.h and stats.h
+
+#include "m_pd.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "wavetable.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+#include "pool.h"
+#include "fft.h"
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+// same table as modern_osc~ and osc_bank~, so they share it
+#define WAVETABLE_BITS 12
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+
+// Workers get whole chunks of partials: a multiple of every kernel set's
+// width, and of a cache line's worth of phases, so two workers never write
+// to the same line.
+#define ADDITIVE_CHUNK 64
+
+// the fewest partials a worker is woken for
+#define ADDITIVE_MINSHARE 256
+
+#define ADDITIVE_MAXTHREADS 64
+
+// the IFFT mode: frame sizes, the fewest partials a worker is woken for (a
+// partial costs a lot less there), and how finely the window's spectrum is
+// tabulated between bins
+#define ADDITIVE_DEFFRAME 1024
+#define ADDITIVE_MINFRAME 128
+#define ADDITIVE_MAXFRAME 16384
+#define ADDITIVE_IFFT_MINSHARE 1024
+#define ADDITIVE_TAPS 8
+#define ADDITIVE_STEPS 256
+
+static t_class *additive_class = NULL;
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
+
+// what one worker adds its partials up in
+typedef struct _additive_buf {
+  float *acc; // one sum per lane per sample, see osc_simd_bank_group()
+  int accsize;
+  t_sample *sum; // and those added up; worker 0 uses the outlet's instead
+  int sumsize;
+  float *spec; // the IFFT mode's spectrum; worker 0 uses x_spec
+  int specsize;
+} t_additive_buf;
+
+typedef struct _additive {
+  t_object x_obj;
+  double x_conv; // phase increment per Hz, see phase.h
+  t_symbol *x_freqname;
+  t_symbol *x_ampname;
+  t_word *x_freqvec; // NULL if there's no such array
+  t_word *x_ampvec;
+  int x_npartials; // the shorter array's size
+
+  // per partial, x_nalloc of them: a whole number of chunks, the ones past
+  // x_npartials silent
+  int x_nalloc;
+  t_osc_phase *x_phase;
+  t_osc_phase *x_inc;
+  float *x_amp; // where the ramp is now
+  float *x_damp; // ramp step per sample for this block
+
+  int x_nworkers; // including Pd's thread
+  t_osc_pool *x_pool; // NULL with one worker
+  t_additive_buf *x_bufs; // one per worker
+
+  // for the workers, while a block runs
+  t_sample *x_out;
+  int x_n;
+
+  // The IFFT mode, x_frame samples a frame (0 in the oscillator mode). There
+  // x_phase is each partial's phase in the middle of the last frame and
+  // x_inc the increment it had there.
+  int x_frame;
+  t_osc_fft x_fft;
+  float *x_kernel; // ADDITIVE_STEPS + 1 rows of taps, see additive_draw()
+  float *x_post; // what the frame's middle half is multiplied by
+  float *x_spec; // bins 0 ... x_frame / 2, real parts then imaginary
+  float *x_wave; // the frame
+  float *x_ola; // the next half frame of output
+  int x_olapos; // how much of its first hop is already out
+
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_outlet *x_outlet;
+  t_osc_stats x_stats; // see stats.h
+} t_additive;
+
+static void additive_free_partials(t_additive *x)
+{
+  int n = x->x_nalloc;
+  if (!n) return;
+  freebytes(x->x_phase, n * sizeof(t_osc_phase));
+  freebytes(x->x_inc, n * sizeof(t_osc_phase));
+  freebytes(x->x_amp, n * sizeof(float));
+  freebytes(x->x_damp, n * sizeof(float));
+  x->x_nalloc = 0;
+}
+
+// Room for x_npartials. The ones that were already there keep their phase
+// and amplitude, so a resized array doesn't click or restart.
+static void additive_alloc_partials(t_additive *x)
+{
+  int n = (x->x_npartials + ADDITIVE_CHUNK - 1) / ADDITIVE_CHUNK
+    * ADDITIVE_CHUNK;
+  t_osc_phase *phase, *inc;
+  float *amp, *damp;
+  int keep;
+
+  if (n == x->x_nalloc) return;
+  if (!n) {
+    additive_free_partials(x);
+    return;
+  }
+  phase = (t_osc_phase *)getbytes(n * sizeof(t_osc_phase));
+  inc = (t_osc_phase *)getbytes(n * sizeof(t_osc_phase));
+  amp = (float *)getbytes(n * sizeof(float));
+  damp = (float *)getbytes(n * sizeof(float));
+  if (!phase || !inc || !amp || !damp) {
+    pd_error(x, "additive~: out of memory");
+    if (phase) freebytes(phase, n * sizeof(t_osc_phase));
+    if (inc) freebytes(inc, n * sizeof(t_osc_phase));
+    if (amp) freebytes(amp, n * sizeof(float));
+    if (damp) freebytes(damp, n * sizeof(float));
+    additive_free_partials(x);
+    x->x_npartials = 0;
+    return;
+  }
+  keep = n < x->x_nalloc ? n : x->x_nalloc;
+  for (int i = 0; i < keep; i++) {
+    phase[i] = x->x_phase[i];
+    amp[i] = x->x_amp[i];
+  }
+  // new ones start at scattered phases (steps of the golden ratio), so a
+  // harmonic spectrum doesn't start as one big click; getbytes zeroes the rest
+  for (int i = keep; i < n; i++) phase[i] = (t_osc_phase)i * 2654435769u;
+  additive_free_partials(x);
+  x->x_phase = phase;
+  x->x_inc = inc;
+  x->x_amp = amp;
+  x->x_damp = damp;
+  x->x_nalloc = n;
+}
+
+static t_word *additive_array(t_additive *x, t_symbol *s, int *size)
+{
+  t_garray *a = (t_garray *)pd_findbyclass(s, garray_class);
+  t_word *vec;
+
+  if (!a) {
+    if (*s->s_name) pd_error(x, "additive~: %s: no such array", s->s_name);
+    return NULL;
+  }
+  if (!garray_getfloatwords(a, size, &vec)) {
+    pd_error(x, "additive~: %s: bad template", s->s_name);
+    return NULL;
+  }
+  // so Pd rebuilds the chain, and this runs again, if it's resized
+  garray_usedindsp(a);
+  return vec;
+}
+
+// look the arrays up again; also from the dsp method, like tabosc4~
+static void additive_set(t_additive *x, t_symbol *freqs, t_symbol *amps)
+{
+  int nfreq = 0, namp = 0;
+
+  x->x_freqname = freqs;
+  x->x_ampname = amps;
+  x->x_freqvec = additive_array(x, freqs, &nfreq);
+  x->x_ampvec = additive_array(x, amps, &namp);
+  x->x_npartials = x->x_freqvec && x->x_ampvec
+    ? (nfreq < namp ? nfreq : namp) : 0;
+  additive_alloc_partials(x);
+}
+
+static void additive_free_bufs(t_additive *x)
+{
+  if (!x->x_bufs) return;
+  for (int w = 0; w < x->x_nworkers; w++) {
+    t_additive_buf *b = &x->x_bufs[w];
+    if (b->acc) freebytes(b->acc, b->accsize * sizeof(float));
+    if (b->sum) freebytes(b->sum, b->sumsize * sizeof(t_sample));
+    if (b->spec) freebytes(b->spec, b->specsize * sizeof(float));
+  }
+  freebytes(x->x_bufs, x->x_nworkers * sizeof(t_additive_buf));
+  x->x_bufs = NULL;
+}
+
+// every worker's buffers, for blocks of n and the kernel set's width, or the
+// frame size; if they can't all be had there are none, and the perform
+// routine is silent
+static void additive_alloc_bufs(t_additive *x, int n)
+{
+  int width = x->x_kernels->width;
+  int spec = x->x_frame ? 2 * (x->x_frame / 2 + 1) : 0;
+
+  if (!x->x_bufs) {
+    x->x_bufs = (t_additive_buf *)getbytes(
+      x->x_nworkers * sizeof(t_additive_buf));
+    if (!x->x_bufs) goto fail;
+  }
+  for (int w = 0; w < x->x_nworkers; w++) {
+    t_additive_buf *b = &x->x_bufs[w];
+    int accsize = x->x_frame ? 0 : n * width;
+    int sumsize = w && !x->x_frame ? n : 0, specsize = w ? spec : 0;
+    if (b->accsize != accsize) {
+      if (b->acc) freebytes(b->acc, b->accsize * sizeof(float));
+      b->acc = accsize ? (float *)getbytes(accsize * sizeof(float)) : NULL;
+      b->accsize = b->acc ? accsize : 0;
+      if (accsize && !b->acc) goto fail;
+    }
+    if (b->sumsize != sumsize) {
+      if (b->sum) freebytes(b->sum, b->sumsize * sizeof(t_sample));
+      b->sum = sumsize
+        ? (t_sample *)getbytes(sumsize * sizeof(t_sample)) : NULL;
+      b->sumsize = b->sum ? sumsize : 0;
+      if (sumsize && !b->sum) goto fail;
+    }
+    if (b->specsize != specsize) {
+      if (b->spec) freebytes(b->spec, b->specsize * sizeof(float));
+      b->spec = specsize ? (float *)getbytes(specsize * sizeof(float)) : NULL;
+      b->specsize = b->spec ? specsize : 0;
+      if (specsize && !b->spec) goto fail;
+    }
+  }
+  return;
+
+fail:
+  pd_error(x, "additive~: out of memory");
+  additive_free_bufs(x);
+}
+
+// (re)start the workers. Not in the middle of a perform: messages and DSP run
+// on the same thread in Pd.
+static void additive_threads(t_additive *x, t_floatarg f)
+{
+  int n = (int)f;
+
+  if (n <= 0) n = osc_pool_ncpus();
+  if (n > ADDITIVE_MAXTHREADS) n = ADDITIVE_MAXTHREADS;
+  additive_free_bufs(x);
+  osc_pool_free(x->x_pool);
+  x->x_pool = osc_pool_new(n);
+  if (n > 1 && !x->x_pool) {
+    pd_error(x, "additive~: couldn't start %d threads", n - 1);
+    n = 1;
+  }
+  x->x_nworkers = n;
+  if (x->x_n) additive_alloc_bufs(x, x->x_n);
+}
+
+// one partial over n samples, added to out
+static void additive_partial(const float *tab, t_osc_phase *phase,
+  const t_osc_phase *inc, float *amp, const float *damp, t_sample *out, int n)
+{
+  t_osc_phase p = *phase;
+  float a = *amp;
+  while (n--) {
+    uint32_t idx = osc_phase_index(p, WAVETABLE_BITS);
+    float frac = osc_phase_frac(p, WAVETABLE_BITS);
+    *out++ += a * (tab[idx] + frac * (tab[idx + 1] - tab[idx]));
+    p += *inc;
+    a += *damp;
+  }
+  *phase = p;
+  *amp = a;
+}
+
+// A worker's block: its run of the partials, read from the arrays and added
+// up into its buffer. The arrays and everything in x only change between
+// blocks, on Pd's thread, which is in additive_perform() until all of these
+// are done.
+static void additive_work(void *owner, int worker, int nworkers)
+{
+  t_additive *x = (t_additive *)owner;
+  const t_osc_kernels *k = x->x_kernels;
+  t_additive_buf *b = &x->x_bufs[worker];
+  int n = x->x_n;
+  int nchunks = x->x_nalloc / ADDITIVE_CHUNK;
+  int group = k->width ? k->width : 1;
+  int lo, hi;
+  t_sample *sum;
+  float rn = 1.0f / n;
+  double conv = x->x_conv;
+
+  lo = (int)((long long)nchunks * worker / nworkers) * ADDITIVE_CHUNK;
+  hi = (int)((long long)nchunks * (worker + 1) / nworkers) * ADDITIVE_CHUNK;
+  sum = worker ? b->sum : x->x_out;
+
+  if (k->width) {
+    for (int i = 0; i < n * group; i++) b->acc[i] = 0;
+  } else {
+    for (int i = 0; i < n; i++) sum[i] = 0;
+  }
+
+  for (int g = lo; g < hi; g += group) {
+    int active = 0;
+    for (int o = g; o < g + group; o++) {
+      float target = 0;
+      if (o < x->x_npartials) {
+        x->x_inc[o] = osc_phase_wrap(x->x_freqvec[o].w_float * conv);
+        target = x->x_ampvec[o].w_float;
+      }
+      x->x_damp[o] = (target - x->x_amp[o]) * rn;
+      active |= x->x_amp[o] != 0 || target != 0;
+    }
+    if (!active) continue;
+
+    if (k->width) {
+      k->bank_group(cos_table, WAVETABLE_BITS, x->x_phase + g, x->x_inc + g,
+        x->x_amp + g, x->x_damp + g, b->acc, n);
+    } else {
+      additive_partial(cos_table, x->x_phase + g, x->x_inc + g, x->x_amp + g,
+        x->x_damp + g, sum, n);
+    }
+    // land exactly on the target rather than wherever the ramp rounded to
+    for (int o = g; o < g + group; o++)
+      x->x_amp[o] = o < x->x_npartials ? x->x_ampvec[o].w_float : 0;
+  }
+
+  if (k->width) k->bank_sum(b->acc, sum, n);
+}
+
+// Partial with amplitude a, phase p in the middle of the frame and increment
+// inc, drawn into spec. For a frame of n samples and window w, the sine
+// w[t] e^(i (p + 2 pi f (t - n / 2) / n)) at f bins has e^(i p) (-1)^k G(k - f)
+// in bin k, with G the window's spectrum about its middle; the real one is
+// half that plus its mirror image at -f. x_kernel has the 8 bins around f
+// for every 1 / ADDITIVE_STEPS of a bin between floor(f) and floor(f) + 1,
+// the first one 3 bins below floor(f), with the (-1)^k that goes with them
+// taken out of every other tap.
+static void additive_draw(const t_additive *x, float *spec, t_osc_phase p,
+  t_osc_phase inc, float a)
+{
+  int n = x->x_frame, m = n / 2;
+  float *re = spec, *im = spec + m + 1;
+  float bin = (float)(int32_t)inc * ((float)n / 4294967296.0f);
+  float lo = floorf(bin), step = (bin - lo) * ADDITIVE_STEPS, s;
+  int b0 = (int)lo - 3, r = (int)step;
+  uint32_t idx = osc_phase_index(p, WAVETABLE_BITS);
+  float frac = osc_phase_frac(p, WAVETABLE_BITS);
+  float c = cos_table[idx] + frac * (cos_table[idx + 1] - cos_table[idx]);
+  t_osc_phase q = p - 0x40000000u; // a quarter cycle back, for the sine
+  float sn, cr, ci;
+  const float *k0, *k1;
+  float gr[ADDITIVE_TAPS], gi[ADDITIVE_TAPS];
+
+  idx = osc_phase_index(q, WAVETABLE_BITS);
+  frac = osc_phase_frac(q, WAVETABLE_BITS);
+  sn = cos_table[idx] + frac * (cos_table[idx + 1] - cos_table[idx]);
+  if (r >= ADDITIVE_STEPS) r = ADDITIVE_STEPS - 1; // step rounded up to 1
+  s = step - r;
+  a *= (b0 & 1) ? -0.5f : 0.5f;
+  cr = a * c;
+  ci = a * sn;
+
+  k0 = x->x_kernel + r * 2 * ADDITIVE_TAPS;
+  k1 = k0 + 2 * ADDITIVE_TAPS;
+  for (int t = 0; t < ADDITIVE_TAPS; t++) {
+    float kr = k0[t] + s * (k1[t] - k0[t]);
+    float ki = k0[t + ADDITIVE_TAPS] + s * (k1[t + ADDITIVE_TAPS]
+      - k0[t + ADDITIVE_TAPS]);
+    gr[t] = cr * kr - ci * ki;
+    gi[t] = cr * ki + ci * kr;
+  }
+
+  if (b0 >= 1 && b0 + ADDITIVE_TAPS <= m) {
+    for (int t = 0; t < ADDITIVE_TAPS; t++) {
+      re[b0 + t] += gr[t];
+      im[b0 + t] += gi[t];
+    }
+    return;
+  }
+  // near 0 Hz or Nyquist some taps land on the other side of it, where the
+  // mirror image's conjugate goes instead; bins 0 and n / 2 get both
+  for (int t = 0; t < ADDITIVE_TAPS; t++) {
+    int b = (b0 + t) & (n - 1);
+    if (b == 0 || b == m) re[b] += 2 * gr[t];
+    else if (b < m) {
+      re[b] += gr[t];
+      im[b] += gi[t];
+    } else {
+      re[n - b] += gr[t];
+      im[n - b] -= gi[t];
+    }
+  }
+}
+
+// A worker's frame: its run of the partials moved on to the middle of this
+// frame and drawn into its spectrum. The phase moves by the mean of the last
+// frame's increment and this one's, so where the triangles cross the two
+// frames' sines agree on it.
+static void additive_work_ifft(void *owner, int worker, int nworkers)
+{
+  t_additive *x = (t_additive *)owner;
+  int nspec = 2 * (x->x_frame / 2 + 1);
+  t_osc_phase half = (t_osc_phase)(x->x_frame / 8); // half a hop
+  int nchunks = x->x_nalloc / ADDITIVE_CHUNK;
+  int lo, hi;
+  float *spec;
+  double conv = x->x_conv;
+
+  lo = (int)((long long)nchunks * worker / nworkers) * ADDITIVE_CHUNK;
+  hi = (int)((long long)nchunks * (worker + 1) / nworkers) * ADDITIVE_CHUNK;
+  if (hi > x->x_npartials) hi = x->x_npartials;
+  spec = worker ? x->x_bufs[worker].spec : x->x_spec;
+
+  for (int i = 0; i < nspec; i++) spec[i] = 0;
+  for (int o = lo; o < hi; o++) {
+    t_osc_phase inc = osc_phase_wrap(x->x_freqvec[o].w_float * conv);
+    float a = x->x_ampvec[o].w_float;
+    x->x_phase[o] += x->x_inc[o] * half + inc * half;
+    x->x_inc[o] = inc;
+    if (a != 0) additive_draw(x, spec, x->x_phase[o], inc, a);
+  }
+}
+
+// the next frame, overlap-added to x_ola
+static void additive_frame(t_additive *x)
+{
+  int n = x->x_frame, m = n / 2, nspec = 2 * (m + 1);
+  int nactive = x->x_npartials / ADDITIVE_IFFT_MINSHARE;
+
+  nactive = nactive < 1 ? 1 : nactive > x->x_nworkers ? x->x_nworkers
+    : nactive;
+  if (nactive > 1) osc_pool_run(x->x_pool, additive_work_ifft, x, nactive);
+  else additive_work_ifft(x, 0, 1);
+
+  for (int k = 1; k < nactive; k++) {
+    const float *spec = x->x_bufs[k].spec;
+    for (int i = 0; i < nspec; i++) x->x_spec[i] += spec[i];
+  }
+  osc_fft_realinverse(&x->x_fft, x->x_spec, x->x_spec + m + 1, x->x_wave);
+  for (int i = 0; i < m; i++) x->x_ola[i] += x->x_wave[n / 4 + i] * x->x_post[i];
+}
+
+// A frame every hop, so a block of 64 with frames of 1024 does all the work
+// in one block out of four. Each frame's middle half starts at the next
+// sample out, so its triangle fades in over the first hop.
+static void additive_perform_ifft(t_additive *x, t_sample *out, int n)
+{
+  int hop = x->x_frame / 4;
+  float *ola = x->x_ola;
+
+  for (int i = 0; i < n; ) {
+    int k;
+    if (!x->x_olapos) additive_frame(x);
+    k = hop - x->x_olapos < n - i ? hop - x->x_olapos : n - i;
+    for (int j = 0; j < k; j++) out[i + j] = ola[x->x_olapos + j];
+    x->x_olapos += k;
+    i += k;
+    if (x->x_olapos == hop) {
+      memmove(ola, ola + hop, hop * sizeof(float));
+      for (int j = hop; j < 2 * hop; j++) ola[j] = 0;
+      x->x_olapos = 0;
+    }
+  }
+}
+
+static t_int *additive_perform(t_int *w)
+{
+  t_additive *x = (t_additive *)(w[1]);
+  t_sample *out = (t_sample *)(w[2]);
+  int n = (int)(w[3]);
+  int nactive;
+
+  if (!cos_table || !x->x_npartials || !x->x_bufs) goto silent;
+  if (x->x_frame) {
+    additive_perform_ifft(x, out, n);
+    return (w + 4);
+  }
+  nactive = x->x_npartials / ADDITIVE_MINSHARE;
+  nactive = nactive < 1 ? 1 : nactive > x->x_nworkers ? x->x_nworkers
+    : nactive;
+
+  x->x_out = out;
+  x->x_n = n;
+  if (nactive > 1) osc_pool_run(x->x_pool, additive_work, x, nactive);
+  else additive_work(x, 0, 1);
+
+  for (int k = 1; k < nactive; k++) {
+    const t_sample *sum = x->x_bufs[k].sum;
+    for (int i = 0; i < n; i++) out[i] += sum[i];
+  }
+  return (w + 4);
+
+silent:
+  for (int i = 0; i < n; i++) out[i] = 0;
+  return (w + 4);
+}
+
+static void additive_dsp(t_additive *x, t_signal **sp)
+{
+  int n = sp[0]->s_length;
+  char path[OSC_STATS_PATHSIZE];
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  x->x_n = n;
+  additive_set(x, x->x_freqname, x->x_ampname);
+  additive_alloc_bufs(x, n);
+
+  // no signal inlets, so sp[0] is the outlet
+  if (x->x_frame) {
+    snprintf(path, sizeof(path), "ifft %d, %d workers", x->x_frame,
+             x->x_nworkers);
+  } else {
+    snprintf(path, sizeof(path), "%s, %d workers", x->x_kernels->name,
+             x->x_nworkers);
+  }
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(additive_perform, 3, x, sp[0]->s_vec, n);
+  osc_stats_dsp_end(&x->x_stats, path, n);
+}
+
+static void additive_free_ifft(t_additive *x)
+{
+  int n = x->x_frame, m = n / 2;
+  if (!n) return;
+  osc_fft_free(&x->x_fft);
+  if (x->x_kernel) freebytes(x->x_kernel,
+    (ADDITIVE_STEPS + 1) * 2 * ADDITIVE_TAPS * sizeof(float));
+  if (x->x_post) freebytes(x->x_post, m * sizeof(float));
+  if (x->x_spec) freebytes(x->x_spec, 2 * (m + 1) * sizeof(float));
+  if (x->x_wave) freebytes(x->x_wave, n * sizeof(float));
+  if (x->x_ola) freebytes(x->x_ola, m * sizeof(float));
+  x->x_kernel = x->x_post = x->x_spec = x->x_wave = x->x_ola = NULL;
+  x->x_frame = 0;
+}
+
+// 4 term Blackman-Harris, centred, so all its terms are cosines about the
+// middle of the frame: 92 dB sidelobes, main lobe 8 bins wide
+static const double additive_window[4] = {0.35875, 0.48829, 0.14128, 0.01168};
+
+// the spectrum of the n samples of e^(-2 pi i u (t - n / 2) / n)
+static void additive_dirichlet(int n, double u, double *re, double *im)
+{
+  double d = fabs(u) < 1e-9 ? n : sin(M_PI * u) / sin(M_PI * u / n);
+  *re = d * cos(M_PI * u / n);
+  *im = d * sin(M_PI * u / n);
+}
+
+// the window's kernel and what the frames are multiplied by after the IFFT
+static void additive_tables(t_additive *x)
+{
+  int n = x->x_frame, m = n / 2;
+
+  for (int r = 0; r <= ADDITIVE_STEPS; r++) {
+    float *row = x->x_kernel + r * 2 * ADDITIVE_TAPS;
+    for (int t = 0; t < ADDITIVE_TAPS; t++) {
+      double d = t - 3 - (double)r / ADDITIVE_STEPS, gr = 0, gi = 0, re, im;
+      for (int j = 0; j < 4; j++) {
+        double a = j ? additive_window[j] / 2 : additive_window[0];
+        additive_dirichlet(n, d - j, &re, &im);
+        gr += a * re;
+        gi += a * im;
+        if (!j) continue;
+        additive_dirichlet(n, d + j, &re, &im);
+        gr += a * re;
+        gi += a * im;
+      }
+      row[t] = (float)(t & 1 ? -gr : gr);
+      row[t + ADDITIVE_TAPS] = (float)(t & 1 ? -gi : gi);
+    }
+  }
+
+  // over the middle half: a triangle, over the window and the n the inverse
+  // FFT leaves in
+  for (int i = 0; i < m; i++) {
+    double t = n / 4 + i, w = 0;
+    for (int j = 0; j < 4; j++)
+      w += additive_window[j] * cos(2 * M_PI * j * (t - m) / n);
+    x->x_post[i] = (float)((1 - fabs(t - m) / (n / 4)) / (n * w));
+  }
+}
+
+// Switching mode restarts the sound: the oscillators ramp in from silence
+// over a block, the frames fade in over a hop.
+static void additive_mode(t_additive *x, t_symbol *s, t_floatarg f)
+{
+  int n = f ? (int)f : ADDITIVE_DEFFRAME, m = n / 2;
+
+  if (s == gensym("osc")) {
+    additive_free_ifft(x);
+  } else if (s == gensym("ifft")) {
+    if (n < ADDITIVE_MINFRAME || n > ADDITIVE_MAXFRAME || (n & (n - 1))) {
+      pd_error(x, "additive~: frame size %d: must be a power of 2 from %d "
+               "to %d", n, ADDITIVE_MINFRAME, ADDITIVE_MAXFRAME);
+      return;
+    }
+    additive_free_ifft(x);
+    x->x_frame = n;
+    x->x_kernel = (float *)getbytes(
+      (ADDITIVE_STEPS + 1) * 2 * ADDITIVE_TAPS * sizeof(float));
+    x->x_post = (float *)getbytes(m * sizeof(float));
+    x->x_spec = (float *)getbytes(2 * (m + 1) * sizeof(float));
+    x->x_wave = (float *)getbytes(n * sizeof(float));
+    x->x_ola = (float *)getbytes(m * sizeof(float));
+    if (!x->x_kernel || !x->x_post || !x->x_spec || !x->x_wave || !x->x_ola
+        || !osc_fft_init(&x->x_fft, n)) {
+      pd_error(x, "additive~: out of memory");
+      additive_free_ifft(x);
+    } else additive_tables(x);
+    x->x_olapos = 0;
+  } else {
+    pd_error(x, "additive~: mode %s: expected osc or ifft", s->s_name);
+    return;
+  }
+  for (int i = 0; i < x->x_nalloc; i++) x->x_amp[i] = 0;
+  if (x->x_n) additive_alloc_bufs(x, x->x_n);
+  canvas_update_dsp();
+}
+
+// the buffers are sized for the width in the dsp method
+static void additive_kernel(t_additive *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "additive~", &x->x_kernels, s))
+    canvas_update_dsp();
+}
+
+static void additive_stats(t_additive *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "additive~", argc, argv);
+}
+
+static void *additive_new(t_symbol *s, int argc, t_atom *argv)
+{
+  t_additive *x = (t_additive *)pd_new(additive_class);
+
+  x->x_conv = 0;
+  x->x_freqname = atom_getsymbolarg(0, argc, argv);
+  x->x_ampname = atom_getsymbolarg(1, argc, argv);
+  x->x_freqvec = x->x_ampvec = NULL;
+  x->x_npartials = 0;
+  x->x_nalloc = 0;
+  x->x_pool = NULL;
+  x->x_bufs = NULL;
+  x->x_nworkers = 1;
+  x->x_out = NULL;
+  x->x_n = 0;
+  x->x_frame = 0;
+  x->x_kernel = x->x_post = x->x_spec = x->x_wave = x->x_ola = NULL;
+  x->x_olapos = 0;
+  x->x_kernels = osc_kernels_best();
+  osc_stats_init(&x->x_stats);
+  additive_threads(x, atom_getfloatarg(2, argc, argv));
+
+  x->x_outlet = outlet_new(&x->x_obj, &s_signal);
+
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_LINEAR);
+
+  return (void *)x;
+}
+
+static void additive_free(t_additive *x)
+{
+  osc_pool_free(x->x_pool);
+  additive_free_bufs(x);
+  additive_free_partials(x);
+  additive_free_ifft(x);
+  outlet_free(x->x_outlet);
+
+  wavetable_release(cos_table);
+}
+
+void additive_tilde_setup(void)
+{
+  additive_class = class_new(gensym("additive~"),
+                             (t_newmethod)additive_new,
+                             (t_method)additive_free,
+                             sizeof(t_additive),
+                             CLASS_DEFAULT,
+                             A_GIMME, 0);
+
+  class_addmethod(additive_class, (t_method)additive_dsp, gensym("dsp"),
+                  A_CANT, 0);
+  class_addmethod(additive_class, (t_method)additive_set, gensym("set"),
+                  A_SYMBOL, A_SYMBOL, 0);
+  class_addmethod(additive_class, (t_method)additive_threads,
+                  gensym("threads"), A_FLOAT, 0);
+  class_addmethod(additive_class, (t_method)additive_mode, gensym("mode"),
+                  A_SYMBOL, A_DEFFLOAT, 0);
+  class_addmethod(additive_class, (t_method)additive_kernel,
+                  gensym("kernel"), A_DEFSYM, 0);
+  class_addmethod(additive_class, (t_method)additive_stats, gensym("stats"),
+                  A_GIMME, 0);
+}
@@ -0,0 +1,72 @@
+// Cosine from the phase by polynomial, without a table (modern_osc~'s
+// `approx` mode).
+//
+// The phase is folded onto a quarter cycle either side of the sine's zero
+// crossing: cos(2 pi x) = sin(2 pi t) with t = 1/4 - |x| and x the phase as
+// a signed fraction of a cycle. That's integer arithmetic on the fixed-point
+// phase (phase.h), with nothing to branch on. On t in [-1/4, 1/4] the sine is
+// an odd polynomial t * P(t^2), and P's coefficients below are minimax
+// (Remez) fits for the lowest maximum error over the whole cycle. Measured
+// against double precision cos() over every 2^-24 of the cycle, including
+// the float arithmetic:
+//
+//   degree 3: 4.5e-3 (-47 dB)
+//   degree 5: 6.8e-5 (-83 dB)
+//   degree 7: 7.4e-7 (-123 dB)
+//   degree 9: 2.3e-7 (-133 dB), which is float rounding; higher degrees
+//             wouldn't help
+//
+// For comparison, linear interpolation in a 4096 point table (modern_osc~'s)
+// is off by up to 3.5e-7, in a 16384 point one 7.7e-8.
+//
+// Every sample costs the same few multiply-adds and touches no memory at all,
+// so it doesn't care what else is in the cache. Include after m_pd.h.
+
+#ifndef OSC_APPROX_H
+#define OSC_APPROX_H
+
+#include "phase.h"
+
+// P's coefficients for the largest degree
+#define OSC_APPROX_MAXCOEFS 5
+
+// the coefficients for a polynomial of `degree` (3, 5, 7 or 9; there are
+// (degree + 1) / 2 of them, lowest power first), or NULL for any other degree
+static inline const float *osc_approx_coefs(int degree)
+{
+  static const float c3[] = {6.19226474f, -35.3637069f};
+  static const float c5[] = {6.28128008f, -41.0952427f, 73.5855148f};
+  static const float c7[] = {6.28316404f, -41.3371424f, 81.3407689f,
+                             -70.9934333f};
+  static const float c9[] = {6.28318530f, -41.3416919f, 81.6032657f,
+                             -76.5982079f, 39.8732318f};
+  switch (degree) {
+    case 3: return c3;
+    case 5: return c5;
+    case 7: return c7;
+    case 9: return c9;
+    default: return NULL;
+  }
+}
+
+// t = 1/4 - |x| in cycles, in [-1/4, 1/4]. |x| of the most negative phase
+// doesn't fit an int32, but the wrapped subtraction still comes out at -1/4,
+// which is right.
+static inline float osc_approx_t(t_osc_phase p)
+{
+  int32_t s = (int32_t)p;
+  uint32_t a = s < 0 ? 0u - (uint32_t)s : (uint32_t)s;
+  return (float)(int32_t)(0x40000000u - a) * (1.0f / 4294967296.0f);
+}
+
+// cos(2 pi p) with the n coefficients c
+static inline float osc_approx_cos(t_osc_phase p, const float *c, int n)
+{
+  float t = osc_approx_t(p);
+  float t2 = t * t;
+  float y = c[n - 1];
+  for (int i = n - 2; i >= 0; i--) y = y * t2 + c[i];
+  return t * y;
+}
+
+#endif
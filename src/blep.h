@@ -0,0 +1,99 @@
+// Band-limiting for the piecewise-linear waves (triangle~, tri_phase~).
+//
+// A triangle has no jumps, only corners where the slope changes, and those are
+// what alias. PolyBLAMP smooths each corner with a small polynomial: where the
+// slope changes by s per sample, add s * (1 - |x|)^3 / 6 to the samples less
+// than one sample away (|x| < 1) from it. That's the integral of the usual
+// 2-point polyBLEP. It only needs the current sample's phase and how far
+// the phase moves per sample, so there's no delay line or lookahead, and it
+// costs a few multiplies on top of the naive wave.
+//
+// See Esqueda, Valimaki & Bilbao, "Rounding corners with BLAMP" (DAFx 2016).
+//
+// Include after m_pd.h.
+
+#ifndef OSC_BLEP_H
+#define OSC_BLEP_H
+
+#include <math.h>
+#include "phase.h"
+
+// below this many cycles per sample (about 0.005 Hz at 44.1 kHz) the
+// corrections are all 0 anyway. Keeps 1/dt finite and 1 - dt below 1.
+#define OSC_BLAMP_MINDT (1.0f / 8388608.0f)
+
+// x is the distance to the corner in samples
+static inline float osc_blamp(float x)
+{
+  float u = 1.0f - fabsf(x);
+  u = u > 0.0f ? u : 0.0f;
+  return u * u * u * (1.0f / 6.0f);
+}
+
+// a triangle going 0 -> 1 over [0, peak) and back to 0 over [peak, 1), with
+// everything that only depends on the peak or dt worked out by osc_tri_set()
+typedef struct _osc_tri {
+  float peak;
+  float rise; // 1 / peak
+  float fall; // 1 / (1 - peak)
+  float r; // 1 / (peak * (1 - peak)), the slope change at each corner
+  t_osc_phase peakph; // the peak as a phase
+  float rdt; // samples per phase unit
+  float corner; // the slope change per sample
+} t_osc_tri;
+
+static inline void osc_tri_init(t_osc_tri *t)
+{
+  t->peak = -1.0f; // never matches, so the first osc_tri_set() does it all
+  t->rise = t->fall = t->r = t->rdt = t->corner = 0.0f;
+  t->peakph = 0;
+}
+
+// dt is the phase increment in cycles per sample, either sign. At or above
+// Nyquist there's nothing to save, so it's capped at 0.5.
+//
+// The peak is kept at least dt away from 0 and 1. Peak 0 or 1 is a sawtooth,
+// whose jump can't be rounded off as a corner, but two polyBLAMPs a sample
+// apart add up to the polyBLEP a sawtooth needs.
+//
+// The peak's division is only done when the peak changed, so calling this
+// every sample with a constant peak costs one division for 1/dt. (Not worth
+// checking dt the same way: a phase signal coming in as floats jitters in the
+// last bits, and the mispredicted branches cost more than the division.)
+static inline void osc_tri_set(t_osc_tri *t, float peak, float dt)
+{
+  dt = fabsf(dt);
+  dt = dt < 0.5f ? dt : 0.5f;
+  dt = dt > OSC_BLAMP_MINDT ? dt : OSC_BLAMP_MINDT;
+  peak = peak > dt ? peak : dt;
+  peak = peak < 1.0f - dt ? peak : 1.0f - dt;
+
+  if (peak != t->peak) {
+    t->peak = peak;
+    t->r = 1.0f / (peak * (1.0f - peak));
+    t->rise = (1.0f - peak) * t->r;
+    t->fall = peak * t->r;
+    t->peakph = osc_phase_from_cycles(peak);
+  }
+  t->rdt = (1.0f / 4294967296.0f) / dt;
+  t->corner = dt * t->r;
+}
+
+// the band-limited triangle at phase p. No branches in here: the wave is the
+// lower of the rising and the falling line, and the distances to the corners
+// come out of the fixed-point phase wrapped the short way round for free.
+static inline float osc_tri_blamp(const t_osc_tri *t, t_osc_phase p)
+{
+  float ph = osc_phase_unit(p);
+  float up = ph * t->rise;
+  float down = (1.0f - ph) * t->fall;
+  float y = up < down ? up : down;
+
+  float d0 = (float)(int32_t)p * t->rdt;
+  float dp = (float)(int32_t)(p - t->peakph) * t->rdt;
+
+  // the bottom corner bends up, the top one down
+  return y + t->corner * (osc_blamp(d0) - osc_blamp(dp));
+}
+
+#endif // OSC_BLEP_H
@@ -0,0 +1,21 @@
+// See connect.h
+
+#include "m_pd.h"
+#include "g_canvas.h"
+#include "connect.h"
+
+int osc_signal_connected(t_object *x, t_glist *glist, int inlet)
+{
+  t_linetraverser t;
+
+  if (!glist) return 1;
+
+  linetraverser_start(&t, glist);
+  while (linetraverser_next(&t)) {
+    if (t.tr_ob2 == x && t.tr_inno == inlet &&
+        obj_issignaloutlet(t.tr_ob, t.tr_outno)) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,21 @@
+// Which signal inlets actually have a signal connected.
+//
+// An unconnected signal inlet (or one fed only by floats) gets the same value
+// in every sample of the block, which lets the dsp methods pick perform
+// routines that read it once per block instead of once per sample. Pd doesn't
+// say which case it is, so this looks at the lines on the object's canvas, the
+// way cyclone's triangle~ and friends do. Pd calls the dsp method again
+// whenever a connection changes, so the answer stays current.
+
+#ifndef CONNECT_H
+#define CONNECT_H
+
+#include "m_pd.h"
+
+// `glist` is the canvas the object was created on (canvas_getcurrent() in the
+// new method); `inlet` counts all inlets, signal or not, from 0 at the left.
+// Returns 1 if some signal outlet is connected to that inlet, and also when it
+// can't tell (no canvas), so callers fall back to the general routine.
+int osc_signal_connected(t_object *x, t_glist *glist, int inlet);
+
+#endif
@@ -1,53 +1,39 @@
 #include "m_pd.h"
 #include <math.h>
+#include <stdio.h>
+#include "wavetable.h"
+#include "connect.h"
+#include "phase.h"
+#include "oversample.h"
+#include "stats.h"
 
 // NOTE: look at pure-data/src/d_osc.h to see how pure-data does this. It's
 // different than the implementation below
+//
+// [cubic_osc~ 440 4]: frequency and oversampling factor, 1, 2 (the default),
+// 4 or 8, also settable with `oversample <factor>`. See oversample.h for the
+// filter that brings it back down.
 
-// #define WAVETABLE_SIZE 16384
-#define WAVETABLE_SIZE 65536
+// #define WAVETABLE_BITS 14 // 16384
+#define WAVETABLE_BITS 16
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS) // 65536
 
 static t_class *cubic_osc_class = NULL;
-static t_float *cos_table = NULL; // shared wavetable
-static int table_reference_count = 0; // track how many instances exist
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
 
 typedef struct _cubic_osc {
   t_object x_obj;
-  double x_phase;
-  t_float x_conv;
+  t_osc_phase x_phase; // see phase.h
+  double x_conv;
   t_inlet *x_freq_inlet;
   t_outlet *x_outlet;
   t_float x_f;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  int x_oversample; // the factor asked for; x_os.factor is what we've got
+  t_osc_oversample x_os;
+  t_osc_stats x_stats; // see stats.h
 } t_cubic_osc;
 
-static void wavetable_init(void)
-{
-  if (cos_table == NULL) {
-    cos_table = (t_float *)getbytes(sizeof(t_float) * (WAVETABLE_SIZE + 1));
-    if (cos_table) {
-      for (int i = 0; i <= WAVETABLE_SIZE; i++) {
-        cos_table[i] = cosf((i * 2.0f * M_PI) / WAVETABLE_SIZE);
-      }
-      post("simple_osc~: initialized cosine table of size %d", WAVETABLE_SIZE);
-    } else {
-      post("simple_osc~ error: failed to allocate memory for cosine table");
-    }
-  }
-  table_reference_count++;
-}
-
-static void wavetable_free(void)
-{
-  table_reference_count--;
-  if (table_reference_count <= 0 && cos_table != NULL) {
-    freebytes(cos_table, sizeof(t_float) * (WAVETABLE_SIZE + 1));
-    cos_table = NULL;
-    post("simple_osc~: freed cosine table");
-    table_reference_count = 0; // just to be safe
-  }
-}
-
-
 static float cubicInterpolate(float y0, float y1, float y2, float y3, float mu) {
     float a0, a1, a2, a3, mu2;
     
@@ -60,73 +46,124 @@ static float cubicInterpolate(float y0, float y1, float y2, float y3, float mu)
     return a0 * mu * mu2 + a1 * mu2 + a2 * mu + a3;
 }
 
-static t_int *cubic_osc_perform(t_int *w)
+// freq_signal is always a constant, so the compiler builds a separate loop for
+// each of the two performs below
+static inline t_int *cubic_osc_perform_body(t_int *w, const int freq_signal)
 {
   t_cubic_osc *x = (t_cubic_osc *)(w[1]);
   t_float *in = (t_float *)(w[2]);
   t_float *out = (t_float *)(w[3]);
   int n = (int)(w[4]);
 
-  double dphase = x->x_phase;
+  t_osc_phase phase = x->x_phase;
   double conv = x->x_conv;
 
   if (!cos_table) return (w+5);
 
+  // `factor` samples per output sample, each a factor-th of the increment
+  // further on. When only floats reach the inlet, every sample of `in` is the
+  // same. At factor 1 there's nothing to decimate, so it goes straight out.
+  int factor = x->x_os.factor;
+  t_sample *buf = factor > 1 ? x->x_os.buf : out;
+  double os_conv = conv / factor;
+  t_osc_phase os_inc = osc_phase_wrap(in[0] * os_conv);
   while (n--) {
-    t_float freq = *in++;
-    // generate two samples per output sample (2x oversampling)
-
-    t_float sample = 0.0f;
-    for (int i = 0; i < 2; i++) {
-      int index = ((int)dphase) & (WAVETABLE_SIZE - 1);
-      t_float frac = dphase - index; // the fractional part after getting the
-      // index int
-      t_float y0 = cos_table[(index - 1) & (WAVETABLE_SIZE - 1)]; // in case
-      // index - 1 is out of range
+    if (freq_signal) os_inc = osc_phase_wrap(*in++ * os_conv);
+
+    for (int i = 0; i < factor; i++) {
+      // int, not unsigned: index - 1 has to be able to go to -1
+      int index = (int)osc_phase_index(phase, WAVETABLE_BITS);
+      t_float frac = osc_phase_frac(phase, WAVETABLE_BITS); // the bits below
+      // the index
+      // the table has guard points at -1, WAVETABLE_SIZE and
+      // WAVETABLE_SIZE + 1 (WAVETABLE_CUBIC), so none of these need masking
+      t_float y0 = cos_table[index - 1];
       t_float y1 = cos_table[index];
-      t_float y2 = cos_table[(index + 1) & (WAVETABLE_SIZE - 1)];
-      t_float y3 = cos_table[(index + 2) & (WAVETABLE_SIZE - 1)];
-
-      t_float oscillator_out = cubicInterpolate(y0, y1, y2, y3, frac);
+      t_float y2 = cos_table[index + 1];
+      t_float y3 = cos_table[index + 2];
 
-      // accumulate for averaging
-      sample += oscillator_out * 0.5f;
-
-      // advance phase at half the increment for oversampling
-      dphase += (freq * conv) * 0.5f;
-      while (dphase >= WAVETABLE_SIZE) dphase -= WAVETABLE_SIZE;
-      while (dphase < 0) dphase += WAVETABLE_SIZE;
+      *buf++ = cubicInterpolate(y0, y1, y2, y3, frac);
+      phase += os_inc;
     }
-
-    *out++ = sample;
   }
 
-  x->x_phase = dphase;
+  osc_oversample_decimate(&x->x_os, out);
+
+  x->x_phase = phase;
   return (w + 5);
 }
 
+static t_int *cubic_osc_perform(t_int *w)
+{
+  return cubic_osc_perform_body(w, 1);
+}
+
+static t_int *cubic_osc_perform_const(t_int *w)
+{
+  return cubic_osc_perform_body(w, 0);
+}
+
 static void cubic_osc_dsp(t_cubic_osc *x, t_signal **sp)
 {
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  char path[OSC_STATS_PATHSIZE];
+
   // calculate the conversion factor for this sample rate
-  x->x_conv = WAVETABLE_SIZE / sp[0]->s_sr;
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  if (!osc_oversample_set(&x->x_os, x->x_oversample, sp[0]->s_length)) {
+    pd_error(x, "cubic_osc~: out of memory, not oversampling");
+  }
 
-  dsp_add(cubic_osc_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+  // signal vectors are inlets first, then the outlet: sp[1] belongs to
+  // x_freq_inlet, which nothing reads (the left inlet is the frequency), so
+  // the output is sp[2]
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(freq_signal ? cubic_osc_perform : cubic_osc_perform_const, 4, x, sp[0]->s_vec, sp[2]->s_vec, sp[0]->s_length);
+  snprintf(path, sizeof(path), "%s, %dx oversampled",
+           freq_signal ? "signal frequency" : "constant frequency",
+           x->x_os.factor);
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length);
 }
 
-static void *cubic_osc_new(t_floatarg f)
+static void cubic_osc_oversample(t_cubic_osc *x, t_floatarg f)
+{
+  int factor = osc_oversample_factor(f);
+  if (!factor) {
+    pd_error(x, "cubic_osc~: oversample %g: can be 1, 2, 4 or 8", f);
+    return;
+  }
+  x->x_oversample = factor;
+  // the dsp method sets it up if DSP hasn't run yet
+  if (x->x_os.n && !osc_oversample_set(&x->x_os, factor, x->x_os.n)) {
+    pd_error(x, "cubic_osc~: out of memory, not oversampling");
+  }
+}
+
+// only the decimation filters have SIMD versions
+static void cubic_osc_kernel(t_cubic_osc *x, t_symbol *s)
+{
+  osc_kernels_select(x, "cubic_osc~", &x->x_os.kernels, s);
+}
+
+static void *cubic_osc_new(t_floatarg f, t_floatarg os)
 {
   t_cubic_osc *x = (t_cubic_osc *)pd_new(cubic_osc_class);
 
   // initialize phase and frequency
   x->x_phase = 0;
   x->x_f = f > 0 ? f : 440;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_oversample = 2;
+  osc_oversample_init(&x->x_os);
+  if (os != 0) cubic_osc_oversample(x, os);
 
   x->x_freq_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   pd_float((t_pd *)x->x_freq_inlet, x->x_f); // sets inlet initial value from
   // arg
   x->x_outlet = outlet_new(&x->x_obj, &s_signal);
 
-  wavetable_init();
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_CUBIC);
 
   return (void *)x;
 }
@@ -135,9 +172,15 @@ static void cubic_osc_free(t_cubic_osc *x)
 {
   inlet_free(x->x_freq_inlet);
   outlet_free(x->x_outlet);
+  osc_oversample_free(&x->x_os);
 
   // decrease reference count and possibly free wavetable
-  wavetable_free();
+  wavetable_release(cos_table);
+}
+
+static void cubic_osc_stats(t_cubic_osc *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "cubic_osc~", argc, argv);
 }
 
 void cubic_osc_tilde_setup(void)
@@ -147,8 +190,14 @@ void cubic_osc_tilde_setup(void)
                                (t_method)cubic_osc_free,
                                sizeof(t_cubic_osc),
                                CLASS_DEFAULT,
-                               A_DEFFLOAT, 0);
+                               A_DEFFLOAT, A_DEFFLOAT, 0);
 
   class_addmethod(cubic_osc_class, (t_method)cubic_osc_dsp, gensym("dsp"), A_CANT, 0);
   CLASS_MAINSIGNALIN(cubic_osc_class, t_cubic_osc, x_f);
+  class_addmethod(cubic_osc_class, (t_method)cubic_osc_oversample,
+                  gensym("oversample"), A_FLOAT, 0);
+  class_addmethod(cubic_osc_class, (t_method)cubic_osc_kernel, gensym("kernel"),
+                  A_DEFSYM, 0);
+  class_addmethod(cubic_osc_class, (t_method)cubic_osc_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
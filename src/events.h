@@ -0,0 +1,150 @@
+// Control messages that land on a sample (tri_phase~ and simple_phasor~).
+//
+// Pd runs messages between DSP ticks, so a method that just stores a value
+// makes it take effect at the start of the next block, up to a block late:
+// sample-accurate phase resets used to need [block~ 1]. Instead the method
+// queues the message with the sample of the coming block its logical time
+// falls on, and the perform routine splits its block there. By the time
+// messages run Pd's clock has already moved past the block the perform
+// routine last computed (the same reasoning as in Pd's vline~), so that
+// sample is just the time since the last perform call, in samples.
+//
+// A message a block or more after the last perform call can't be for the
+// coming block: DSP is off, or the block is shorter than Pd's 64 and the
+// perform routine runs several times per tick. The queue is applied straight
+// away then, in order, and so is the message. A message that doesn't fit in
+// the queue pushes the oldest one out early, to the start of the block.
+//
+// Include after m_pd.h.
+
+#ifndef OSC_EVENTS_H
+#define OSC_EVENTS_H
+
+#include <limits.h>
+
+#define OSC_EVENTS_SIZE 16 // a power of 2; more per block than that is odd
+
+typedef struct _osc_event {
+  int sample; // in the coming block
+  int type; // which message, the class's own numbering
+  t_float value;
+} t_osc_event;
+
+typedef struct _osc_events {
+  t_osc_event ev[OSC_EVENTS_SIZE];
+  unsigned int head, tail; // read and write counts, wrapping
+  double lasttime; // Pd's logical time at the last perform call
+  double samplesperms; // 0 until the dsp method runs
+  int n; // block size
+} t_osc_events;
+
+static inline void osc_events_init(t_osc_events *e)
+{
+  e->head = e->tail = 0;
+  e->lasttime = 0;
+  e->samplesperms = 0;
+  e->n = 0;
+}
+
+// from the dsp method, after osc_events_flush()
+static inline void osc_events_dsp(t_osc_events *e, t_float sr, int n)
+{
+  e->samplesperms = sr * 0.001;
+  e->n = n;
+}
+
+// the sample a message sent now belongs on, or -1 if it's not for the
+// coming block: the one its time falls in, rounded down like [block~ 1] would
+// have it (rounding to the nearest would send the last half sample off the
+// end of the block)
+static inline int osc_events_when(const t_osc_events *e)
+{
+  double s = clock_gettimesince(e->lasttime) * e->samplesperms;
+  return s >= 0 && s < e->n ? (int)s : -1;
+}
+
+static inline int osc_events_full(const t_osc_events *e)
+{
+  return e->tail - e->head == OSC_EVENTS_SIZE;
+}
+
+static inline void osc_events_push(t_osc_events *e, int sample, int type,
+  t_float value)
+{
+  t_osc_event *ev = &e->ev[e->tail++ & (OSC_EVENTS_SIZE - 1)];
+  ev->sample = sample;
+  ev->type = type;
+  ev->value = value;
+}
+
+// take the next event due at or before `sample` into *ev; 0 if there's none
+static inline int osc_events_pop(t_osc_events *e, int sample, t_osc_event *ev)
+{
+  if (e->head == e->tail || e->ev[e->head & (OSC_EVENTS_SIZE - 1)].sample
+      > sample)
+    return 0;
+  *ev = e->ev[e->head++ & (OSC_EVENTS_SIZE - 1)];
+  return 1;
+}
+
+// where the block has to be split next: the next event's sample, or n
+static inline int osc_events_next(const t_osc_events *e, int n)
+{
+  int s;
+  if (e->head == e->tail) return n;
+  s = e->ev[e->head & (OSC_EVENTS_SIZE - 1)].sample;
+  return s < n ? s : n;
+}
+
+// applies a message for its class, `type` being the class's own numbering
+typedef void (*t_osc_eventfn)(void *owner, int type, t_float value);
+
+// apply everything that's queued, in order
+static inline void osc_events_flush(t_osc_events *e, void *owner,
+  t_osc_eventfn apply)
+{
+  t_osc_event ev;
+  while (osc_events_pop(e, INT_MAX, &ev)) apply(owner, ev.type, ev.value);
+}
+
+// what a method does with its message: queue it for its sample, or if it's
+// not for the coming block apply it now
+static inline void osc_events_add(t_osc_events *e, void *owner,
+  t_osc_eventfn apply, int type, t_float value)
+{
+  int when = osc_events_when(e);
+  t_osc_event ev;
+
+  if (when < 0) {
+    osc_events_flush(e, owner, apply);
+    apply(owner, type, value);
+    return;
+  }
+  if (osc_events_full(e) && osc_events_pop(e, INT_MAX, &ev))
+    apply(owner, ev.type, ev.value);
+  osc_events_push(e, when, type, value);
+}
+
+// In the perform routine, at sample i of a block of n: apply what's due by
+// then and return where the block has to be split next, so
+//
+//   for (int i = 0, end; i < n; i = end) {
+//     end = osc_events_run(&x->x_events, i, n, x, apply);
+//     ... samples i to end ...
+//   }
+//   osc_events_done(&x->x_events);
+static inline int osc_events_run(t_osc_events *e, int i, int n, void *owner,
+  t_osc_eventfn apply)
+{
+  t_osc_event ev;
+  while (osc_events_pop(e, i, &ev)) apply(owner, ev.type, ev.value);
+  return osc_events_next(e, n);
+}
+
+// at the end of every perform call
+static inline void osc_events_done(t_osc_events *e)
+{
+  e->lasttime = clock_getlogicaltime();
+}
+
+#endif // OSC_EVENTS_H
@@ -0,0 +1,93 @@
+// See fft.h
+
+#include "m_pd.h"
+#include "fft.h"
+#include <math.h>
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+void osc_fft_free(t_osc_fft *f)
+{
+  int m = f->n / 2;
+  if (f->rev) freebytes(f->rev, m * sizeof(int));
+  if (f->tw) freebytes(f->tw, (m / 2) * 2 * sizeof(float));
+  if (f->pack) freebytes(f->pack, m * 2 * sizeof(float));
+  if (f->buf) freebytes(f->buf, m * 2 * sizeof(float));
+  f->rev = NULL;
+  f->tw = f->pack = f->buf = NULL;
+}
+
+int osc_fft_init(t_osc_fft *f, int n)
+{
+  int m = n / 2, bits = 0;
+
+  f->n = n;
+  f->rev = (int *)getbytes(m * sizeof(int));
+  f->tw = (float *)getbytes((m / 2) * 2 * sizeof(float));
+  f->pack = (float *)getbytes(m * 2 * sizeof(float));
+  f->buf = (float *)getbytes(m * 2 * sizeof(float));
+  if (!f->rev || !f->tw || !f->pack || !f->buf) {
+    osc_fft_free(f);
+    return 0;
+  }
+
+  while ((1 << bits) < m) bits++;
+  for (int i = 0; i < m; i++) {
+    int r = 0;
+    for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+    f->rev[i] = r;
+  }
+  for (int k = 0; k < m / 2; k++) {
+    f->tw[2 * k] = (float)cos(2 * M_PI * k / m);
+    f->tw[2 * k + 1] = (float)sin(2 * M_PI * k / m);
+  }
+  for (int k = 0; k < m; k++) {
+    f->pack[2 * k] = (float)cos(2 * M_PI * k / n);
+    f->pack[2 * k + 1] = (float)sin(2 * M_PI * k / n);
+  }
+  return 1;
+}
+
+void osc_fft_realinverse(t_osc_fft *f, const float *re, const float *im,
+  float *out)
+{
+  int m = f->n / 2;
+  float *z = f->buf;
+
+  // With E[k] = X[k] + X[k + m] and O[k] = (X[k] - X[k + m]) e^(2 pi i k / n),
+  // the m point transform of E + i O is out[2t] + i out[2t + 1]. X[k + m] is
+  // the conjugate of X[m - k], from the bins given.
+  for (int k = 0; k < m; k++) {
+    float ar = re[k], ai = k ? im[k] : 0.0f;
+    float br = re[m - k], bi = k ? -im[m - k] : 0.0f;
+    float er = ar + br, ei = ai + bi;
+    float dr = ar - br, di = ai - bi;
+    float pr = f->pack[2 * k], pi = f->pack[2 * k + 1];
+    float or_ = dr * pr - di * pi, oi = dr * pi + di * pr;
+    int j = f->rev[k];
+    z[2 * j] = er - oi;
+    z[2 * j + 1] = ei + or_;
+  }
+
+  for (int len = 2; len <= m; len <<= 1) {
+    int half = len / 2, step = m / len;
+    for (int i = 0; i < m; i += len) {
+      for (int k = 0; k < half; k++) {
+        float wr = f->tw[2 * k * step], wi = f->tw[2 * k * step + 1];
+        float *a = z + 2 * (i + k), *b = z + 2 * (i + k + half);
+        float tr = b[0] * wr - b[1] * wi, ti = b[0] * wi + b[1] * wr;
+        b[0] = a[0] - tr;
+        b[1] = a[1] - ti;
+        a[0] += tr;
+        a[1] += ti;
+      }
+    }
+  }
+
+  for (int t = 0; t < m; t++) {
+    out[2 * t] = z[2 * t];
+    out[2 * t + 1] = z[2 * t + 1];
+  }
+}
@@ -0,0 +1,32 @@
+// A real inverse FFT, for additive~'s IFFT mode.
+//
+// Radix 2, iterative, with the twiddles worked out once in double precision
+// when it's set up: a complex FFT of half the size does the work, on the
+// even and odd samples packed into one complex sequence. Small and
+// unremarkable, it's here so the library doesn't need Pd's mayer_*()
+// (whose ordering of the spectrum depends on how Pd was built) or anything
+// else to link to.
+
+#ifndef OSC_FFT_H
+#define OSC_FFT_H
+
+typedef struct _osc_fft {
+  int n; // real samples, a power of 2, at least 4
+  int *rev; // bit reversal for the n / 2 point complex FFT
+  float *tw; // e^(2 pi i k / (n / 2)) for k < n / 4, re and im interleaved
+  float *pack; // e^(2 pi i k / n) for k < n / 2, interleaved
+  float *buf; // n / 2 complex, interleaved
+} t_osc_fft;
+
+// 0 if out of memory (and then there's nothing to free)
+int osc_fft_init(t_osc_fft *f, int n);
+void osc_fft_free(t_osc_fft *f);
+
+// The n samples whose spectrum has re[k] + i im[k] in bin k, k = 0 ... n / 2,
+// and the complex conjugates in the bins above n / 2: out[t] is the sum over
+// all n bins of X[k] e^(2 pi i k t / n), not divided by n. im[0] and
+// im[n / 2] are taken as 0.
+void osc_fft_realinverse(t_osc_fft *f, const float *re, const float *im,
+  float *out);
+
+#endif // OSC_FFT_H
@@ -0,0 +1,403 @@
+// A set of modern_osc~ style oscillators ("operators") phase modulating each
+// other, DX7 style, in one object. The patch way is a [phasor~] -> [+~] ->
+// [cos~] -> [*~] chain per operator, where every connection is a block
+// written out by one perform routine and read back in by the next. Here one
+// perform routine takes each sample through all the operators in turn, with
+// nothing in between but local variables.
+//
+// [fm_op~ 6 220] has 6 operators (default 4, up to 8) and starts at 220 Hz.
+// The left inlet is the frequency, the outlet the operators' mix. Operators
+// are counted from 1. Messages:
+//
+//   ratio <op> <ratio>: the operator's frequency as a multiple of the inlet's
+//     (default 1)
+//   detune <op> <hz>: added to that; `ratio 3 0` and `detune 3 5` fix
+//     operator 3 at 5 Hz
+//   mod <to> <from> <amount>: <from>'s output times <amount> is added to
+//     <to>'s phase, in cycles like a [+~] before [cos~] (an index of I
+//     radians is I / 2pi). <from> the same as <to> is self feedback.
+//   out <op> <level>: how much of the operator goes to the outlet (default 1
+//     for operator 1, 0 for the rest)
+//   clear: every mod and out amount to 0
+//   reset: every operator back to phase 0, so notes start the same way
+//
+// The operators run from the highest number down, so with the DX7's
+// numbering (modulators above their carriers, `mod 1 2 1` for 2 into 1) each
+// modulator gets there in the same sample. Anything from an operator at or
+// below the one it modulates is feedback and comes from the sample before,
+// averaged over the last two like the DX7 does, which keeps strong feedback
+// from breaking up into noise. Changes to mod and out are ramped over a
+// block.
+//
+// With a multichannel frequency there's a voice per channel, all with the
+// same settings.
+
+#include "m_pd.h"
+#include <stdio.h>
+#include <string.h>
+#include "wavetable.h"
+#include "connect.h"
+#include "phase.h"
+#include "stats.h"
+#include "multichannel.h"
+
+// GCC packs the operators' table reads into vectors, which makes every
+// operator in a vector wait for the slowest one's input; with feedback that's
+// the whole chain every sample, twice as slow as without
+#if defined(__GNUC__) && !defined(__clang__)
+# pragma GCC optimize("no-tree-slp-vectorize")
+#endif
+
+// same table as modern_osc~, so the two share it
+#define WAVETABLE_BITS 12
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+
+#define FM_OP_DEFOPS 4
+#define FM_OP_MAXOPS 8
+
+// for the perform routines' bodies, see fm_op_voice()
+#ifdef __GNUC__
+# define FM_OP_INLINE static inline __attribute__((always_inline))
+#else
+# define FM_OP_INLINE static inline
+#endif
+
+static t_class *fm_op_class = NULL;
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
+
+// per channel
+typedef struct _fm_op_voice {
+  t_osc_phase phase[FM_OP_MAXOPS];
+  float y1[FM_OP_MAXOPS]; // each operator's output at the last sample
+  float y2[FM_OP_MAXOPS]; // and the one before
+} t_fm_op_voice;
+
+typedef struct _fm_op {
+  t_object x_obj;
+  int x_nops;
+  double x_conv; // phase increment per Hz, see phase.h
+  double x_ratio[FM_OP_MAXOPS];
+  double x_detune[FM_OP_MAXOPS];
+  float x_mod[FM_OP_MAXOPS][FM_OP_MAXOPS]; // [to][from], as set
+  float x_modnow[FM_OP_MAXOPS][FM_OP_MAXOPS]; // where the ramp is
+  float x_out[FM_OP_MAXOPS];
+  float x_outnow[FM_OP_MAXOPS];
+  int x_ramp; // mod or out changed since the last block
+  t_fm_op_voice *x_voices; // one per channel
+  int x_nvoices; // room in x_voices
+  t_float x_f;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  t_outlet *x_outlet;
+  t_osc_stats x_stats; // see stats.h
+} t_fm_op;
+
+// One voice over n samples, with nops operators, a frequency signal or not,
+// and ramping mod and out or not, all constants: with nops known the loops
+// over the operators unroll (the pragmas make sure, 8 is FM_OP_MAXOPS), the
+// j > k tests go away at compile time and each operator's state stays in
+// registers. Everything the sample loop touches is a local, so the compiler
+// doesn't have to reload it after every store to `out`. For any of that the
+// constants have to reach it, i.e. it has to be inlined into each
+// fm_op_perform_N_F, which GCC won't do for a function this size unless it's
+// made to.
+FM_OP_INLINE void fm_op_voice(t_fm_op *x, t_fm_op_voice *v,
+  const t_sample *in, t_sample *out, int n, const int nops,
+  const int freq_signal, const int ramp)
+{
+  const float *tab = cos_table;
+  float mod[FM_OP_MAXOPS][FM_OP_MAXOPS], dmod[FM_OP_MAXOPS][FM_OP_MAXOPS];
+  float lvl[FM_OP_MAXOPS], dlvl[FM_OP_MAXOPS];
+  double rconv[FM_OP_MAXOPS];
+  t_osc_phase inc[FM_OP_MAXOPS], dinc[FM_OP_MAXOPS];
+  t_osc_phase phase[FM_OP_MAXOPS];
+  float y1[FM_OP_MAXOPS], y2[FM_OP_MAXOPS];
+  unsigned int from[FM_OP_MAXOPS]; // bit j set if j modulates k
+  float rn = 1.0f / n;
+
+  for (int k = 0; k < nops; k++) {
+    rconv[k] = x->x_ratio[k] * x->x_conv;
+    dinc[k] = osc_phase_wrap(x->x_detune[k] * x->x_conv);
+    inc[k] = osc_phase_wrap(in[0] * rconv[k]) + dinc[k];
+    phase[k] = v->phase[k];
+    y1[k] = v->y1[k];
+    y2[k] = v->y2[k];
+    lvl[k] = x->x_outnow[k];
+    dlvl[k] = ramp ? (x->x_out[k] - lvl[k]) * rn : 0;
+    from[k] = 0;
+    for (int j = 0; j < nops; j++) {
+      // in phase units, and halved for feedback, which is the sum of two
+      // samples; both are powers of 2, so it's exact
+      float scale = j > k ? (float)OSC_PHASE_CYCLE : (float)OSC_PHASE_CYCLE / 2;
+      mod[k][j] = x->x_modnow[k][j] * scale;
+      dmod[k][j] = ramp ? (x->x_mod[k][j] * scale - mod[k][j]) * rn : 0;
+      if (mod[k][j] != 0 || dmod[k][j] != 0) from[k] |= 1u << j;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    float y[FM_OP_MAXOPS];
+    float sum = 0;
+
+    if (freq_signal) {
+      double f = in[i];
+#pragma GCC unroll 8
+      for (int k = 0; k < nops; k++)
+        inc[k] = osc_phase_wrap(f * rconv[k]) + dinc[k];
+    }
+
+#pragma GCC unroll 8
+    for (int k = nops - 1; k >= 0; k--) {
+      t_osc_phase p = phase[k];
+      // Only the modulators that are there: multiplying by 0 would still
+      // make every operator wait for all the others' table reads, and the
+      // branches go the same way all block, so they cost next to nothing.
+      // With feedback each sample waits for the last one anyway, so that
+      // path is kept short: mod is already in phase units and the sum goes
+      // straight from float to phase.
+      if (from[k]) {
+        float pm = 0;
+#pragma GCC unroll 8
+        for (int j = 0; j < nops; j++) {
+          if (!(from[k] & (1u << j))) continue;
+          pm += mod[k][j] * (j > k ? y[j] : y1[j] + y2[j]);
+        }
+        p += osc_phase_wrapf(pm);
+      }
+      uint32_t idx = osc_phase_index(p, WAVETABLE_BITS);
+      float frac = osc_phase_frac(p, WAVETABLE_BITS);
+      y[k] = tab[idx] + frac * (tab[idx + 1] - tab[idx]);
+      phase[k] += inc[k];
+      sum += lvl[k] * y[k];
+      // the operators still to come this sample only read y1 and y2 up to
+      // k - 1, so k's can move on now
+      y2[k] = y1[k];
+      y1[k] = y[k];
+    }
+    out[i] = sum;
+
+    if (ramp) {
+#pragma GCC unroll 8
+      for (int k = 0; k < nops; k++) {
+        lvl[k] += dlvl[k];
+#pragma GCC unroll 8
+        for (int j = 0; j < nops; j++) mod[k][j] += dmod[k][j];
+      }
+    }
+  }
+
+  for (int k = 0; k < nops; k++) {
+    v->phase[k] = phase[k];
+    v->y1[k] = y1[k];
+    v->y2[k] = y2[k];
+  }
+}
+
+// each channel (see multichannel.h) is n samples of `in` and `out`, the next
+// one right after it
+FM_OP_INLINE t_int *fm_op_perform_body(t_int *w, const int nops,
+  const int freq_signal)
+{
+  t_fm_op *x = (t_fm_op *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+
+  if (!cos_table) {
+    for (int i = 0; i < n * nchans; i++) out[i] = 0;
+    return (w + 6);
+  }
+
+  if (x->x_ramp) {
+    for (int c = 0; c < nchans; c++)
+      fm_op_voice(x, &x->x_voices[c], in + c * n, out + c * n, n, nops,
+                  freq_signal, 1);
+    // land exactly on the targets rather than wherever the ramp rounded to
+    memcpy(x->x_modnow, x->x_mod, sizeof(x->x_mod));
+    memcpy(x->x_outnow, x->x_out, sizeof(x->x_out));
+    x->x_ramp = 0;
+  } else {
+    for (int c = 0; c < nchans; c++)
+      fm_op_voice(x, &x->x_voices[c], in + c * n, out + c * n, n, nops,
+                  freq_signal, 0);
+  }
+  return (w + 6);
+}
+
+// fm_op_perform_N_F for N operators, with F 1 if the frequency inlet has a
+// signal connected
+#define FM_OP_PERFORM(ops, f) \
+  static t_int *fm_op_perform_##ops##_##f(t_int *w) \
+  { \
+    return fm_op_perform_body(w, ops, f); \
+  }
+
+#define FM_OP_PERFORMS(ops) \
+  FM_OP_PERFORM(ops, 0) \
+  FM_OP_PERFORM(ops, 1)
+
+FM_OP_PERFORMS(1)
+FM_OP_PERFORMS(2)
+FM_OP_PERFORMS(3)
+FM_OP_PERFORMS(4)
+FM_OP_PERFORMS(5)
+FM_OP_PERFORMS(6)
+FM_OP_PERFORMS(7)
+FM_OP_PERFORMS(8)
+
+static const t_perfroutine fm_op_performs[FM_OP_MAXOPS][2] = {
+  {fm_op_perform_1_0, fm_op_perform_1_1},
+  {fm_op_perform_2_0, fm_op_perform_2_1},
+  {fm_op_perform_3_0, fm_op_perform_3_1},
+  {fm_op_perform_4_0, fm_op_perform_4_1},
+  {fm_op_perform_5_0, fm_op_perform_5_1},
+  {fm_op_perform_6_0, fm_op_perform_6_1},
+  {fm_op_perform_7_0, fm_op_perform_7_1},
+  {fm_op_perform_8_0, fm_op_perform_8_1},
+};
+
+static void fm_op_dsp(t_fm_op *x, t_signal **sp)
+{
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  void *state = x->x_voices;
+  char path[OSC_STATS_PATHSIZE];
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  // the output gets as many channels as the frequency
+  int nchans = osc_mc_state(&state, &x->x_nvoices, osc_mc_nchans(sp[0]),
+                            sizeof(t_fm_op_voice));
+  x->x_voices = (t_fm_op_voice *)state;
+
+  // sp[0] is the frequency, sp[1] the outlet
+  osc_mc_setout(&sp[1], nchans);
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(fm_op_performs[x->x_nops - 1][freq_signal], 5, x, sp[0]->s_vec,
+          sp[1]->s_vec, sp[0]->s_length, nchans);
+  snprintf(path, sizeof(path), "%d operators%s", x->x_nops,
+           freq_signal ? "" : ", constant frequency");
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length * nchans);
+}
+
+// operator number f (from 1) as an index, or -1
+static int fm_op_index(t_fm_op *x, t_floatarg f)
+{
+  int k = (int)f - 1;
+  if (k < 0 || k >= x->x_nops) {
+    pd_error(x, "fm_op~: no operator %d (1 to %d)", (int)f, x->x_nops);
+    return -1;
+  }
+  return k;
+}
+
+static void fm_op_ratio(t_fm_op *x, t_floatarg op, t_floatarg r)
+{
+  int k = fm_op_index(x, op);
+  if (k < 0) return;
+  x->x_ratio[k] = r;
+}
+
+static void fm_op_detune(t_fm_op *x, t_floatarg op, t_floatarg hz)
+{
+  int k = fm_op_index(x, op);
+  if (k < 0) return;
+  x->x_detune[k] = hz;
+}
+
+static void fm_op_mod(t_fm_op *x, t_floatarg to, t_floatarg from,
+  t_floatarg amount)
+{
+  int k = fm_op_index(x, to), j = fm_op_index(x, from);
+  if (k < 0 || j < 0) return;
+  x->x_mod[k][j] = amount;
+  x->x_ramp = 1;
+}
+
+static void fm_op_out(t_fm_op *x, t_floatarg op, t_floatarg level)
+{
+  int k = fm_op_index(x, op);
+  if (k < 0) return;
+  x->x_out[k] = level;
+  x->x_ramp = 1;
+}
+
+static void fm_op_clear(t_fm_op *x)
+{
+  memset(x->x_mod, 0, sizeof(x->x_mod));
+  memset(x->x_out, 0, sizeof(x->x_out));
+  x->x_ramp = 1;
+}
+
+static void fm_op_reset(t_fm_op *x)
+{
+  if (x->x_voices) memset(x->x_voices, 0, x->x_nvoices * sizeof(t_fm_op_voice));
+}
+
+static void *fm_op_new(t_floatarg ops, t_floatarg f)
+{
+  t_fm_op *x = (t_fm_op *)pd_new(fm_op_class);
+  int nops = ops >= 1 ? (int)ops : FM_OP_DEFOPS;
+  void *state = NULL;
+
+  x->x_nops = nops > FM_OP_MAXOPS ? FM_OP_MAXOPS : nops;
+  x->x_conv = 0;
+  for (int k = 0; k < FM_OP_MAXOPS; k++) {
+    x->x_ratio[k] = 1;
+    x->x_detune[k] = 0;
+  }
+  memset(x->x_mod, 0, sizeof(x->x_mod));
+  memset(x->x_modnow, 0, sizeof(x->x_modnow));
+  memset(x->x_out, 0, sizeof(x->x_out));
+  x->x_out[0] = 1;
+  memcpy(x->x_outnow, x->x_out, sizeof(x->x_out));
+  x->x_ramp = 0;
+  x->x_nvoices = 0;
+  osc_mc_state(&state, &x->x_nvoices, 1, sizeof(t_fm_op_voice));
+  x->x_voices = (t_fm_op_voice *)state;
+  x->x_f = f > 0 ? (t_float)f : (t_float)220.0;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+
+  x->x_outlet = outlet_new(&x->x_obj, &s_signal);
+
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_LINEAR);
+
+  return (void *)x;
+}
+
+static void fm_op_free(t_fm_op *x)
+{
+  outlet_free(x->x_outlet);
+  osc_mc_freestate(x->x_voices, x->x_nvoices, sizeof(t_fm_op_voice));
+
+  wavetable_release(cos_table);
+}
+
+static void fm_op_stats(t_fm_op *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "fm_op~", argc, argv);
+}
+
+void fm_op_tilde_setup(void)
+{
+  fm_op_class = class_new(gensym("fm_op~"),
+                          (t_newmethod)fm_op_new,
+                          (t_method)fm_op_free,
+                          sizeof(t_fm_op),
+                          CLASS_DEFAULT | OSC_MC_CLASS,
+                          A_DEFFLOAT, A_DEFFLOAT, 0);
+
+  class_addmethod(fm_op_class, (t_method)fm_op_dsp, gensym("dsp"), A_CANT, 0);
+  CLASS_MAINSIGNALIN(fm_op_class, t_fm_op, x_f);
+  class_addmethod(fm_op_class, (t_method)fm_op_ratio, gensym("ratio"),
+                  A_FLOAT, A_FLOAT, 0);
+  class_addmethod(fm_op_class, (t_method)fm_op_detune, gensym("detune"),
+                  A_FLOAT, A_FLOAT, 0);
+  class_addmethod(fm_op_class, (t_method)fm_op_mod, gensym("mod"),
+                  A_FLOAT, A_FLOAT, A_FLOAT, 0);
+  class_addmethod(fm_op_class, (t_method)fm_op_out, gensym("out"),
+                  A_FLOAT, A_FLOAT, 0);
+  class_addmethod(fm_op_class, (t_method)fm_op_clear, gensym("clear"), 0);
+  class_addmethod(fm_op_class, (t_method)fm_op_reset, gensym("reset"), 0);
+  class_addmethod(fm_op_class, (t_method)fm_op_stats, gensym("stats"),
+                  A_GIMME, 0);
+}
@@ -0,0 +1,81 @@
+// See kernels.h
+
+#include "m_pd.h"
+#include "kernels.h"
+#include <string.h>
+
+const t_osc_kernels osc_kernels_scalar = {
+  "scalar", 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  NULL
+};
+
+// widest first
+static const t_osc_kernels *const osc_kernels_all[] = {
+#ifdef OSC_KERNELS_AVX512
+  &osc_kernels_avx512,
+#endif
+#ifdef OSC_KERNELS_AVX2
+  &osc_kernels_avx2,
+#endif
+#ifdef OSC_KERNELS_SSE2
+  &osc_kernels_sse2,
+#endif
+  &osc_kernels_scalar
+};
+
+#define OSC_KERNELS_COUNT \
+  (int)(sizeof(osc_kernels_all) / sizeof(osc_kernels_all[0]))
+
+// whether this CPU (and OS, for the wider registers) can run k
+static int osc_kernels_supported(const t_osc_kernels *k)
+{
+#if defined(OSC_KERNELS_AVX2) || defined(OSC_KERNELS_AVX512)
+  static int init = 0;
+  if (!init) {
+    __builtin_cpu_init();
+    init = 1;
+  }
+#endif
+#ifdef OSC_KERNELS_AVX512
+  if (k == &osc_kernels_avx512) return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef OSC_KERNELS_AVX2
+  if (k == &osc_kernels_avx2)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+  return 1; // SSE2 is part of x86_64, and scalar runs anywhere
+}
+
+const t_osc_kernels *osc_kernels_best(void)
+{
+  static const t_osc_kernels *best = NULL;
+  if (!best) {
+    for (int i = 0; i < OSC_KERNELS_COUNT && !best; i++) {
+      if (osc_kernels_supported(osc_kernels_all[i])) best = osc_kernels_all[i];
+    }
+  }
+  return best;
+}
+
+int osc_kernels_select(void *x, const char *classname,
+  const t_osc_kernels **k, t_symbol *s)
+{
+  if (!*s->s_name) {
+    post("%s: kernel %s", classname, (*k)->name);
+    return 0;
+  }
+  for (int i = 0; i < OSC_KERNELS_COUNT; i++) {
+    const t_osc_kernels *c = osc_kernels_all[i];
+    if (strcmp(s->s_name, c->name)) continue;
+    if (!osc_kernels_supported(c)) {
+      pd_error(x, "%s: this CPU can't run kernel %s", classname, c->name);
+      return 0;
+    }
+    if (c == *k) return 0;
+    *k = c;
+    return 1;
+  }
+  pd_error(x, "%s: no kernel '%s' (scalar, sse2, avx2, avx512)", classname,
+           s->s_name);
+  return 0;
+}
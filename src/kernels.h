@@ -0,0 +1,89 @@
+// The SIMD kernels of osc_simd.h, picked at run time.
+//
+// osc_simd.h is built once per instruction set (kernels_sse2.c,
+// kernels_avx2.c, kernels_avx512.c), each file telling the compiler to target
+// its set whatever the rest of the library is built for, and
+// osc_kernels_best() asks the CPU which of them it can run. So one binary
+// uses AVX-512 where there is some and still loads on a machine that only has
+// SSE2, without anyone having to remember `make cflags=-mavx2`.
+//
+// Classes keep a `const t_osc_kernels *` per instance, set from
+// osc_kernels_best() in their new method, and call through it. The `kernel`
+// message (osc_kernels_select()) shows which one an instance uses or forces
+// another, for comparing them. The "scalar" set has width 0 and no functions:
+// the classes run their own plain C loops then.
+//
+// The functions are the ones of the same names in osc_simd.h. Define
+// OSC_NO_SIMD to build the scalar set only. Include after m_pd.h.
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "phase.h"
+
+// double precision Pd builds (t_sample == double) only get the scalar set
+#if defined(PD_FLOATSIZE) && PD_FLOATSIZE == 64
+# define OSC_NO_SIMD
+#endif
+
+#if !defined(OSC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+# define OSC_KERNELS_SSE2
+// the others need the compiler to target them per file, and the CPU check
+# if defined(__GNUC__)
+#  define OSC_KERNELS_AVX2
+#  define OSC_KERNELS_AVX512
+# endif
+#endif
+
+// the widest group of lanes any set uses (osc_bank~ pads to this)
+#define OSC_KERNELS_MAXWIDTH 16
+
+typedef struct _osc_kernels {
+  const char *name;
+  int width; // lanes per vector, 0 for the scalar set
+  t_osc_phase (*lerp)(const float *tab, int bits, t_osc_phase phase,
+    const t_sample *in, double conv, t_sample *out, int n);
+  t_osc_phase (*lerp_const)(const float *tab, int bits, t_osc_phase phase,
+    t_osc_phase inc, t_sample *out, int n);
+  t_osc_phase (*xfade)(const float *a, const float *b, int bits,
+    t_osc_phase phase, const t_sample *in, double conv, t_osc_phase inc,
+    float w, float dw, t_sample *out, int n);
+  t_osc_phase (*phasor)(t_osc_phase phase, const t_sample *in, double conv,
+    t_sample *out, int n);
+  void (*bank_group)(const float *tab, int bits, t_osc_phase *phase,
+    const t_osc_phase *inc, float *amp, const float *damp, float *acc, int n);
+  void (*bank_sum)(const float *acc, t_sample *out, int n);
+  void (*halfband)(const t_sample *even, const t_sample *odd,
+    const float *taps, int k, t_sample *out, int n);
+  void (*tri)(const t_sample *in, const t_sample *peak, float pk, float low,
+    float range, t_sample *out, int n);
+  t_osc_phase (*tri_phasor)(t_osc_phase phase, const t_sample *in,
+    double conv, t_osc_phase inc, const t_sample *peak, float pk, float low,
+    float range, t_sample *out, int n);
+  t_osc_phase (*poly)(t_osc_phase phase, const t_sample *in, double conv,
+    t_osc_phase inc, const float *c, int nc, t_sample *out, int n);
+  void (*rotor)(float *c, float *s, float tc, float ts, t_sample *out, int n);
+} t_osc_kernels;
+
+extern const t_osc_kernels osc_kernels_scalar;
+#ifdef OSC_KERNELS_SSE2
+extern const t_osc_kernels osc_kernels_sse2;
+#endif
+#ifdef OSC_KERNELS_AVX2
+extern const t_osc_kernels osc_kernels_avx2; // with FMA
+#endif
+#ifdef OSC_KERNELS_AVX512
+extern const t_osc_kernels osc_kernels_avx512; // AVX-512F
+#endif
+
+// the widest set this CPU can run; checks the CPU the first time only
+const t_osc_kernels *osc_kernels_best(void);
+
+// The `kernel` message: with no name, posts which set *k is; with the name of
+// one ("scalar", "sse2", "avx2", "avx512") that this CPU can run, switches *k
+// to it. `x` and `classname` are for the messages. Returns 1 if *k changed, so
+// the caller can rebuild the DSP chain.
+int osc_kernels_select(void *x, const char *classname,
+  const t_osc_kernels **k, t_symbol *s);
+
+#endif
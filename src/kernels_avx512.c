@@ -0,0 +1,30 @@
+// osc_simd.h for AVX-512, see kernels.h. Only the foundation instructions
+// (AVX-512F) are used, which every AVX-512 CPU has.
+
+#include "m_pd.h"
+#include "kernels.h"
+
+#ifdef OSC_KERNELS_AVX512
+
+#if defined(__clang__)
+# pragma clang attribute push( \
+    __attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#else
+# pragma GCC target("avx512f,avx2,fma")
+#endif
+
+#define OSC_SIMD_WIDTH 16
+#include "osc_simd.h"
+
+const t_osc_kernels osc_kernels_avx512 = {
+  "avx512", OSC_SIMD_WIDTH, osc_simd_lerp, osc_simd_lerp_const,
+  osc_simd_xfade, osc_simd_phasor, osc_simd_bank_group, osc_simd_bank_sum,
+  osc_simd_halfband, osc_simd_tri, osc_simd_tri_phasor, osc_simd_poly,
+  osc_simd_rotor
+};
+
+#if defined(__clang__)
+# pragma clang attribute pop
+#endif
+
+#endif
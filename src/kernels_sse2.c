@@ -0,0 +1,17 @@
+// osc_simd.h for SSE2, see kernels.h
+
+#include "m_pd.h"
+#include "kernels.h"
+
+#ifdef OSC_KERNELS_SSE2
+
+#define OSC_SIMD_WIDTH 4
+#include "osc_simd.h"
+
+const t_osc_kernels osc_kernels_sse2 = {
+  "sse2", OSC_SIMD_WIDTH, osc_simd_lerp, osc_simd_lerp_const, osc_simd_xfade,
+  osc_simd_phasor, osc_simd_bank_group, osc_simd_bank_sum, osc_simd_halfband,
+  osc_simd_tri, osc_simd_tri_phasor, osc_simd_poly, osc_simd_rotor
+};
+
+#endif
@@ -1,120 +1,584 @@
 // updated version of simple_osc~.c
+//
+// `approx <degree>` (3, 5, 7 or 9) computes the cosine with a polynomial
+// instead of reading the table, see approx.h for how close each degree gets;
+// `approx 0` goes back to the table.
+//
+// The middle inlet is hard sync: a phasor there restarts the cosine at every
+// wrap, at the exact point between samples, with the jump band-limited (see
+// sync.h). Synced output is a sample late.
+//
+// The right inlet is phase modulation, in cycles, like a [+~] between
+// [phasor~] and [cos~]: it's added to the phase for reading the cosine only,
+// so the oscillator keeps its own phase under it. A float there is a fixed
+// phase offset. For more than one modulator see fm_op~.
+//
+// With the table, blocks where the frequency doesn't change are made by the
+// rotor of rotor.h instead; `rotor 0` turns that off, `rotor 1` back on.
+// Sync and phase modulation signals always use the table (or `approx`).
 
 #include "m_pd.h"
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "wavetable.h"
+#include "connect.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+#include "multichannel.h"
+#include "approx.h"
+#include "sync.h"
+#include "rotor.h"
 
-// #define WAVETABLE_SIZE 16384 // 2^14
-#define WAVETABLE_SIZE 4096 // 2^12 might be good enough
+// #define WAVETABLE_BITS 14 // 16384
+#define WAVETABLE_BITS 12 // 2^12 might be good enough
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
 
 static t_class *modern_osc_class = NULL;
-static float *cos_table = NULL; // shared wavetable
-static int table_reference_count = 0; // track how many instances exist
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
 
 typedef struct _modern_osc {
   t_object x_obj;
-  double x_phase;
-  t_float x_conv;
-  t_inlet *x_freq_inlet;
+  t_osc_phase *x_phases; // see phase.h, one per channel
+  int x_nphases; // room in x_phases
+  double x_conv;
+  t_inlet *x_sync_inlet;
+  t_inlet *x_pm_inlet;
   t_outlet *x_outlet;
   t_float x_f;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
+  int x_approx; // polynomial degree for `approx`, 0 for the table
+  const float *x_coefs; // its coefficients (approx.h), NULL for the table
+  t_osc_sync *x_sync; // see sync.h, one per channel while sync is connected
+  int x_nsync; // room in x_sync
+  int x_rotor; // the `rotor` message
+  t_osc_rotor *x_rotors; // see rotor.h, one per channel
+  int x_nrotors; // room in x_rotors
 } t_modern_osc;
 
-static void wavetable_init(void)
+// Each channel (see multichannel.h) is n samples of `in` and `out`, the
+// next one right after it. `pm` is the phase modulation inlet, which in
+// these routines has nothing connected, so its one value is a fixed offset:
+// the phase is kept without it and read with it.
+static t_int *modern_osc_perform(t_int *w)
 {
-  if (cos_table == NULL) {
-    cos_table = (float *)getbytes(sizeof(float) * (WAVETABLE_SIZE ));
-    if (cos_table) {
-      for (int i = 0; i < WAVETABLE_SIZE; i++) {
-        cos_table[i] = cosf((i * 2.0f * (float)M_PI) / (float)WAVETABLE_SIZE);
-      }
-      post("modern_osc~: initialized cosine table of size %d", WAVETABLE_SIZE);
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+
+  const float *tab = cos_table;
+  double conv = x->x_conv;
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  if (!tab) return (w+7);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c] + off;
+
+    for (int i = 0; i < n; i++) {
+      t_osc_phase curphase = phase;
+      // unsigned overflow does the wrapping, negative frequencies included
+      phase += osc_phase_wrap(*in++ * conv);
+      uint32_t idx = osc_phase_index(curphase, WAVETABLE_BITS);
+      t_sample frac = osc_phase_frac(curphase, WAVETABLE_BITS);
+
+      t_sample f1 = tab[idx];
+      t_sample f2 = tab[idx + 1]; // guard point, see wavetable.h
+      *out++ = f1 + frac * (f2 - f1);
+    }
+
+    x->x_phases[c] = phase - off;
+  }
+
+  return (w + 7);
+}
+
+// the frequency inlet only gets floats, so one increment does for the block
+// and all the channels
+static t_int *modern_osc_perform_const(t_int *w)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+
+  const float *tab = cos_table;
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  if (!tab) return (w+7);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c] + off;
+
+    for (int i = 0; i < n; i++) {
+      uint32_t idx = osc_phase_index(phase, WAVETABLE_BITS);
+      t_sample frac = osc_phase_frac(phase, WAVETABLE_BITS);
+      phase += inc;
+
+      t_sample f1 = tab[idx];
+      t_sample f2 = tab[idx + 1];
+      *out++ = f1 + frac * (f2 - f1);
+    }
+
+    x->x_phases[c] = phase - off;
+  }
+
+  return (w + 7);
+}
+
+static t_int *modern_osc_perform_simd(t_int *w)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  if (!cos_table) return (w+7);
+
+  for (int c = 0; c < nchans; c++, in += n, out += n) {
+    x->x_phases[c] = x->x_kernels->lerp(cos_table, WAVETABLE_BITS,
+      x->x_phases[c] + off, in, x->x_conv, out, n) - off;
+  }
+  return (w + 7);
+}
+
+static t_int *modern_osc_perform_simd_const(t_int *w)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  if (!cos_table) return (w+7);
+
+  for (int c = 0; c < nchans; c++, out += n) {
+    x->x_phases[c] = x->x_kernels->lerp_const(cos_table, WAVETABLE_BITS,
+      x->x_phases[c] + off, inc, out, n) - off;
+  }
+  return (w + 7);
+}
+
+// The rotor (rotor.h) for the channels whose frequency holds still (see
+// osc_rotor_held()), the table for the others; a changed offset starts the
+// rotor again.
+static t_int *modern_osc_perform_rotor_body(t_int *w,
+  const int freq_signal)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+  const t_osc_kernels *k = x->x_kernels;
+  const float *tab = cos_table;
+  double conv = x->x_conv;
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  if (!tab) return (w+7);
+
+  for (int c = 0; c < nchans; c++, in += freq_signal ? n : 0, out += n) {
+    t_osc_phase phase = x->x_phases[c] + off;
+    t_osc_phase inc = osc_phase_wrap(in[0] * conv);
+
+    if (osc_rotor_held(&x->x_rotors[c],
+                       !freq_signal || osc_rotor_const(in, n), inc)) {
+      phase = osc_rotor(&x->x_rotors[c], k, phase, inc, out, n);
+    } else if (!freq_signal && k->width) {
+      phase = k->lerp_const(tab, WAVETABLE_BITS, phase, inc, out, n);
+    } else if (k->width) {
+      phase = k->lerp(tab, WAVETABLE_BITS, phase, in, conv, out, n);
     } else {
-      post("modern_osc~ error: failed to allocate memory for cosine table");
+      for (int i = 0; i < n; i++) {
+        uint32_t idx = osc_phase_index(phase, WAVETABLE_BITS);
+        t_sample frac = osc_phase_frac(phase, WAVETABLE_BITS);
+        phase += freq_signal ? osc_phase_wrap(in[i] * conv) : inc;
+        out[i] = tab[idx] + frac * (tab[idx + 1] - tab[idx]);
+      }
     }
+    x->x_phases[c] = phase - off;
   }
-  table_reference_count++;
+  return (w + 7);
+}
+
+static t_int *modern_osc_perform_rotor(t_int *w)
+{
+  return modern_osc_perform_rotor_body(w, 1);
+}
+
+static t_int *modern_osc_perform_rotor_const(t_int *w)
+{
+  return modern_osc_perform_rotor_body(w, 0);
 }
 
-static void wavetable_free(void)
+// `approx`: the polynomial instead of the table
+static t_int *modern_osc_perform_poly(t_int *w)
 {
-  table_reference_count--;
-  if (table_reference_count <= 0 && cos_table != NULL) {
-    freebytes(cos_table, sizeof(float) * (WAVETABLE_SIZE));
-    cos_table = NULL;
-    post("modern_osc~: freed cosine table");
-    table_reference_count = 0; // just to be safe
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+
+  const float *coefs = x->x_coefs;
+  int ncoefs = (x->x_approx + 1) / 2;
+  double conv = x->x_conv;
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c] + off;
+
+    for (int i = 0; i < n; i++) {
+      t_osc_phase curphase = phase;
+      phase += osc_phase_wrap(*in++ * conv);
+      *out++ = osc_approx_cos(curphase, coefs, ncoefs);
+    }
+
+    x->x_phases[c] = phase - off;
   }
+
+  return (w + 7);
 }
 
-static t_int *modern_osc_perform(t_int *w)
+static t_int *modern_osc_perform_poly_const(t_int *w)
 {
   t_modern_osc *x = (t_modern_osc *)(w[1]);
-  t_sample *in = (t_sample *)(w[2]); // fix the type
-  t_sample *out = (t_sample *)(w[3]); // fix the type
-  int n = (int)(w[4]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+
+  const float *coefs = x->x_coefs;
+  int ncoefs = (x->x_approx + 1) / 2;
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c] + off;
 
-  float *tab = cos_table;
-  t_float conv = x->x_conv;
-  double phase = x->x_phase;
+    for (int i = 0; i < n; i++) {
+      *out++ = osc_approx_cos(phase, coefs, ncoefs);
+      phase += inc;
+    }
 
-  if (!tab) return (w+5);
+    x->x_phases[c] = phase - off;
+  }
 
-  while (n--) {
-    double curphase = phase;
-    phase += *in++ * conv;
-    unsigned int idx = (unsigned int)curphase;
-    t_sample frac = (t_sample)(curphase - idx);
+  return (w + 7);
+}
 
-    idx &= (WAVETABLE_SIZE - 1);
+static t_int *modern_osc_perform_poly_simd(t_int *w)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+  int ncoefs = (x->x_approx + 1) / 2;
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
+
+  for (int c = 0; c < nchans; c++, in += n, out += n) {
+    x->x_phases[c] = x->x_kernels->poly(x->x_phases[c] + off, in, x->x_conv,
+      0, x->x_coefs, ncoefs, out, n) - off;
+  }
+  return (w + 7);
+}
+
+static t_int *modern_osc_perform_poly_simd_const(t_int *w)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *pm = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  int nchans = (int)(w[6]);
+  int ncoefs = (x->x_approx + 1) / 2;
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
 
-    t_sample f1 = tab[idx];
-    t_sample f2 = tab[(idx + 1) & (WAVETABLE_SIZE - 1)];
-    *out++ = f1 + frac * (f2 - f1);
+  for (int c = 0; c < nchans; c++, out += n) {
+    x->x_phases[c] = x->x_kernels->poly(x->x_phases[c] + off, NULL, 0, inc,
+      x->x_coefs, ncoefs, out, n) - off;
   }
+  return (w + 7);
+}
+
+// the cosine at p, from the polynomial or the table
+static inline float modern_osc_value(t_osc_phase p, const float *tab,
+  const float *coefs, int ncoefs, const int poly)
+{
+  if (poly) return osc_approx_cos(p, coefs, ncoefs);
+  uint32_t idx = osc_phase_index(p, WAVETABLE_BITS);
+  t_sample frac = osc_phase_frac(p, WAVETABLE_BITS);
+  return tab[idx] + frac * (tab[idx + 1] - tab[idx]);
+}
+
+// With a signal in the sync or phase modulation inlet (or both), for the
+// table or the polynomial (poly), all flags constants. The sync and phase
+// modulation inputs have syncchans and pmchans channels. The phase is kept
+// unmodulated, so sync restarts the oscillator itself and the modulation
+// goes on on top of that.
+static inline t_int *modern_osc_perform_mod_body(t_int *w,
+  const int freq_signal, const int poly, const int sync_signal,
+  const int pm_signal)
+{
+  t_modern_osc *x = (t_modern_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *sync = (t_sample *)(w[3]);
+  t_sample *pm = (t_sample *)(w[4]);
+  t_sample *out = (t_sample *)(w[5]);
+  int n = (int)(w[6]);
+  int nchans = (int)(w[7]);
+  int syncchans = (int)(w[8]);
+  int pmchans = (int)(w[9]);
+
+  const float *tab = cos_table;
+  const float *coefs = x->x_coefs;
+  int ncoefs = (x->x_approx + 1) / 2;
+  double conv = x->x_conv;
+  t_osc_phase inc = osc_phase_wrap(in[0] * conv);
+  t_osc_phase off = osc_phase_from_cycles(pm[0]);
 
-  while (phase >= WAVETABLE_SIZE) phase -= WAVETABLE_SIZE;
-  while (phase < 0) phase += WAVETABLE_SIZE;
-  x->x_phase = phase;
+  if (!poly && !tab) return (w+10);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c];
+    t_osc_sync *sy = sync_signal ? &x->x_sync[c] : NULL;
+    t_sample *s = osc_mc_chan(sync, syncchans, n, c);
+    t_sample *m = osc_mc_chan(pm, pmchans, n, c);
+
+    for (int i = 0; i < n; i++) {
+      t_osc_phase before;
+      float d, y;
+      if (freq_signal) inc = osc_phase_wrap(*in++ * conv);
+      // NaN and inf come out as no offset, see phase.h
+      if (pm_signal) off = osc_phase_from_cycles(m[i]);
+
+      if (sync_signal && osc_sync_check(sy, s[i], &phase, &before, &d)) {
+        // the jump from where the wave was to the top of the cycle
+        float h = modern_osc_value(off, tab, coefs, ncoefs, poly)
+          - modern_osc_value(before + off, tab, coefs, ncoefs, poly);
+        y = osc_sync_blep(sy,
+          modern_osc_value(phase + off, tab, coefs, ncoefs, poly), h, d);
+      } else {
+        y = modern_osc_value(phase + off, tab, coefs, ncoefs, poly);
+      }
+      *out++ = sync_signal ? osc_sync_out(sy, y) : y;
+      phase += inc;
+      if (sync_signal) osc_sync_next(sy, inc);
+    }
+
+    x->x_phases[c] = phase;
+  }
 
-  return (w + 5);
+  return (w + 10);
 }
 
+// modern_osc_perform_mod_FPSM, with F, S and M 1 if the frequency, sync and
+// phase modulation inlets have a signal connected and P 1 for `approx`
+#define MODERN_OSC_PERFORM_MOD(f, p, s, m) \
+  static t_int *modern_osc_perform_mod_##f##p##s##m(t_int *w) \
+  { \
+    return modern_osc_perform_mod_body(w, f, p, s, m); \
+  }
+
+#define MODERN_OSC_PERFORMS_MOD(f, p) \
+  MODERN_OSC_PERFORM_MOD(f, p, 0, 1) \
+  MODERN_OSC_PERFORM_MOD(f, p, 1, 0) \
+  MODERN_OSC_PERFORM_MOD(f, p, 1, 1)
+
+MODERN_OSC_PERFORMS_MOD(0, 0)
+MODERN_OSC_PERFORMS_MOD(0, 1)
+MODERN_OSC_PERFORMS_MOD(1, 0)
+MODERN_OSC_PERFORMS_MOD(1, 1)
+
+// by frequency, approx, sync and phase modulation; with neither of the last
+// two connected it's one of the routines above instead
+static const t_perfroutine modern_osc_performs_mod[2][2][2][2] = {
+  {{{NULL, modern_osc_perform_mod_0001},
+    {modern_osc_perform_mod_0010, modern_osc_perform_mod_0011}},
+   {{NULL, modern_osc_perform_mod_0101},
+    {modern_osc_perform_mod_0110, modern_osc_perform_mod_0111}}},
+  {{{NULL, modern_osc_perform_mod_1001},
+    {modern_osc_perform_mod_1010, modern_osc_perform_mod_1011}},
+   {{NULL, modern_osc_perform_mod_1101},
+    {modern_osc_perform_mod_1110, modern_osc_perform_mod_1111}}},
+};
+
 static void modern_osc_dsp(t_modern_osc *x, t_signal **sp)
 {
+  t_perfroutine perform;
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  int sync_signal = osc_signal_connected(&x->x_obj, x->x_glist, 1);
+  int pm_signal = osc_signal_connected(&x->x_obj, x->x_glist, 2);
+  int mod = sync_signal || pm_signal;
+  int simd = !mod && x->x_kernels->width
+    && sp[0]->s_length >= x->x_kernels->width;
+  int rotor = !mod && !x->x_coefs && x->x_rotor
+    && sp[0]->s_length >= OSC_ROTOR_LANES;
+  char path[OSC_STATS_PATHSIZE];
+
   // calculate the conversion factor for this sample rate
-  x->x_conv = (float)WAVETABLE_SIZE / sp[0]->s_sr;
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  // the output gets as many channels as the frequency
+  int nchans = osc_mc_phases(&x->x_phases, &x->x_nphases,
+                             osc_mc_nchans(sp[0]));
 
-  dsp_add(modern_osc_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+  if (sync_signal) {
+    void *state = x->x_sync;
+    nchans = osc_mc_state(&state, &x->x_nsync, nchans, sizeof(t_osc_sync));
+    x->x_sync = (t_osc_sync *)state;
+  }
+  if (rotor) {
+    void *state = x->x_rotors;
+    nchans = osc_mc_state(&state, &x->x_nrotors, nchans, sizeof(t_osc_rotor));
+    x->x_rotors = (t_osc_rotor *)state;
+  }
+
+  if (mod)
+    perform = modern_osc_performs_mod[freq_signal][x->x_coefs != NULL]
+                                     [sync_signal][pm_signal];
+  else if (x->x_coefs && simd)
+    perform = freq_signal ? modern_osc_perform_poly_simd
+                          : modern_osc_perform_poly_simd_const;
+  else if (x->x_coefs)
+    perform = freq_signal ? modern_osc_perform_poly
+                          : modern_osc_perform_poly_const;
+  else if (rotor)
+    perform = freq_signal ? modern_osc_perform_rotor
+                          : modern_osc_perform_rotor_const;
+  else if (simd)
+    perform = freq_signal ? modern_osc_perform_simd : modern_osc_perform_simd_const;
+  else
+    perform = freq_signal ? modern_osc_perform : modern_osc_perform_const;
+
+  // signal vectors are inlets first, then the outlet: sp[1] is the sync
+  // inlet, sp[2] the phase modulation, the output is sp[3]
+  osc_mc_setout(&sp[3], nchans);
+  osc_stats_dsp_begin(&x->x_stats);
+  if (mod)
+    dsp_add(perform, 9, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec,
+            sp[3]->s_vec, sp[0]->s_length, nchans, osc_mc_nchans(sp[1]),
+            osc_mc_nchans(sp[2]));
+  else
+    dsp_add(perform, 6, x, sp[0]->s_vec, sp[2]->s_vec, sp[3]->s_vec,
+            sp[0]->s_length, nchans);
+  if (x->x_coefs)
+    snprintf(path, sizeof(path), "degree %d polynomial, ", x->x_approx);
+  else if (rotor)
+    snprintf(path, sizeof(path), "rotor or ");
+  else
+    path[0] = 0;
+  snprintf(path + strlen(path), sizeof(path) - strlen(path), "%s%s%s%s",
+           simd ? "simd" : "scalar", sync_signal ? ", sync" : "",
+           pm_signal ? ", pm" : "", freq_signal ? "" : ", constant frequency");
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length * nchans);
+}
+
+static void modern_osc_approx(t_modern_osc *x, t_floatarg f)
+{
+  int degree = (int)f;
+  const float *coefs = degree ? osc_approx_coefs(degree) : NULL;
+
+  if (degree && !coefs) {
+    pd_error(x, "modern_osc~: approx: degree 3, 5, 7 or 9, or 0 for the "
+             "table");
+    return;
+  }
+  if (degree != x->x_approx) {
+    x->x_approx = degree;
+    x->x_coefs = coefs;
+    canvas_update_dsp();
+  }
+}
+
+static void modern_osc_rotor(t_modern_osc *x, t_floatarg f)
+{
+  int on = f != 0;
+  if (on != x->x_rotor) {
+    x->x_rotor = on;
+    canvas_update_dsp();
+  }
+}
+
+static void modern_osc_kernel(t_modern_osc *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "modern_osc~", &x->x_kernels, s))
+    canvas_update_dsp();
 }
 
 static void *modern_osc_new(t_floatarg f)
 {
   t_modern_osc *x = (t_modern_osc *)pd_new(modern_osc_class);
 
-  x->x_phase = (double)0.0;
+  x->x_phases = NULL;
+  x->x_nphases = 0;
+  osc_mc_phases(&x->x_phases, &x->x_nphases, 1);
   x->x_f = f > 0 ? (t_float)f : (t_float)220.0;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_kernels = osc_kernels_best();
+  x->x_approx = 0;
+  x->x_coefs = NULL;
+  x->x_sync = NULL;
+  x->x_nsync = 0;
+  x->x_rotor = 1;
+  x->x_rotors = NULL;
+  x->x_nrotors = 0;
 
-  x->x_freq_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
-  pd_float((t_pd *)x->x_freq_inlet, x->x_f);
+  x->x_sync_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+  x->x_pm_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   x->x_outlet = outlet_new(&x->x_obj, &s_signal);
 
-  wavetable_init();
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_LINEAR);
 
   return (void *)x;
 }
 
 static void modern_osc_free(t_modern_osc *x)
 {
-  if (x->x_freq_inlet) {
-    inlet_free(x->x_freq_inlet);
+  if (x->x_sync_inlet) {
+    inlet_free(x->x_sync_inlet);
+  }
+
+  if (x->x_pm_inlet) {
+    inlet_free(x->x_pm_inlet);
   }
 
   if (x->x_outlet) {
     outlet_free(x->x_outlet);
   }
 
+  osc_mc_freephases(x->x_phases, x->x_nphases);
+  osc_mc_freestate(x->x_sync, x->x_nsync, sizeof(t_osc_sync));
+  osc_mc_freestate(x->x_rotors, x->x_nrotors, sizeof(t_osc_rotor));
+
   // decrease reference count and possibly free wavetable
-  wavetable_free();
+  wavetable_release(cos_table);
+}
+
+static void modern_osc_stats(t_modern_osc *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "modern_osc~", argc, argv);
 }
 
 void modern_osc_tilde_setup(void)
@@ -123,11 +587,19 @@ void modern_osc_tilde_setup(void)
                                (t_newmethod)modern_osc_new,
                                (t_method)modern_osc_free,
                                sizeof(t_modern_osc),
-                               CLASS_DEFAULT,
+                               CLASS_DEFAULT | OSC_MC_CLASS,
                                A_DEFFLOAT, 0);
 
   class_addmethod(modern_osc_class, (t_method)modern_osc_dsp, gensym("dsp"), A_CANT, 0);
   CLASS_MAINSIGNALIN(modern_osc_class, t_modern_osc, x_f);
+  class_addmethod(modern_osc_class, (t_method)modern_osc_kernel,
+                  gensym("kernel"), A_DEFSYM, 0);
+  class_addmethod(modern_osc_class, (t_method)modern_osc_approx,
+                  gensym("approx"), A_FLOAT, 0);
+  class_addmethod(modern_osc_class, (t_method)modern_osc_rotor,
+                  gensym("rotor"), A_FLOAT, 0);
+  class_addmethod(modern_osc_class, (t_method)modern_osc_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
 
 
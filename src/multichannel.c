@@ -0,0 +1,77 @@
+// See multichannel.h
+
+#include "m_pd.h"
+#include "multichannel.h"
+
+#ifdef CLASS_MULTICHANNEL
+// Found at run time rather than linked to, so the library still loads into a
+// Pd older than 0.54, which doesn't have it; there it's NULL and t_signal
+// doesn't have s_nchans either.
+# ifdef _WIN32
+#  include <windows.h>
+typedef void (*t_osc_setmultiout)(t_signal **sig, int nchans);
+
+static t_osc_setmultiout osc_mc_setmultiout(void)
+{
+  static t_osc_setmultiout fn = NULL;
+  static int init = 0;
+  if (!init) {
+    HMODULE pd = GetModuleHandleA("pd.dll");
+    if (pd) fn = (t_osc_setmultiout)(void *)GetProcAddress(pd,
+      "signal_setmultiout");
+    init = 1;
+  }
+  return fn;
+}
+# else
+#  pragma weak signal_setmultiout
+#  define osc_mc_setmultiout() (signal_setmultiout)
+# endif
+#endif
+
+int osc_mc_nchans(const t_signal *s)
+{
+#ifdef CLASS_MULTICHANNEL
+  if (osc_mc_setmultiout()) return s->s_nchans;
+#endif
+  return 1;
+}
+
+void osc_mc_setout(t_signal **sp, int nchans)
+{
+#ifdef CLASS_MULTICHANNEL
+  if (osc_mc_setmultiout()) osc_mc_setmultiout()(sp, nchans);
+#endif
+}
+
+int osc_mc_state(void **state, int *size, int nchans, size_t bytes)
+{
+  void *p;
+
+  if (nchans <= *size) return nchans;
+  p = *state ? resizebytes(*state, *size * bytes, nchans * bytes)
+             : getbytes(nchans * bytes);
+  if (!p) return *size;
+  // resizebytes() zeroes the new part too
+  *state = p;
+  *size = nchans;
+  return nchans;
+}
+
+void osc_mc_freestate(void *state, int size, size_t bytes)
+{
+  if (state) freebytes(state, size * bytes);
+}
+
+int osc_mc_phases(t_osc_phase **phases, int *size, int nchans)
+{
+  void *p = *phases;
+  nchans = osc_mc_state(&p, size, nchans, sizeof(t_osc_phase));
+  *phases = (t_osc_phase *)p;
+  return nchans;
+}
+
+void osc_mc_freephases(t_osc_phase *phases, int size)
+{
+  osc_mc_freestate(phases, size, sizeof(t_osc_phase));
+}
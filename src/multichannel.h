@@ -0,0 +1,55 @@
+// Pd 0.54's multichannel signals, for the classes that take them.
+//
+// A class created with OSC_MC_CLASS gets its signals as they are: an inlet
+// can bring several channels, one s_length block after the other in s_vec,
+// and the dsp method says how many channels each outlet has. The classes here
+// give their outlet as many channels as their main (left) inlet has and keep
+// one phase per channel (osc_mc_phases()), so [snake~] into a 16 channel
+// oscillator is one object and one perform routine instead of sixteen. The
+// other inlets either have that many channels too or one that goes to all of
+// them (osc_mc_chan()).
+//
+// Built against an older m_pd.h, or loaded into an older Pd, everything here
+// is one channel and the classes work as before. Include after m_pd.h.
+
+#ifndef OSC_MULTICHANNEL_H
+#define OSC_MULTICHANNEL_H
+
+#include "phase.h"
+
+// class_new() flag
+#ifdef CLASS_MULTICHANNEL
+# define OSC_MC_CLASS CLASS_MULTICHANNEL
+#else
+# define OSC_MC_CLASS 0
+#endif
+
+// the number of channels in s; always 1 without multichannel support
+int osc_mc_nchans(const t_signal *s);
+
+// Set the outlet signal *sp to nchans channels. Call this for every signal
+// outlet in the dsp method, before reading (*sp)->s_vec: in a multichannel
+// class Pd only allocates the outlets here.
+void osc_mc_setout(t_signal **sp, int nchans);
+
+// Make *phases (with room for *size) hold nchans phases: the ones there keep
+// their values, new ones start at 0. *phases starts out NULL with *size 0;
+// free it with osc_mc_freephases(). Returns the number of channels it has
+// room for, which is less than nchans only if the allocation failed.
+int osc_mc_phases(t_osc_phase **phases, int *size, int nchans);
+void osc_mc_freephases(t_osc_phase *phases, int size);
+
+// the same for any other per-channel state, `bytes` per channel, which starts
+// out as all zeros
+int osc_mc_state(void **state, int *size, int nchans, size_t bytes);
+void osc_mc_freestate(void *state, int size, size_t bytes);
+
+// channel c of an inlet with `nchans` channels of n samples, where an inlet
+// with fewer channels than the outlet starts again from its first one (so one
+// channel goes to all of them)
+static inline t_sample *osc_mc_chan(t_sample *vec, int nchans, int n, int c)
+{
+  return vec + (c % nchans) * n;
+}
+
+#endif
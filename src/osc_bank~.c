@@ -0,0 +1,395 @@
+// A bank of modern_osc~ style oscillators in one object, for polyphony without
+// a [clone] of hundreds of modern_osc~: one perform routine per block instead
+// of one per voice.
+//
+// The voices are kept as structure-of-arrays (all the phases together, all the
+// increments together...) so the SIMD kernel in osc_simd.h can run a vector's
+// worth of voices side by side, one per lane, rather than vectorizing
+// over time like the single oscillators do. Groups of voices that are silent
+// for the whole block are skipped.
+//
+// [osc_bank~ 16] has 16 voices (default 8). Messages, voices counted from 1
+// like [poly]'s output:
+//
+//   freq <voice> <hz>
+//   amp <voice> <amplitude>
+//   list <voice> <hz> <amplitude> (e.g. straight from [poly] + [pack])
+//   unison <copies> <cents>: each voice becomes that many oscillators spread
+//     evenly over <cents> (total, not either side), each at 1/copies of the
+//     voice's amplitude. `unison 1 0` turns it off. Sounding voices go on
+//     from where they are rather than starting over.
+//   clear: all amplitudes to 0
+//
+// Amplitude changes are ramped over one block so voices don't click on and
+// off. Output is the sum of all voices.
+
+#include "m_pd.h"
+#include <math.h>
+#include "wavetable.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+
+// same table as modern_osc~, so the two share it
+#define WAVETABLE_BITS 12
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+
+#define OSC_BANK_DEFVOICES 8
+#define OSC_BANK_MAXVOICES 1024
+#define OSC_BANK_MAXUNISON 16
+
+// oscillators are handled in groups of the kernel set's width (1 for the
+// scalar one); the arrays are padded with silent oscillators to a whole number
+// of the widest groups, so any set can be picked later
+#define OSC_BANK_PAD OSC_KERNELS_MAXWIDTH
+
+static t_class *osc_bank_class = NULL;
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
+
+typedef struct _osc_bank {
+  t_object x_obj;
+  double x_conv; // phase increment per Hz, see phase.h
+
+  // per voice
+  int x_nvoices;
+  t_float *x_freq;
+  t_float *x_vamp;
+
+  // unison
+  int x_nunison;
+  t_float x_detune; // cents, total spread
+
+  // per oscillator: voice v's copies are v * x_nunison ... + x_nunison - 1
+  int x_nosc; // x_nvoices * x_nunison rounded up to whole groups
+  t_osc_phase *x_phase;
+  t_osc_phase *x_inc;
+  double *x_ratio; // unison detune as a frequency ratio
+  float *x_amp; // where the ramp is now
+  float *x_target; // where it's going
+  float *x_damp; // ramp step per sample for this block
+
+  float *x_acc; // one sum per lane per sample, see osc_simd_bank_group()
+  int x_accsize;
+  const t_osc_kernels *x_kernels; // see kernels.h
+
+  t_outlet *x_outlet;
+  t_osc_stats x_stats; // see stats.h
+} t_osc_bank;
+
+static void osc_bank_update_voice(t_osc_bank *x, int v)
+{
+  int u = x->x_nunison;
+  float amp = x->x_vamp[v] / u;
+  for (int o = v * u; o < (v + 1) * u; o++) {
+    x->x_inc[o] = osc_phase_wrap(x->x_freq[v] * x->x_ratio[o] * x->x_conv);
+    x->x_target[o] = amp;
+  }
+}
+
+static void osc_bank_free_osc(t_osc_bank *x)
+{
+  int n = x->x_nosc;
+  if (!n) return;
+  freebytes(x->x_phase, n * sizeof(t_osc_phase));
+  freebytes(x->x_inc, n * sizeof(t_osc_phase));
+  freebytes(x->x_ratio, n * sizeof(double));
+  freebytes(x->x_amp, n * sizeof(float));
+  freebytes(x->x_target, n * sizeof(float));
+  freebytes(x->x_damp, n * sizeof(float));
+  x->x_nosc = 0;
+}
+
+// each copy's share of the unison spread, and the voices retuned for it
+static void osc_bank_set_ratios(t_osc_bank *x)
+{
+  int u = x->x_nunison;
+  for (int o = 0; o < x->x_nvoices * u; o++) {
+    int k = o % u;
+    double cents = u > 1 ? x->x_detune * ((double)k / (u - 1) - 0.5) : 0;
+    x->x_ratio[o] = pow(2.0, cents / 1200.0);
+  }
+  for (int v = 0; v < x->x_nvoices; v++) osc_bank_update_voice(x, v);
+}
+
+// (re)build the oscillator arrays for the current voice count and unison
+// settings, from `oldu` copies a voice before. The copies a voice had already
+// keep their phase and amplitude and ramp to their new share from there, so
+// more or fewer copies don't click. Messages and DSP run on the same thread
+// in Pd, so this can't happen in the middle of a perform.
+static int osc_bank_alloc_osc(t_osc_bank *x, int oldu)
+{
+  int u = x->x_nunison;
+  int used = x->x_nvoices * u;
+  int n = (used + OSC_BANK_PAD - 1) / OSC_BANK_PAD * OSC_BANK_PAD;
+  int keep = !x->x_nosc ? 0 : oldu < u ? oldu : u;
+  t_osc_phase *phase, *inc;
+  double *ratio;
+  float *amp, *target, *damp;
+
+  if (!n) {
+    osc_bank_free_osc(x);
+    return 0;
+  }
+  phase = (t_osc_phase *)getbytes(n * sizeof(t_osc_phase));
+  inc = (t_osc_phase *)getbytes(n * sizeof(t_osc_phase));
+  ratio = (double *)getbytes(n * sizeof(double));
+  amp = (float *)getbytes(n * sizeof(float));
+  target = (float *)getbytes(n * sizeof(float));
+  damp = (float *)getbytes(n * sizeof(float));
+  if (!phase || !inc || !ratio || !amp || !target || !damp) {
+    pd_error(x, "osc_bank~: out of memory");
+    if (phase) freebytes(phase, n * sizeof(t_osc_phase));
+    if (inc) freebytes(inc, n * sizeof(t_osc_phase));
+    if (ratio) freebytes(ratio, n * sizeof(double));
+    if (amp) freebytes(amp, n * sizeof(float));
+    if (target) freebytes(target, n * sizeof(float));
+    if (damp) freebytes(damp, n * sizeof(float));
+    osc_bank_free_osc(x);
+    return 0;
+  }
+
+  for (int o = 0; o < used; o++) {
+    int v = o / u, k = o % u;
+    if (k < keep) {
+      phase[o] = x->x_phase[v * oldu + k];
+      amp[o] = x->x_amp[v * oldu + k];
+    } else {
+      // start new copies at scattered phases (steps of the golden ratio) so
+      // they don't all line up; evenly spaced ones would cancel out instead
+      phase[o] = (t_osc_phase)k * 2654435769u;
+    }
+  }
+  // padding oscillators stay at amplitude 0 (getbytes zeroes)
+  osc_bank_free_osc(x);
+  x->x_phase = phase;
+  x->x_inc = inc;
+  x->x_ratio = ratio;
+  x->x_amp = amp;
+  x->x_target = target;
+  x->x_damp = damp;
+  x->x_nosc = n;
+  osc_bank_set_ratios(x);
+  return 1;
+}
+
+// one oscillator over n samples, added to out
+static void osc_bank_group(const float *tab, t_osc_phase *phase,
+  const t_osc_phase *inc, float *amp, const float *damp, t_sample *out, int n)
+{
+  t_osc_phase p = *phase;
+  float a = *amp;
+  while (n--) {
+    uint32_t idx = osc_phase_index(p, WAVETABLE_BITS);
+    float frac = osc_phase_frac(p, WAVETABLE_BITS);
+    *out++ += a * (tab[idx] + frac * (tab[idx + 1] - tab[idx]));
+    p += *inc;
+    a += *damp;
+  }
+  *phase = p;
+  *amp = a;
+}
+
+static t_int *osc_bank_perform(t_int *w)
+{
+  t_osc_bank *x = (t_osc_bank *)(w[1]);
+  t_sample *out = (t_sample *)(w[2]);
+  int n = (int)(w[3]);
+  float rn = 1.0f / n;
+  const t_osc_kernels *k = x->x_kernels;
+  int group = k->width ? k->width : 1;
+  float *acc = x->x_acc;
+
+  if (!cos_table) goto silent;
+  if (k->width) {
+    if (!acc || x->x_accsize < n * group) goto silent;
+    for (int i = 0; i < n * group; i++) acc[i] = 0;
+  } else {
+    for (int i = 0; i < n; i++) out[i] = 0;
+  }
+
+  for (int g = 0; g < x->x_nosc; g += group) {
+    int active = 0;
+    for (int o = g; o < g + group; o++) {
+      x->x_damp[o] = (x->x_target[o] - x->x_amp[o]) * rn;
+      active |= x->x_amp[o] != 0 || x->x_target[o] != 0;
+    }
+    if (!active) continue;
+
+    if (k->width) {
+      k->bank_group(cos_table, WAVETABLE_BITS, x->x_phase + g, x->x_inc + g,
+        x->x_amp + g, x->x_damp + g, acc, n);
+    } else {
+      osc_bank_group(cos_table, x->x_phase + g, x->x_inc + g, x->x_amp + g,
+        x->x_damp + g, out, n);
+    }
+    // land exactly on the target rather than wherever the ramp rounded to
+    for (int o = g; o < g + group; o++) x->x_amp[o] = x->x_target[o];
+  }
+
+  if (k->width) k->bank_sum(acc, out, n);
+  return (w + 4);
+
+silent:
+  for (int i = 0; i < n; i++) out[i] = 0;
+  return (w + 4);
+}
+
+static void osc_bank_dsp(t_osc_bank *x, t_signal **sp)
+{
+  int n = sp[0]->s_length;
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  for (int v = 0; v < x->x_nvoices && x->x_nosc; v++) {
+    osc_bank_update_voice(x, v);
+  }
+
+  if (x->x_accsize != n * x->x_kernels->width) {
+    if (x->x_acc) freebytes(x->x_acc, x->x_accsize * sizeof(float));
+    x->x_accsize = n * x->x_kernels->width;
+    x->x_acc = x->x_accsize
+      ? (float *)getbytes(x->x_accsize * sizeof(float)) : NULL;
+    if (!x->x_acc) x->x_accsize = 0;
+  }
+
+  // no signal inlets, so sp[0] is the outlet
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(osc_bank_perform, 3, x, sp[0]->s_vec, n);
+  osc_stats_dsp_end(&x->x_stats, x->x_kernels->name, n);
+}
+
+static int osc_bank_voice(t_osc_bank *x, t_floatarg f)
+{
+  int v = (int)f - 1;
+  if (v < 0 || v >= x->x_nvoices) {
+    pd_error(x, "osc_bank~: no voice %d (1 to %d)", (int)f, x->x_nvoices);
+    return -1;
+  }
+  if (!x->x_nosc) return -1;
+  return v;
+}
+
+static void osc_bank_freq(t_osc_bank *x, t_floatarg voice, t_floatarg f)
+{
+  int v = osc_bank_voice(x, voice);
+  if (v < 0) return;
+  x->x_freq[v] = f;
+  osc_bank_update_voice(x, v);
+}
+
+static void osc_bank_amp(t_osc_bank *x, t_floatarg voice, t_floatarg a)
+{
+  int v = osc_bank_voice(x, voice);
+  if (v < 0) return;
+  x->x_vamp[v] = a;
+  osc_bank_update_voice(x, v);
+}
+
+static void osc_bank_list(t_osc_bank *x, t_symbol *s, int argc, t_atom *argv)
+{
+  int v = osc_bank_voice(x, atom_getfloatarg(0, argc, argv));
+  if (v < 0) return;
+  if (argc > 1) x->x_freq[v] = atom_getfloatarg(1, argc, argv);
+  if (argc > 2) x->x_vamp[v] = atom_getfloatarg(2, argc, argv);
+  osc_bank_update_voice(x, v);
+}
+
+static void osc_bank_unison(t_osc_bank *x, t_floatarg copies, t_floatarg cents)
+{
+  int u = (int)copies, oldu = x->x_nunison;
+  x->x_nunison = u < 1 ? 1 : u > OSC_BANK_MAXUNISON ? OSC_BANK_MAXUNISON : u;
+  x->x_detune = cents;
+  // just a new spread retunes the copies there are
+  if (x->x_nosc && x->x_nunison == oldu) osc_bank_set_ratios(x);
+  else osc_bank_alloc_osc(x, oldu);
+}
+
+static void osc_bank_clear(t_osc_bank *x)
+{
+  for (int v = 0; v < x->x_nvoices; v++) {
+    x->x_vamp[v] = 0;
+    if (x->x_nosc) osc_bank_update_voice(x, v);
+  }
+}
+
+// the accumulator is sized for the width in the dsp method
+static void osc_bank_kernel(t_osc_bank *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "osc_bank~", &x->x_kernels, s))
+    canvas_update_dsp();
+}
+
+static void *osc_bank_new(t_floatarg f)
+{
+  t_osc_bank *x = (t_osc_bank *)pd_new(osc_bank_class);
+  int nvoices = f >= 1 ? (int)f : OSC_BANK_DEFVOICES;
+
+  if (nvoices > OSC_BANK_MAXVOICES) nvoices = OSC_BANK_MAXVOICES;
+  x->x_nvoices = nvoices;
+  x->x_nunison = 1;
+  x->x_detune = 0;
+  x->x_conv = 0;
+  x->x_nosc = 0;
+  x->x_acc = NULL;
+  x->x_accsize = 0;
+  x->x_kernels = osc_kernels_best();
+  osc_stats_init(&x->x_stats);
+  x->x_freq = (t_float *)getbytes(nvoices * sizeof(t_float));
+  x->x_vamp = (t_float *)getbytes(nvoices * sizeof(t_float));
+  if (!x->x_freq || !x->x_vamp) {
+    // a bank without voices, which just outputs silence
+    pd_error(x, "osc_bank~: out of memory");
+    if (x->x_freq) freebytes(x->x_freq, nvoices * sizeof(t_float));
+    if (x->x_vamp) freebytes(x->x_vamp, nvoices * sizeof(t_float));
+    x->x_freq = x->x_vamp = NULL;
+    x->x_nvoices = nvoices = 0;
+  }
+  for (int v = 0; v < nvoices; v++) x->x_freq[v] = 220;
+  osc_bank_alloc_osc(x, 1);
+
+  x->x_outlet = outlet_new(&x->x_obj, &s_signal);
+
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_LINEAR);
+
+  return (void *)x;
+}
+
+static void osc_bank_free(t_osc_bank *x)
+{
+  outlet_free(x->x_outlet);
+  osc_bank_free_osc(x);
+  if (x->x_freq) freebytes(x->x_freq, x->x_nvoices * sizeof(t_float));
+  if (x->x_vamp) freebytes(x->x_vamp, x->x_nvoices * sizeof(t_float));
+  if (x->x_acc) freebytes(x->x_acc, x->x_accsize * sizeof(float));
+
+  wavetable_release(cos_table);
+}
+
+static void osc_bank_stats(t_osc_bank *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "osc_bank~", argc, argv);
+}
+
+void osc_bank_tilde_setup(void)
+{
+  osc_bank_class = class_new(gensym("osc_bank~"),
+                             (t_newmethod)osc_bank_new,
+                             (t_method)osc_bank_free,
+                             sizeof(t_osc_bank),
+                             CLASS_DEFAULT,
+                             A_DEFFLOAT, 0);
+
+  class_addmethod(osc_bank_class, (t_method)osc_bank_dsp, gensym("dsp"), A_CANT, 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_freq, gensym("freq"),
+                  A_FLOAT, A_FLOAT, 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_amp, gensym("amp"),
+                  A_FLOAT, A_FLOAT, 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_list, &s_list,
+                  A_GIMME, 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_unison, gensym("unison"),
+                  A_FLOAT, A_DEFFLOAT, 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_clear, gensym("clear"), 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_kernel, gensym("kernel"),
+                  A_DEFSYM, 0);
+  class_addmethod(osc_bank_class, (t_method)osc_bank_stats, gensym("stats"),
+                  A_GIMME, 0);
+}
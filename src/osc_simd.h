@@ -0,0 +1,1303 @@
+// SIMD kernels shared by the linear-interpolating table oscillators
+// (simple_osc~, tabfudge_osc~, modern_osc~, wave_osc~), plus the same phase machinery
+// without a table for simple_phasor~ and modern_osc~'s polynomial cosine, and
+// across voices rather than time for osc_bank~, and the rotor of rotor.h for
+// steady tones. The halfband decimator for oversampling (oversample.c) and
+// the triangle shaping of triangle~ and tri_phase~ are here too.
+//
+// The scalar loops are limited by the `phase += inc` dependency: every sample
+// has to wait for the previous add. Here a vector of increments is turned
+// into per-lane phases with a prefix sum, so only one add per vector is on the
+// critical path, and the table reads for all lanes happen at once.
+//
+// Phases are the 32 bit fixed-point ones from phase.h, so the lanes are plain
+// int32 adds that wrap by themselves, and the index and fraction come out
+// exactly as in the scalar routines. The output is the same as theirs, apart
+// from the compiler maybe fusing the scalar lerp into an FMA.
+//
+// The table has 2^bits points and needs a guard point: tab[2^bits] == tab[0].
+//
+// The classes don't include this: kernels_sse2.c, kernels_avx2.c and
+// kernels_avx512.c each build it for one instruction set, by defining
+// OSC_SIMD_WIDTH as 4, 8 or 16 and having the compiler target SSE2, AVX2 + FMA
+// or AVX-512 for the file, and kernels.h picks one of them at run time. Include
+// after m_pd.h.
+
+#ifndef OSC_SIMD_H
+#define OSC_SIMD_H
+
+#include "phase.h"
+#include "approx.h"
+#include "rotor.h"
+#include <math.h>
+
+#if OSC_SIMD_WIDTH >= 8
+# include <immintrin.h>
+#elif OSC_SIMD_WIDTH == 4
+# include <emmintrin.h>
+#endif
+
+#if OSC_SIMD_WIDTH
+
+// cvttpd_epi32 only covers increments up to +-2^31, i.e. frequencies below
+// Nyquist. Vectors with lanes past that (or NaN) are redone with
+// osc_phase_wrap().
+#define OSC_SIMD_INC_LIMIT 2147483647.0
+
+// osc_simd_tri()'s wrapping: from 2^23 up every float is a whole number, and
+// the largest float below 1
+#define OSC_SIMD_TRI_WHOLE 8388608.0f
+#define OSC_SIMD_TRI_TOP 0.99999994f
+
+// Redoes all the lanes rather than just the ones out of range: picking lanes,
+// even written as a select, compiles to a branch per lane, and those
+// mispredict on every vector when the input is a random mix of good and bad
+// values. The ones that were in range come out the same.
+static inline void osc_simd_fix_incs(const float *in, double conv,
+  uint32_t *incs)
+{
+  for (int i = 0; i < OSC_SIMD_WIDTH; i++) {
+    incs[i] = osc_phase_wrap(in[i] * conv);
+  }
+}
+
+#if OSC_SIMD_WIDTH == 16
+
+// table lookup and lerp for 16 phases
+static inline __m512 osc_simd_lerp_lanes(const float *tab, int bits,
+  __m512i p)
+{
+  __m512i idx = _mm512_srl_epi32(p, _mm_cvtsi32_si128(32 - bits));
+  __m512 frac = _mm512_mul_ps(
+    _mm512_cvtepi32_ps(_mm512_and_si512(p,
+      _mm512_set1_epi32((1u << (32 - bits)) - 1))),
+    _mm512_set1_ps(1.0f / (float)(1u << (32 - bits))));
+
+  __m512 f1 = _mm512_i32gather_ps(idx, tab, 4);
+  __m512 f2 = _mm512_i32gather_ps(idx, tab + 1, 4);
+  return _mm512_add_ps(f1, _mm512_mul_ps(frac, _mm512_sub_ps(f2, f1)));
+}
+
+static inline void osc_simd_lookup(const float *tab, int bits, __m512i p,
+  float *out)
+{
+  _mm512_storeu_ps(out, osc_simd_lerp_lanes(tab, bits, p));
+}
+
+// phase increments for 16 frequencies
+static inline __m512i osc_simd_incs(const float *in, double conv)
+{
+  __m512d vconv = _mm512_set1_pd(conv);
+  __m512d lim = _mm512_set1_pd(OSC_SIMD_INC_LIMIT);
+  __m256 f_lo = _mm256_loadu_ps(in);
+  __m256 f_hi = _mm256_loadu_ps(in + 8);
+  __m512d x_lo = _mm512_mul_pd(_mm512_cvtps_pd(f_lo), vconv);
+  __m512d x_hi = _mm512_mul_pd(_mm512_cvtps_pd(f_hi), vconv);
+  __m512i inc = _mm512_inserti64x4(_mm512_castsi256_si512(
+    _mm512_cvttpd_epi32(x_lo)), _mm512_cvttpd_epi32(x_hi), 1);
+  // NLT rather than GE so NaN lanes count as out of range too
+  int out = _mm512_cmp_pd_mask(_mm512_abs_pd(x_lo), lim, _CMP_NLT_UQ)
+    | _mm512_cmp_pd_mask(_mm512_abs_pd(x_hi), lim, _CMP_NLT_UQ) << 8;
+
+  if (out) {
+    uint32_t incs[16];
+    osc_simd_fix_incs(in, conv, incs);
+    inc = _mm512_loadu_si512(incs);
+  }
+  return inc;
+}
+
+// v shifted up by k lanes, zeros coming in at the bottom
+#define OSC_SIMD_SHIFT(v, k) _mm512_alignr_epi32(v, _mm512_setzero_si512(), \
+  16 - (k))
+
+// the phases for the next 16 samples, advancing *phase past them
+static inline __m512i osc_simd_step(const float *in, double conv,
+  t_osc_phase *phase)
+{
+  __m512i inc = osc_simd_incs(in, conv);
+  // inclusive prefix sum; alignr moves whole lanes across the 128 bit blocks
+  __m512i s = _mm512_add_epi32(inc, OSC_SIMD_SHIFT(inc, 1));
+  s = _mm512_add_epi32(s, OSC_SIMD_SHIFT(s, 2));
+  s = _mm512_add_epi32(s, OSC_SIMD_SHIFT(s, 4));
+  s = _mm512_add_epi32(s, OSC_SIMD_SHIFT(s, 8));
+
+  __m512i p = _mm512_add_epi32(_mm512_set1_epi32(*phase),
+    _mm512_sub_epi32(s, inc));
+  *phase += (uint32_t)_mm_cvtsi128_si32(_mm512_castsi512_si128(
+    _mm512_alignr_epi32(s, s, 15)));
+  return p;
+}
+
+#undef OSC_SIMD_SHIFT
+
+// osc_phase_unit() for 16 phases
+static inline void osc_simd_unit(__m512i p, float *out)
+{
+  _mm512_storeu_ps(out, _mm512_mul_ps(_mm512_cvtepi32_ps(
+    _mm512_srli_epi32(p, 8)), _mm512_set1_ps(1.0f / 16777216.0f)));
+}
+
+static inline t_osc_phase osc_simd_lerp_vec(const float *tab, int bits,
+  t_osc_phase phase, const float *in, double conv, float *out, int n)
+{
+  for (; n >= 16; n -= 16, in += 16, out += 16) {
+    osc_simd_lookup(tab, bits, osc_simd_step(in, conv, &phase), out);
+  }
+  return phase;
+}
+
+static inline t_osc_phase osc_simd_phasor_vec(t_osc_phase phase,
+  const float *in, double conv, float *out, int n)
+{
+  for (; n >= 16; n -= 16, in += 16, out += 16) {
+    osc_simd_unit(osc_simd_step(in, conv, &phase), out);
+  }
+  return phase;
+}
+
+// 16 oscillators of osc_bank~, see the AVX2 version
+static inline void osc_simd_bank_group(const float *tab, int bits,
+  t_osc_phase *phase, const t_osc_phase *inc, float *amp, const float *damp,
+  float *acc, int n)
+{
+  __m512i p = _mm512_loadu_si512(phase);
+  __m512i vinc = _mm512_loadu_si512(inc);
+  __m512 a = _mm512_loadu_ps(amp);
+  __m512 da = _mm512_loadu_ps(damp);
+
+  for (; n--; acc += 16) {
+    __m512 v = _mm512_mul_ps(a, osc_simd_lerp_lanes(tab, bits, p));
+    _mm512_storeu_ps(acc, _mm512_add_ps(_mm512_loadu_ps(acc), v));
+    p = _mm512_add_epi32(p, vinc);
+    a = _mm512_add_ps(a, da);
+  }
+  _mm512_storeu_si512(phase, p);
+  _mm512_storeu_ps(amp, a);
+}
+
+static inline void osc_simd_bank_sum(const float *acc, float *out, int n)
+{
+  for (; n--; acc += 16) *out++ = _mm512_reduce_add_ps(_mm512_loadu_ps(acc));
+}
+
+// the first 16 multiples of inc
+static inline __m512i osc_simd_offsets(t_osc_phase inc)
+{
+  return _mm512_mullo_epi32(_mm512_set1_epi32(inc), _mm512_setr_epi32(0, 1,
+    2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+static inline t_osc_phase osc_simd_lerp_const_vec(const float *tab, int bits,
+  t_osc_phase phase, t_osc_phase inc, float *out, int n)
+{
+  __m512i off = osc_simd_offsets(inc);
+
+  for (; n >= 16; n -= 16, out += 16) {
+    osc_simd_lookup(tab, bits, _mm512_add_epi32(_mm512_set1_epi32(phase), off),
+      out);
+    phase += 16 * inc;
+  }
+  return phase;
+}
+
+// wave_osc~ crossfading between two tables, see osc_simd_xfade()
+static inline t_osc_phase osc_simd_xfade_vec(const float *a, const float *b,
+  int bits, t_osc_phase phase, const float *in, double conv, t_osc_phase inc,
+  float w, float dw, float *out, int n)
+{
+  __m512i off = osc_simd_offsets(inc);
+  __m512 vw = _mm512_add_ps(_mm512_set1_ps(w), _mm512_mul_ps(
+    _mm512_set1_ps(dw), _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+    12, 13, 14, 15)));
+  __m512 vdw = _mm512_set1_ps(16 * dw);
+
+  for (; n >= 16; n -= 16, out += 16) {
+    __m512i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 16;
+    } else {
+      p = _mm512_add_epi32(_mm512_set1_epi32(phase), off);
+      phase += 16 * inc;
+    }
+    __m512 fa = osc_simd_lerp_lanes(a, bits, p);
+    __m512 fb = osc_simd_lerp_lanes(b, bits, p);
+    _mm512_storeu_ps(out, _mm512_add_ps(fa,
+      _mm512_mul_ps(vw, _mm512_sub_ps(fb, fa))));
+    vw = _mm512_add_ps(vw, vdw);
+  }
+  return phase;
+}
+
+// one tap pair of osc_simd_halfband() for 16 outputs
+static inline __m512 osc_simd_halfband_tap(const float *lo, const float *hi,
+  float tap)
+{
+  return _mm512_mul_ps(_mm512_set1_ps(tap),
+    _mm512_add_ps(_mm512_loadu_ps(lo), _mm512_loadu_ps(hi)));
+}
+
+// osc_simd_halfband() for n a multiple of 16, see the AVX2 version
+static inline void osc_simd_halfband_vec(const float *even, const float *odd,
+  const float *taps, int k, float *out, int n)
+{
+  const __m512 half = _mm512_set1_ps(0.5f);
+
+  for (; n >= 32; n -= 32, even += 32, odd += 32, out += 32) {
+    const float *hi = even + 2 * k - 1;
+    __m512 a0 = _mm512_mul_ps(half, _mm512_loadu_ps(odd + k - 1));
+    __m512 b0 = _mm512_mul_ps(half, _mm512_loadu_ps(odd + k + 15));
+    __m512 a1 = _mm512_setzero_ps(), b1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 1 < k; i += 2) {
+      a0 = _mm512_add_ps(a0, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+      b0 = _mm512_add_ps(b0, osc_simd_halfband_tap(even + i + 16, hi - i + 16,
+        taps[i]));
+      a1 = _mm512_add_ps(a1, osc_simd_halfband_tap(even + i + 1, hi - i - 1,
+        taps[i + 1]));
+      b1 = _mm512_add_ps(b1, osc_simd_halfband_tap(even + i + 17, hi - i + 15,
+        taps[i + 1]));
+    }
+    if (i < k) {
+      a0 = _mm512_add_ps(a0, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+      b0 = _mm512_add_ps(b0, osc_simd_halfband_tap(even + i + 16, hi - i + 16,
+        taps[i]));
+    }
+    _mm512_storeu_ps(out, _mm512_add_ps(a0, a1));
+    _mm512_storeu_ps(out + 16, _mm512_add_ps(b0, b1));
+  }
+  if (n) {
+    const float *hi = even + 2 * k - 1;
+    __m512 a = _mm512_mul_ps(half, _mm512_loadu_ps(odd + k - 1));
+    for (int i = 0; i < k; i++)
+      a = _mm512_add_ps(a, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+    _mm512_storeu_ps(out, a);
+  }
+}
+
+// x - floor(x) for 16 phases in cycles, see osc_simd_tri()
+static inline __m512 osc_simd_wrap_unit(__m512 x)
+{
+  __mmask16 ok = _mm512_cmp_ps_mask(_mm512_abs_ps(x),
+    _mm512_set1_ps(OSC_SIMD_TRI_WHOLE), _CMP_LT_OQ);
+  __m512 f = _mm512_sub_ps(x, _mm512_roundscale_ps(x,
+    _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+  return _mm512_min_ps(_mm512_maskz_mov_ps(ok, f),
+    _mm512_set1_ps(OSC_SIMD_TRI_TOP));
+}
+
+// the triangle for 16 phases in [0, 1), see the AVX2 version
+static inline __m512 osc_simd_tri_lanes(__m512 ph, const float *peak,
+  __m512 vpk, __m512 vrise, __m512 vfall, __m512 vlow, __m512 vrange)
+{
+  const __m512 one = _mm512_set1_ps(1.0f);
+  __m512 v;
+  if (peak) {
+    __m512 p = _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(peak),
+      _mm512_setzero_ps()), one);
+    __mmask16 up = _mm512_cmp_ps_mask(ph, p, _CMP_LT_OQ);
+    v = _mm512_div_ps(_mm512_mask_blend_ps(up, _mm512_sub_ps(one, ph), ph),
+      _mm512_mask_blend_ps(up, _mm512_sub_ps(one, p), p));
+  } else {
+    __mmask16 up = _mm512_cmp_ps_mask(ph, vpk, _CMP_LT_OQ);
+    v = _mm512_mul_ps(_mm512_mask_blend_ps(up, _mm512_sub_ps(one, ph), ph),
+      _mm512_mask_blend_ps(up, vfall, vrise));
+  }
+  return _mm512_add_ps(vlow, _mm512_mul_ps(v, vrange));
+}
+
+// osc_simd_tri() for n a multiple of 16
+static inline void osc_simd_tri_vec(const float *in, const float *peak,
+  float pk, float rise, float fall, float low, float range, float *out, int n)
+{
+  const __m512 vpk = _mm512_set1_ps(pk), vrise = _mm512_set1_ps(rise);
+  const __m512 vfall = _mm512_set1_ps(fall);
+  const __m512 vlow = _mm512_set1_ps(low), vrange = _mm512_set1_ps(range);
+
+  for (; n >= 16; n -= 16, in += 16, out += 16, peak = peak ? peak + 16 : 0) {
+    __m512 ph = osc_simd_wrap_unit(_mm512_loadu_ps(in));
+    _mm512_storeu_ps(out, osc_simd_tri_lanes(ph, peak, vpk, vrise, vfall,
+      vlow, vrange));
+  }
+}
+
+// osc_simd_tri_phasor() for n a multiple of 16
+static inline t_osc_phase osc_simd_tri_phasor_vec(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *peak, float pk,
+  float rise, float fall, float low, float range, float *out, int n)
+{
+  __m512i off = osc_simd_offsets(inc);
+  const __m512 vpk = _mm512_set1_ps(pk), vrise = _mm512_set1_ps(rise);
+  const __m512 vfall = _mm512_set1_ps(fall);
+  const __m512 vlow = _mm512_set1_ps(low), vrange = _mm512_set1_ps(range);
+
+  for (; n >= 16; n -= 16, out += 16, peak = peak ? peak + 16 : 0) {
+    __m512i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 16;
+    } else {
+      p = _mm512_add_epi32(_mm512_set1_epi32(phase), off);
+      phase += 16 * inc;
+    }
+    __m512 ph = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(p, 8)),
+      _mm512_set1_ps(1.0f / 16777216.0f));
+    _mm512_storeu_ps(out, osc_simd_tri_lanes(ph, peak, vpk, vrise, vfall,
+      vlow, vrange));
+  }
+  return phase;
+}
+
+// osc_approx_cos() for 16 phases, see the AVX2 version
+static inline __m512 osc_simd_poly_lanes(__m512i p, const float *c, int nc)
+{
+  __m512i t = _mm512_sub_epi32(_mm512_set1_epi32(0x40000000),
+    _mm512_abs_epi32(p));
+  __m512 x = _mm512_mul_ps(_mm512_cvtepi32_ps(t),
+    _mm512_set1_ps(1.0f / 4294967296.0f));
+  __m512 x2 = _mm512_mul_ps(x, x);
+  __m512 y = _mm512_set1_ps(c[nc - 1]);
+  for (int i = nc - 2; i >= 0; i--)
+    y = _mm512_fmadd_ps(y, x2, _mm512_set1_ps(c[i]));
+  return _mm512_mul_ps(x, y);
+}
+
+// osc_simd_poly() for n a multiple of 16
+static inline t_osc_phase osc_simd_poly_vec(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *c, int nc,
+  float *out, int n)
+{
+  __m512i off = osc_simd_offsets(inc);
+
+  for (; n >= 16; n -= 16, out += 16) {
+    __m512i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 16;
+    } else {
+      p = _mm512_add_epi32(_mm512_set1_epi32(phase), off);
+      phase += 16 * inc;
+    }
+    _mm512_storeu_ps(out, osc_simd_poly_lanes(p, c, nc));
+  }
+  return phase;
+}
+
+// osc_simd_rotor() for whole turns of the 16 lanes: one vector
+static inline void osc_simd_rotor_vec(float *c, float *s, float tc, float ts,
+  float *out, int n)
+{
+  const __m512 vtc = _mm512_set1_ps(tc), vts = _mm512_set1_ps(ts);
+  __m512 c0 = _mm512_loadu_ps(c), s0 = _mm512_loadu_ps(s);
+
+  for (; n >= 16; n -= 16, out += 16) {
+    __m512 t = _mm512_fmsub_ps(c0, vtc, _mm512_mul_ps(s0, vts));
+    _mm512_storeu_ps(out, c0);
+    s0 = _mm512_fmadd_ps(c0, vts, _mm512_mul_ps(s0, vtc));
+    c0 = t;
+  }
+  _mm512_storeu_ps(c, c0);
+  _mm512_storeu_ps(s, s0);
+}
+
+#elif OSC_SIMD_WIDTH == 8
+
+// table lookup and lerp for 8 phases
+static inline __m256 osc_simd_lerp_lanes(const float *tab, int bits,
+  __m256i p)
+{
+  __m256i idx = _mm256_srl_epi32(p, _mm_cvtsi32_si128(32 - bits));
+  __m256 frac = _mm256_mul_ps(
+    _mm256_cvtepi32_ps(_mm256_and_si256(p,
+      _mm256_set1_epi32((1u << (32 - bits)) - 1))),
+    _mm256_set1_ps(1.0f / (float)(1u << (32 - bits))));
+
+  __m256 f1 = _mm256_i32gather_ps(tab, idx, 4);
+  __m256 f2 = _mm256_i32gather_ps(tab + 1, idx, 4);
+  return _mm256_add_ps(f1, _mm256_mul_ps(frac, _mm256_sub_ps(f2, f1)));
+}
+
+static inline void osc_simd_lookup(const float *tab, int bits, __m256i p,
+  float *out)
+{
+  _mm256_storeu_ps(out, osc_simd_lerp_lanes(tab, bits, p));
+}
+
+// phase increments for 8 frequencies
+static inline __m256i osc_simd_incs(const float *in, double conv)
+{
+  __m256d vconv = _mm256_set1_pd(conv);
+  __m256d lim = _mm256_set1_pd(OSC_SIMD_INC_LIMIT);
+  __m256d sign = _mm256_set1_pd(-0.0);
+  __m256 freq = _mm256_loadu_ps(in);
+  __m256d x_lo = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(freq)), vconv);
+  __m256d x_hi = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(freq, 1)), vconv);
+  __m256i inc = _mm256_set_m128i(_mm256_cvttpd_epi32(x_hi),
+    _mm256_cvttpd_epi32(x_lo));
+  // NLT rather than GE so NaN lanes count as out of range too
+  int out = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, x_lo),
+    lim, _CMP_NLT_UQ)) | _mm256_movemask_pd(_mm256_cmp_pd(
+    _mm256_andnot_pd(sign, x_hi), lim, _CMP_NLT_UQ)) << 4;
+
+  if (out) {
+    uint32_t incs[8];
+    osc_simd_fix_incs(in, conv, incs);
+    inc = _mm256_loadu_si256((const __m256i *)incs);
+  }
+  return inc;
+}
+
+// the phases for the next 8 samples (each from before its own increment),
+// advancing *phase past them
+static inline __m256i osc_simd_step(const float *in, double conv,
+  t_osc_phase *phase)
+{
+  __m256i inc = osc_simd_incs(in, conv);
+  // inclusive prefix sum within each 128 bit half, then carry the low half's
+  // total into the high half
+  __m256i s = _mm256_add_epi32(inc, _mm256_slli_si256(inc, 4));
+  s = _mm256_add_epi32(s, _mm256_slli_si256(s, 8));
+  s = _mm256_add_epi32(s, _mm256_permute2x128_si256(
+    _mm256_shuffle_epi32(s, 0xff), s, 0x08));
+
+  __m256i p = _mm256_add_epi32(_mm256_set1_epi32(*phase),
+    _mm256_sub_epi32(s, inc));
+  *phase += (uint32_t)_mm256_extract_epi32(s, 7);
+  return p;
+}
+
+// osc_phase_unit() for 8 phases
+static inline void osc_simd_unit(__m256i p, float *out)
+{
+  _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_cvtepi32_ps(
+    _mm256_srli_epi32(p, 8)), _mm256_set1_ps(1.0f / 16777216.0f)));
+}
+
+static inline t_osc_phase osc_simd_lerp_vec(const float *tab, int bits,
+  t_osc_phase phase, const float *in, double conv, float *out, int n)
+{
+  for (; n >= 8; n -= 8, in += 8, out += 8) {
+    osc_simd_lookup(tab, bits, osc_simd_step(in, conv, &phase), out);
+  }
+  return phase;
+}
+
+static inline t_osc_phase osc_simd_phasor_vec(t_osc_phase phase,
+  const float *in, double conv, float *out, int n)
+{
+  for (; n >= 8; n -= 8, in += 8, out += 8) {
+    osc_simd_unit(osc_simd_step(in, conv, &phase), out);
+  }
+  return phase;
+}
+
+// 8 oscillators of osc_bank~ (one per lane) over n samples. Each lane's
+// table value times its amplitude is added to its own slot in `acc`, which
+// holds 8 floats per sample; the amplitudes step by `damp` every sample.
+// Phases and amplitudes are written back.
+static inline void osc_simd_bank_group(const float *tab, int bits,
+  t_osc_phase *phase, const t_osc_phase *inc, float *amp, const float *damp,
+  float *acc, int n)
+{
+  __m256i p = _mm256_loadu_si256((const __m256i *)phase);
+  __m256i vinc = _mm256_loadu_si256((const __m256i *)inc);
+  __m256 a = _mm256_loadu_ps(amp);
+  __m256 da = _mm256_loadu_ps(damp);
+
+  for (; n--; acc += 8) {
+    __m256 v = _mm256_mul_ps(a, osc_simd_lerp_lanes(tab, bits, p));
+    _mm256_storeu_ps(acc, _mm256_add_ps(_mm256_loadu_ps(acc), v));
+    p = _mm256_add_epi32(p, vinc);
+    a = _mm256_add_ps(a, da);
+  }
+  _mm256_storeu_si256((__m256i *)phase, p);
+  _mm256_storeu_ps(amp, a);
+}
+
+// add up the 8 lanes of each sample of osc_simd_bank_group()'s `acc`
+static inline void osc_simd_bank_sum(const float *acc, float *out, int n)
+{
+  for (; n--; acc += 8) {
+    __m128 v = _mm_add_ps(_mm_loadu_ps(acc), _mm_loadu_ps(acc + 4));
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    *out++ = _mm_cvtss_f32(v);
+  }
+}
+
+static inline t_osc_phase osc_simd_lerp_const_vec(const float *tab, int bits,
+  t_osc_phase phase, t_osc_phase inc, float *out, int n)
+{
+  __m256i off = _mm256_setr_epi32(0, inc, 2 * inc, 3 * inc, 4 * inc, 5 * inc,
+    6 * inc, 7 * inc);
+
+  for (; n >= 8; n -= 8, out += 8) {
+    osc_simd_lookup(tab, bits, _mm256_add_epi32(_mm256_set1_epi32(phase), off),
+      out);
+    phase += 8 * inc;
+  }
+  return phase;
+}
+
+// wave_osc~ crossfading between two tables, see osc_simd_xfade()
+static inline t_osc_phase osc_simd_xfade_vec(const float *a, const float *b,
+  int bits, t_osc_phase phase, const float *in, double conv, t_osc_phase inc,
+  float w, float dw, float *out, int n)
+{
+  __m256i off = _mm256_setr_epi32(0, inc, 2 * inc, 3 * inc, 4 * inc, 5 * inc,
+    6 * inc, 7 * inc);
+  __m256 vw = _mm256_add_ps(_mm256_set1_ps(w), _mm256_mul_ps(
+    _mm256_set1_ps(dw), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)));
+  __m256 vdw = _mm256_set1_ps(8 * dw);
+
+  for (; n >= 8; n -= 8, out += 8) {
+    __m256i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 8;
+    } else {
+      p = _mm256_add_epi32(_mm256_set1_epi32(phase), off);
+      phase += 8 * inc;
+    }
+    __m256 fa = osc_simd_lerp_lanes(a, bits, p);
+    __m256 fb = osc_simd_lerp_lanes(b, bits, p);
+    _mm256_storeu_ps(out, _mm256_add_ps(fa,
+      _mm256_mul_ps(vw, _mm256_sub_ps(fb, fa))));
+    vw = _mm256_add_ps(vw, vdw);
+  }
+  return phase;
+}
+
+// one tap pair of osc_simd_halfband() for 8 outputs
+static inline __m256 osc_simd_halfband_tap(const float *lo, const float *hi,
+  float tap)
+{
+  return _mm256_mul_ps(_mm256_set1_ps(tap),
+    _mm256_add_ps(_mm256_loadu_ps(lo), _mm256_loadu_ps(hi)));
+}
+
+// osc_simd_halfband() for n a multiple of 8. Summing all the taps into one
+// vector is one long chain of dependent adds, so it's two vectors of outputs
+// at a time, each in two halves, for four chains in flight.
+static inline void osc_simd_halfband_vec(const float *even, const float *odd,
+  const float *taps, int k, float *out, int n)
+{
+  const __m256 half = _mm256_set1_ps(0.5f);
+
+  for (; n >= 16; n -= 16, even += 16, odd += 16, out += 16) {
+    const float *hi = even + 2 * k - 1;
+    __m256 a0 = _mm256_mul_ps(half, _mm256_loadu_ps(odd + k - 1));
+    __m256 b0 = _mm256_mul_ps(half, _mm256_loadu_ps(odd + k + 7));
+    __m256 a1 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 1 < k; i += 2) {
+      a0 = _mm256_add_ps(a0, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+      b0 = _mm256_add_ps(b0, osc_simd_halfband_tap(even + i + 8, hi - i + 8,
+        taps[i]));
+      a1 = _mm256_add_ps(a1, osc_simd_halfband_tap(even + i + 1, hi - i - 1,
+        taps[i + 1]));
+      b1 = _mm256_add_ps(b1, osc_simd_halfband_tap(even + i + 9, hi - i + 7,
+        taps[i + 1]));
+    }
+    if (i < k) {
+      a0 = _mm256_add_ps(a0, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+      b0 = _mm256_add_ps(b0, osc_simd_halfband_tap(even + i + 8, hi - i + 8,
+        taps[i]));
+    }
+    _mm256_storeu_ps(out, _mm256_add_ps(a0, a1));
+    _mm256_storeu_ps(out + 8, _mm256_add_ps(b0, b1));
+  }
+  if (n) {
+    const float *hi = even + 2 * k - 1;
+    __m256 a = _mm256_mul_ps(half, _mm256_loadu_ps(odd + k - 1));
+    for (int i = 0; i < k; i++)
+      a = _mm256_add_ps(a, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+    _mm256_storeu_ps(out, a);
+  }
+}
+
+// x - floor(x) for 8 phases in cycles, see osc_simd_tri()
+static inline __m256 osc_simd_wrap_unit(__m256 x)
+{
+  __m256 ok = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x),
+    _mm256_set1_ps(OSC_SIMD_TRI_WHOLE), _CMP_LT_OQ);
+  __m256 f = _mm256_and_ps(ok, _mm256_sub_ps(x, _mm256_floor_ps(x)));
+  return _mm256_min_ps(f, _mm256_set1_ps(OSC_SIMD_TRI_TOP));
+}
+
+// the triangle for 8 phases in [0, 1); peak is NULL for the constant one in
+// vpk, vrise and vfall. Which slope a lane is on is a compare and two blends,
+// and a signal peak costs one division for both slopes: the numerator and
+// the denominator are picked first.
+static inline __m256 osc_simd_tri_lanes(__m256 ph, const float *peak,
+  __m256 vpk, __m256 vrise, __m256 vfall, __m256 vlow, __m256 vrange)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256 v;
+  if (peak) {
+    __m256 p = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(peak),
+      _mm256_setzero_ps()), one);
+    __m256 up = _mm256_cmp_ps(ph, p, _CMP_LT_OQ);
+    v = _mm256_div_ps(_mm256_blendv_ps(_mm256_sub_ps(one, ph), ph, up),
+      _mm256_blendv_ps(_mm256_sub_ps(one, p), p, up));
+  } else {
+    __m256 up = _mm256_cmp_ps(ph, vpk, _CMP_LT_OQ);
+    v = _mm256_mul_ps(_mm256_blendv_ps(_mm256_sub_ps(one, ph), ph, up),
+      _mm256_blendv_ps(vfall, vrise, up));
+  }
+  return _mm256_add_ps(vlow, _mm256_mul_ps(v, vrange));
+}
+
+// osc_simd_tri() for n a multiple of 8
+static inline void osc_simd_tri_vec(const float *in, const float *peak,
+  float pk, float rise, float fall, float low, float range, float *out, int n)
+{
+  const __m256 vpk = _mm256_set1_ps(pk), vrise = _mm256_set1_ps(rise);
+  const __m256 vfall = _mm256_set1_ps(fall);
+  const __m256 vlow = _mm256_set1_ps(low), vrange = _mm256_set1_ps(range);
+
+  for (; n >= 8; n -= 8, in += 8, out += 8, peak = peak ? peak + 8 : 0) {
+    __m256 ph = osc_simd_wrap_unit(_mm256_loadu_ps(in));
+    _mm256_storeu_ps(out, osc_simd_tri_lanes(ph, peak, vpk, vrise, vfall,
+      vlow, vrange));
+  }
+}
+
+// osc_simd_tri_phasor() for n a multiple of 8
+static inline t_osc_phase osc_simd_tri_phasor_vec(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *peak, float pk,
+  float rise, float fall, float low, float range, float *out, int n)
+{
+  __m256i off = _mm256_setr_epi32(0, inc, 2 * inc, 3 * inc, 4 * inc, 5 * inc,
+    6 * inc, 7 * inc);
+  const __m256 vpk = _mm256_set1_ps(pk), vrise = _mm256_set1_ps(rise);
+  const __m256 vfall = _mm256_set1_ps(fall);
+  const __m256 vlow = _mm256_set1_ps(low), vrange = _mm256_set1_ps(range);
+
+  for (; n >= 8; n -= 8, out += 8, peak = peak ? peak + 8 : 0) {
+    __m256i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 8;
+    } else {
+      p = _mm256_add_epi32(_mm256_set1_epi32(phase), off);
+      phase += 8 * inc;
+    }
+    __m256 ph = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(p, 8)),
+      _mm256_set1_ps(1.0f / 16777216.0f));
+    _mm256_storeu_ps(out, osc_simd_tri_lanes(ph, peak, vpk, vrise, vfall,
+      vlow, vrange));
+  }
+  return phase;
+}
+
+// osc_approx_cos() for 8 phases: the fold to a quarter cycle is an integer
+// abs and subtract, and the polynomial (with nc coefficients c) is Horner's
+// rule in FMAs, so the result can differ from the scalar one in the last bit.
+static inline __m256 osc_simd_poly_lanes(__m256i p, const float *c, int nc)
+{
+  __m256i t = _mm256_sub_epi32(_mm256_set1_epi32(0x40000000),
+    _mm256_abs_epi32(p));
+  __m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(t),
+    _mm256_set1_ps(1.0f / 4294967296.0f));
+  __m256 x2 = _mm256_mul_ps(x, x);
+  __m256 y = _mm256_set1_ps(c[nc - 1]);
+  for (int i = nc - 2; i >= 0; i--)
+    y = _mm256_fmadd_ps(y, x2, _mm256_set1_ps(c[i]));
+  return _mm256_mul_ps(x, y);
+}
+
+// osc_simd_poly() for n a multiple of 8
+static inline t_osc_phase osc_simd_poly_vec(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *c, int nc,
+  float *out, int n)
+{
+  __m256i off = _mm256_setr_epi32(0, inc, 2 * inc, 3 * inc, 4 * inc, 5 * inc,
+    6 * inc, 7 * inc);
+
+  for (; n >= 8; n -= 8, out += 8) {
+    __m256i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 8;
+    } else {
+      p = _mm256_add_epi32(_mm256_set1_epi32(phase), off);
+      phase += 8 * inc;
+    }
+    _mm256_storeu_ps(out, osc_simd_poly_lanes(p, c, nc));
+  }
+  return phase;
+}
+
+// osc_simd_rotor() for whole turns of the 16 lanes: two vectors, which are
+// two chains of multiply-adds in flight
+static inline void osc_simd_rotor_vec(float *c, float *s, float tc, float ts,
+  float *out, int n)
+{
+  const __m256 vtc = _mm256_set1_ps(tc), vts = _mm256_set1_ps(ts);
+  __m256 c0 = _mm256_loadu_ps(c), s0 = _mm256_loadu_ps(s);
+  __m256 c1 = _mm256_loadu_ps(c + 8), s1 = _mm256_loadu_ps(s + 8);
+
+  for (; n >= 16; n -= 16, out += 16) {
+    __m256 t0 = _mm256_fmsub_ps(c0, vtc, _mm256_mul_ps(s0, vts));
+    __m256 t1 = _mm256_fmsub_ps(c1, vtc, _mm256_mul_ps(s1, vts));
+    _mm256_storeu_ps(out, c0);
+    _mm256_storeu_ps(out + 8, c1);
+    s0 = _mm256_fmadd_ps(c0, vts, _mm256_mul_ps(s0, vtc));
+    s1 = _mm256_fmadd_ps(c1, vts, _mm256_mul_ps(s1, vtc));
+    c0 = t0;
+    c1 = t1;
+  }
+  _mm256_storeu_ps(c, c0);
+  _mm256_storeu_ps(c + 8, c1);
+  _mm256_storeu_ps(s, s0);
+  _mm256_storeu_ps(s + 8, s1);
+}
+
+#else // OSC_SIMD_WIDTH == 4
+
+// table lookup and lerp for 4 phases
+static inline __m128 osc_simd_lerp_lanes(const float *tab, int bits,
+  __m128i p)
+{
+  __m128i idx = _mm_srl_epi32(p, _mm_cvtsi32_si128(32 - bits));
+  __m128 frac = _mm_mul_ps(
+    _mm_cvtepi32_ps(_mm_and_si128(p, _mm_set1_epi32((1u << (32 - bits)) - 1))),
+    _mm_set1_ps(1.0f / (float)(1u << (32 - bits))));
+
+  // no gather before AVX2
+  int i[4];
+  _mm_storeu_si128((__m128i *)i, idx);
+  __m128 f1 = _mm_setr_ps(tab[i[0]], tab[i[1]], tab[i[2]], tab[i[3]]);
+  __m128 f2 = _mm_setr_ps(tab[i[0] + 1], tab[i[1] + 1], tab[i[2] + 1], tab[i[3] + 1]);
+  return _mm_add_ps(f1, _mm_mul_ps(frac, _mm_sub_ps(f2, f1)));
+}
+
+static inline void osc_simd_lookup(const float *tab, int bits, __m128i p,
+  float *out)
+{
+  _mm_storeu_ps(out, osc_simd_lerp_lanes(tab, bits, p));
+}
+
+// phase increments for 4 frequencies
+static inline __m128i osc_simd_incs(const float *in, double conv)
+{
+  __m128d vconv = _mm_set1_pd(conv);
+  __m128d lim = _mm_set1_pd(OSC_SIMD_INC_LIMIT);
+  __m128d sign = _mm_set1_pd(-0.0);
+  __m128 freq = _mm_loadu_ps(in);
+  __m128d x_lo = _mm_mul_pd(_mm_cvtps_pd(freq), vconv);
+  __m128d x_hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(freq, freq)), vconv);
+  __m128i inc = _mm_unpacklo_epi64(_mm_cvttpd_epi32(x_lo),
+    _mm_cvttpd_epi32(x_hi));
+  int out = _mm_movemask_pd(_mm_cmpnlt_pd(_mm_andnot_pd(sign, x_lo), lim))
+    | _mm_movemask_pd(_mm_cmpnlt_pd(_mm_andnot_pd(sign, x_hi), lim)) << 2;
+
+  if (out) {
+    uint32_t incs[4];
+    osc_simd_fix_incs(in, conv, incs);
+    inc = _mm_loadu_si128((const __m128i *)incs);
+  }
+  return inc;
+}
+
+// the phases for the next 4 samples, advancing *phase past them
+static inline __m128i osc_simd_step(const float *in, double conv,
+  t_osc_phase *phase)
+{
+  __m128i inc = osc_simd_incs(in, conv);
+  // inclusive prefix sum
+  __m128i s = _mm_add_epi32(inc, _mm_slli_si128(inc, 4));
+  s = _mm_add_epi32(s, _mm_slli_si128(s, 8));
+
+  __m128i p = _mm_add_epi32(_mm_set1_epi32(*phase), _mm_sub_epi32(s, inc));
+  *phase += (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(s, 0xff));
+  return p;
+}
+
+// osc_phase_unit() for 4 phases
+static inline void osc_simd_unit(__m128i p, float *out)
+{
+  _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(p, 8)),
+    _mm_set1_ps(1.0f / 16777216.0f)));
+}
+
+static inline t_osc_phase osc_simd_lerp_vec(const float *tab, int bits,
+  t_osc_phase phase, const float *in, double conv, float *out, int n)
+{
+  for (; n >= 4; n -= 4, in += 4, out += 4) {
+    osc_simd_lookup(tab, bits, osc_simd_step(in, conv, &phase), out);
+  }
+  return phase;
+}
+
+static inline t_osc_phase osc_simd_phasor_vec(t_osc_phase phase,
+  const float *in, double conv, float *out, int n)
+{
+  for (; n >= 4; n -= 4, in += 4, out += 4) {
+    osc_simd_unit(osc_simd_step(in, conv, &phase), out);
+  }
+  return phase;
+}
+
+// 4 oscillators of osc_bank~, see the AVX2 version
+static inline void osc_simd_bank_group(const float *tab, int bits,
+  t_osc_phase *phase, const t_osc_phase *inc, float *amp, const float *damp,
+  float *acc, int n)
+{
+  __m128i p = _mm_loadu_si128((const __m128i *)phase);
+  __m128i vinc = _mm_loadu_si128((const __m128i *)inc);
+  __m128 a = _mm_loadu_ps(amp);
+  __m128 da = _mm_loadu_ps(damp);
+
+  for (; n--; acc += 4) {
+    __m128 v = _mm_mul_ps(a, osc_simd_lerp_lanes(tab, bits, p));
+    _mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), v));
+    p = _mm_add_epi32(p, vinc);
+    a = _mm_add_ps(a, da);
+  }
+  _mm_storeu_si128((__m128i *)phase, p);
+  _mm_storeu_ps(amp, a);
+}
+
+static inline void osc_simd_bank_sum(const float *acc, float *out, int n)
+{
+  for (; n--; acc += 4) {
+    __m128 v = _mm_loadu_ps(acc);
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    *out++ = _mm_cvtss_f32(v);
+  }
+}
+
+static inline t_osc_phase osc_simd_lerp_const_vec(const float *tab, int bits,
+  t_osc_phase phase, t_osc_phase inc, float *out, int n)
+{
+  __m128i off = _mm_setr_epi32(0, inc, 2 * inc, 3 * inc);
+
+  for (; n >= 4; n -= 4, out += 4) {
+    osc_simd_lookup(tab, bits, _mm_add_epi32(_mm_set1_epi32(phase), off), out);
+    phase += 4 * inc;
+  }
+  return phase;
+}
+
+// wave_osc~ crossfading between two tables, see osc_simd_xfade()
+static inline t_osc_phase osc_simd_xfade_vec(const float *a, const float *b,
+  int bits, t_osc_phase phase, const float *in, double conv, t_osc_phase inc,
+  float w, float dw, float *out, int n)
+{
+  __m128i off = _mm_setr_epi32(0, inc, 2 * inc, 3 * inc);
+  __m128 vw = _mm_add_ps(_mm_set1_ps(w), _mm_mul_ps(_mm_set1_ps(dw),
+    _mm_setr_ps(0, 1, 2, 3)));
+  __m128 vdw = _mm_set1_ps(4 * dw);
+
+  for (; n >= 4; n -= 4, out += 4) {
+    __m128i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 4;
+    } else {
+      p = _mm_add_epi32(_mm_set1_epi32(phase), off);
+      phase += 4 * inc;
+    }
+    __m128 fa = osc_simd_lerp_lanes(a, bits, p);
+    __m128 fb = osc_simd_lerp_lanes(b, bits, p);
+    _mm_storeu_ps(out, _mm_add_ps(fa, _mm_mul_ps(vw, _mm_sub_ps(fb, fa))));
+    vw = _mm_add_ps(vw, vdw);
+  }
+  return phase;
+}
+
+// one tap pair of osc_simd_halfband() for 4 outputs
+static inline __m128 osc_simd_halfband_tap(const float *lo, const float *hi,
+  float tap)
+{
+  return _mm_mul_ps(_mm_set1_ps(tap),
+    _mm_add_ps(_mm_loadu_ps(lo), _mm_loadu_ps(hi)));
+}
+
+// osc_simd_halfband() for n a multiple of 4, see the AVX2 version
+static inline void osc_simd_halfband_vec(const float *even, const float *odd,
+  const float *taps, int k, float *out, int n)
+{
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  for (; n >= 8; n -= 8, even += 8, odd += 8, out += 8) {
+    const float *hi = even + 2 * k - 1;
+    __m128 a0 = _mm_mul_ps(half, _mm_loadu_ps(odd + k - 1));
+    __m128 b0 = _mm_mul_ps(half, _mm_loadu_ps(odd + k + 3));
+    __m128 a1 = _mm_setzero_ps(), b1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 1 < k; i += 2) {
+      a0 = _mm_add_ps(a0, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+      b0 = _mm_add_ps(b0, osc_simd_halfband_tap(even + i + 4, hi - i + 4,
+        taps[i]));
+      a1 = _mm_add_ps(a1, osc_simd_halfband_tap(even + i + 1, hi - i - 1,
+        taps[i + 1]));
+      b1 = _mm_add_ps(b1, osc_simd_halfband_tap(even + i + 5, hi - i + 3,
+        taps[i + 1]));
+    }
+    if (i < k) {
+      a0 = _mm_add_ps(a0, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+      b0 = _mm_add_ps(b0, osc_simd_halfband_tap(even + i + 4, hi - i + 4,
+        taps[i]));
+    }
+    _mm_storeu_ps(out, _mm_add_ps(a0, a1));
+    _mm_storeu_ps(out + 4, _mm_add_ps(b0, b1));
+  }
+  if (n) {
+    const float *hi = even + 2 * k - 1;
+    __m128 a = _mm_mul_ps(half, _mm_loadu_ps(odd + k - 1));
+    for (int i = 0; i < k; i++)
+      a = _mm_add_ps(a, osc_simd_halfband_tap(even + i, hi - i, taps[i]));
+    _mm_storeu_ps(out, a);
+  }
+}
+
+// x - floor(x) for 4 phases in cycles, see osc_simd_tri()
+static inline __m128 osc_simd_wrap_unit(__m128 x)
+{
+  __m128 ok = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x),
+    _mm_set1_ps(OSC_SIMD_TRI_WHOLE));
+  // no floor before SSE4.1: truncate, and take one off the negative ones
+  // that had a fraction. Lanes too big for that are masked out by `ok`.
+  __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+  return _mm_min_ps(_mm_and_ps(ok, _mm_sub_ps(x, t)),
+    _mm_set1_ps(OSC_SIMD_TRI_TOP));
+}
+
+// a where m is set, b elsewhere
+static inline __m128 osc_simd_select(__m128 m, __m128 a, __m128 b)
+{
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+// the triangle for 4 phases in [0, 1), see the AVX2 version
+static inline __m128 osc_simd_tri_lanes(__m128 ph, const float *peak,
+  __m128 vpk, __m128 vrise, __m128 vfall, __m128 vlow, __m128 vrange)
+{
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128 v;
+  if (peak) {
+    __m128 p = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(peak), _mm_setzero_ps()),
+      one);
+    __m128 up = _mm_cmplt_ps(ph, p);
+    v = _mm_div_ps(osc_simd_select(up, ph, _mm_sub_ps(one, ph)),
+      osc_simd_select(up, p, _mm_sub_ps(one, p)));
+  } else {
+    __m128 up = _mm_cmplt_ps(ph, vpk);
+    v = _mm_mul_ps(osc_simd_select(up, ph, _mm_sub_ps(one, ph)),
+      osc_simd_select(up, vrise, vfall));
+  }
+  return _mm_add_ps(vlow, _mm_mul_ps(v, vrange));
+}
+
+// osc_simd_tri() for n a multiple of 4
+static inline void osc_simd_tri_vec(const float *in, const float *peak,
+  float pk, float rise, float fall, float low, float range, float *out, int n)
+{
+  const __m128 vpk = _mm_set1_ps(pk), vrise = _mm_set1_ps(rise);
+  const __m128 vfall = _mm_set1_ps(fall);
+  const __m128 vlow = _mm_set1_ps(low), vrange = _mm_set1_ps(range);
+
+  for (; n >= 4; n -= 4, in += 4, out += 4, peak = peak ? peak + 4 : 0) {
+    __m128 ph = osc_simd_wrap_unit(_mm_loadu_ps(in));
+    _mm_storeu_ps(out, osc_simd_tri_lanes(ph, peak, vpk, vrise, vfall, vlow,
+      vrange));
+  }
+}
+
+// osc_simd_tri_phasor() for n a multiple of 4
+static inline t_osc_phase osc_simd_tri_phasor_vec(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *peak, float pk,
+  float rise, float fall, float low, float range, float *out, int n)
+{
+  __m128i off = _mm_setr_epi32(0, inc, 2 * inc, 3 * inc);
+  const __m128 vpk = _mm_set1_ps(pk), vrise = _mm_set1_ps(rise);
+  const __m128 vfall = _mm_set1_ps(fall);
+  const __m128 vlow = _mm_set1_ps(low), vrange = _mm_set1_ps(range);
+
+  for (; n >= 4; n -= 4, out += 4, peak = peak ? peak + 4 : 0) {
+    __m128i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 4;
+    } else {
+      p = _mm_add_epi32(_mm_set1_epi32(phase), off);
+      phase += 4 * inc;
+    }
+    __m128 ph = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(p, 8)),
+      _mm_set1_ps(1.0f / 16777216.0f));
+    _mm_storeu_ps(out, osc_simd_tri_lanes(ph, peak, vpk, vrise, vfall, vlow,
+      vrange));
+  }
+  return phase;
+}
+
+// osc_approx_cos() for 4 phases, see the AVX2 version; SSE2 has no integer
+// abs, so it's the sign mask's xor and subtract, and no FMA
+static inline __m128 osc_simd_poly_lanes(__m128i p, const float *c, int nc)
+{
+  __m128i sign = _mm_srai_epi32(p, 31);
+  __m128i t = _mm_sub_epi32(_mm_set1_epi32(0x40000000),
+    _mm_sub_epi32(_mm_xor_si128(p, sign), sign));
+  __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(t),
+    _mm_set1_ps(1.0f / 4294967296.0f));
+  __m128 x2 = _mm_mul_ps(x, x);
+  __m128 y = _mm_set1_ps(c[nc - 1]);
+  for (int i = nc - 2; i >= 0; i--)
+    y = _mm_add_ps(_mm_mul_ps(y, x2), _mm_set1_ps(c[i]));
+  return _mm_mul_ps(x, y);
+}
+
+// osc_simd_poly() for n a multiple of 4
+static inline t_osc_phase osc_simd_poly_vec(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *c, int nc,
+  float *out, int n)
+{
+  __m128i off = _mm_setr_epi32(0, inc, 2 * inc, 3 * inc);
+
+  for (; n >= 4; n -= 4, out += 4) {
+    __m128i p;
+    if (in) {
+      p = osc_simd_step(in, conv, &phase);
+      in += 4;
+    } else {
+      p = _mm_add_epi32(_mm_set1_epi32(phase), off);
+      phase += 4 * inc;
+    }
+    _mm_storeu_ps(out, osc_simd_poly_lanes(p, c, nc));
+  }
+  return phase;
+}
+
+// osc_simd_rotor() for whole turns of the 16 lanes: four vectors, without
+// FMA
+static inline void osc_simd_rotor_vec(float *c, float *s, float tc, float ts,
+  float *out, int n)
+{
+  const __m128 vtc = _mm_set1_ps(tc), vts = _mm_set1_ps(ts);
+  __m128 vc[4], vs[4];
+
+  for (int k = 0; k < 4; k++) {
+    vc[k] = _mm_loadu_ps(c + 4 * k);
+    vs[k] = _mm_loadu_ps(s + 4 * k);
+  }
+  for (; n >= 16; n -= 16, out += 16) {
+    for (int k = 0; k < 4; k++) {
+      __m128 t = _mm_sub_ps(_mm_mul_ps(vc[k], vtc), _mm_mul_ps(vs[k], vts));
+      _mm_storeu_ps(out + 4 * k, vc[k]);
+      vs[k] = _mm_add_ps(_mm_mul_ps(vc[k], vts), _mm_mul_ps(vs[k], vtc));
+      vc[k] = t;
+    }
+  }
+  for (int k = 0; k < 4; k++) {
+    _mm_storeu_ps(c + 4 * k, vc[k]);
+    _mm_storeu_ps(s + 4 * k, vs[k]);
+  }
+}
+
+#endif
+
+// leftovers, for block sizes that aren't a multiple of the vector width
+static inline t_osc_phase osc_simd_lerp_tail(const float *tab, int bits,
+  t_osc_phase phase, const float *in, double conv, t_osc_phase inc,
+  float *out, int n)
+{
+  while (n--) {
+    uint32_t idx = osc_phase_index(phase, bits);
+    float frac = osc_phase_frac(phase, bits);
+    *out++ = tab[idx] + frac * (tab[idx + 1] - tab[idx]);
+    phase += in ? osc_phase_wrap(*in++ * conv) : inc;
+  }
+  return phase;
+}
+
+// linear-interpolating table read of n samples, with the frequency in `in`
+// and conv = osc_phase_conv(sr); returns the new phase
+static inline t_osc_phase osc_simd_lerp(const float *tab, int bits,
+  t_osc_phase phase, const float *in, double conv, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  phase = osc_simd_lerp_vec(tab, bits, phase, in, conv, out, head);
+  return osc_simd_lerp_tail(tab, bits, phase, in + head, conv, 0, out + head,
+    n - head);
+}
+
+// same, for a frequency that's constant over the block: `inc` is added to the
+// phase every sample
+static inline t_osc_phase osc_simd_lerp_const(const float *tab, int bits,
+  t_osc_phase phase, t_osc_phase inc, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  phase = osc_simd_lerp_const_vec(tab, bits, phase, inc, out, head);
+  return osc_simd_lerp_tail(tab, bits, phase, NULL, 0, inc, out + head,
+    n - head);
+}
+
+// a + w * (b - a) of two tables of the same size read at the same phase, with
+// the weight w going up by dw every sample (wave_osc~ fading from one mipmap
+// level to the next). The frequency is in `in`, or if that's NULL `inc` is
+// added every sample.
+static inline t_osc_phase osc_simd_xfade(const float *a, const float *b,
+  int bits, t_osc_phase phase, const float *in, double conv, t_osc_phase inc,
+  float w, float dw, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  phase = osc_simd_xfade_vec(a, b, bits, phase, in, conv, inc, w, dw, out,
+    head);
+  w += head * dw;
+  for (in = in ? in + head : NULL, out += head, n -= head; n--; w += dw) {
+    uint32_t idx = osc_phase_index(phase, bits);
+    float frac = osc_phase_frac(phase, bits);
+    float fa = a[idx] + frac * (a[idx + 1] - a[idx]);
+    float fb = b[idx] + frac * (b[idx + 1] - b[idx]);
+    *out++ = fa + w * (fb - fa);
+    phase += in ? osc_phase_wrap(*in++ * conv) : inc;
+  }
+  return phase;
+}
+
+// n outputs of a halfband lowpass decimating by 2 (see oversample.c), from
+// the even and the odd input samples split apart, each starting with 2k - 1
+// samples of history: out[m] = 0.5 * odd[m + k - 1] + the sum over i < k of
+// taps[i] * (even[m + i] + even[m + 2k - 1 - i]). All unit-stride reads, so
+// the lanes are consecutive outputs.
+static inline void osc_simd_halfband(const float *even, const float *odd,
+  const float *taps, int k, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  osc_simd_halfband_vec(even, odd, taps, k, out, head);
+  for (int m = head; m < n; m++) {
+    float acc = 0.5f * odd[m + k - 1];
+    for (int i = 0; i < k; i++)
+      acc += taps[i] * (even[m + i] + even[m + 2 * k - 1 - i]);
+    out[m] = acc;
+  }
+}
+
+// a phasor: the phase itself, as osc_phase_unit() values in [0, 1)
+static inline t_osc_phase osc_simd_phasor(t_osc_phase phase, const float *in,
+  double conv, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  phase = osc_simd_phasor_vec(phase, in, conv, out, head);
+  for (in += head, out += head, n -= head; n--; ) {
+    *out++ = osc_phase_unit(phase);
+    phase += osc_phase_wrap(*in++ * conv);
+  }
+  return phase;
+}
+
+// osc_simd_wrap_unit() for one phase
+static inline float osc_simd_wrap_unit1(float x)
+{
+  float f = fabsf(x) < OSC_SIMD_TRI_WHOLE ? x - floorf(x) : 0.0f;
+  return f < OSC_SIMD_TRI_TOP ? f : OSC_SIMD_TRI_TOP;
+}
+
+// osc_simd_tri_lanes() for one phase, peak[0] being its peak
+static inline float osc_simd_tri1(float ph, const float *peak, float pk,
+  float rise, float fall, float low, float range)
+{
+  float v;
+  if (peak) {
+    float p = *peak > 0.0f ? *peak : 0.0f;
+    p = p < 1.0f ? p : 1.0f;
+    v = ph < p ? ph / p : (1.0f - ph) / (1.0f - p);
+  } else {
+    v = ph < pk ? ph * rise : (1.0f - ph) * fall;
+  }
+  return low + v * range;
+}
+
+// the slopes for a constant peak pk, which is clamped to [0, 1]
+static inline void osc_simd_tri_slopes(float *pk, float *rise, float *fall)
+{
+  float p = *pk > 0.0f ? *pk : 0.0f;
+  p = p < 1.0f ? p : 1.0f;
+  *rise = p > 0.0f ? 1.0f / p : 0.0f;
+  *fall = p < 1.0f ? 1.0f / (1.0f - p) : 0.0f;
+  *pk = p;
+}
+
+// triangle~'s shape, without branches: n phases in cycles wrapped into
+// [0, 1), going from 0 up to 1 at the peak and back down to 0 at the end of
+// the cycle, as low + that * range. The peak is per sample in `peak`, clamped
+// to [0, 1], or if that's NULL `pk` for the whole block; then the slopes are
+// two multiplications worked out here once.
+//
+// The wrapping is x - floor(x) in float, where the scalar routine goes
+// through the fixed-point phase, which keeps 24 bits: so the output can
+// differ from it by 2^-24 of a cycle's worth of slope when the input has
+// finer bits than that. Inputs that are NaN or too big for a fraction wrap to
+// 0.
+static inline void osc_simd_tri(const float *in, const float *peak, float pk,
+  float low, float range, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  float rise, fall;
+  osc_simd_tri_slopes(&pk, &rise, &fall);
+
+  osc_simd_tri_vec(in, peak, pk, rise, fall, low, range, out, head);
+  for (int i = head; i < n; i++) {
+    out[i] = osc_simd_tri1(osc_simd_wrap_unit1(in[i]), peak ? peak + i : NULL,
+      pk, rise, fall, low, range);
+  }
+}
+
+// the same triangle of a phase accumulator (tri_phase~), like
+// osc_simd_phasor() feeding osc_simd_tri() without the wrapping: the
+// frequency is in `in`, or if that's NULL `inc` is added every sample.
+// Returns the new phase.
+static inline t_osc_phase osc_simd_tri_phasor(t_osc_phase phase,
+  const float *in, double conv, t_osc_phase inc, const float *peak, float pk,
+  float low, float range, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  float rise, fall;
+  osc_simd_tri_slopes(&pk, &rise, &fall);
+
+  phase = osc_simd_tri_phasor_vec(phase, in, conv, inc, peak, pk, rise, fall,
+    low, range, out, head);
+  for (int i = head; i < n; i++) {
+    out[i] = osc_simd_tri1(osc_phase_unit(phase), peak ? peak + i : NULL, pk,
+      rise, fall, low, range);
+    phase += in ? osc_phase_wrap(in[i] * conv) : inc;
+  }
+  return phase;
+}
+
+// modern_osc~'s `approx` mode: cos() of a phase accumulator by a polynomial
+// with the nc coefficients c (see approx.h) instead of a table. The frequency
+// is in `in`, or if that's NULL `inc` is added every sample. Returns the new
+// phase.
+static inline t_osc_phase osc_simd_poly(t_osc_phase phase, const float *in,
+  double conv, t_osc_phase inc, const float *c, int nc, float *out, int n)
+{
+  int head = n & ~(OSC_SIMD_WIDTH - 1);
+  phase = osc_simd_poly_vec(phase, in, conv, inc, c, nc, out, head);
+  for (int i = head; i < n; i++) {
+    out[i] = osc_approx_cos(phase, c, nc);
+    phase += in ? osc_phase_wrap(in[i] * conv) : inc;
+  }
+  return phase;
+}
+
+// the rotor's lanes (see rotor.h), 16 of them in c and s, turned by (tc, ts)
+// every 16 samples: n samples of their cosines, one after the other. A
+// shorter last turn is the first lanes of the next one.
+static inline void osc_simd_rotor(float *c, float *s, float tc, float ts,
+  float *out, int n)
+{
+  int head = n & ~(OSC_ROTOR_LANES - 1);
+  osc_simd_rotor_vec(c, s, tc, ts, out, head);
+  for (int j = 0; j < n - head; j++) out[head + j] = c[j];
+}
+
+#endif // OSC_SIMD_WIDTH
+
+#endif // OSC_SIMD_H
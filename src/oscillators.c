@@ -0,0 +1,39 @@
+// Setup for the single-binary build (`make multi`): every class and the code
+// they share go into one oscillators.pd_linux (or .dll, .pd_darwin), and
+// [declare -lib oscillators], or oscillators in Pd's startup libraries, loads
+// them all at once. That's one file to open and relocate instead of one per
+// class plus liboscillators, and one copy of the shared code in memory.
+//
+// The classes are the same either way; each still has its own *_setup() for
+// the build with one binary per class.
+
+#include "m_pd.h"
+
+void triangle_tilde_setup(void);
+void simple_osc_tilde_setup(void);
+void cubic_osc_tilde_setup(void);
+void fold_osc_tilde_setup(void);
+void simple_phasor_tilde_setup(void);
+void tri_phase_tilde_setup(void);
+void tabfudge_osc_tilde_setup(void);
+void modern_osc_tilde_setup(void);
+void osc_bank_tilde_setup(void);
+void wave_osc_tilde_setup(void);
+void fm_op_tilde_setup(void);
+void additive_tilde_setup(void);
+
+void oscillators_setup(void)
+{
+  triangle_tilde_setup();
+  simple_osc_tilde_setup();
+  cubic_osc_tilde_setup();
+  fold_osc_tilde_setup();
+  simple_phasor_tilde_setup();
+  tri_phase_tilde_setup();
+  tabfudge_osc_tilde_setup();
+  modern_osc_tilde_setup();
+  osc_bank_tilde_setup();
+  wave_osc_tilde_setup();
+  fm_op_tilde_setup();
+  additive_tilde_setup();
+}
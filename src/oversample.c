@@ -0,0 +1,135 @@
+// See oversample.h
+
+#include "m_pd.h"
+#include "oversample.h"
+#include <string.h>
+
+// The taps are Kaiser-windowed sinc halfbands, normalised for a DC gain of 1.
+// Only the first half of the taps on the even samples is listed: the other
+// half mirrors it, the middle tap is 0.5 and the rest are 0.
+//
+// The last stage (2x to 1x) needs to be flat to 0.2 of its input rate and
+// stop from 0.3: 51 taps, -78 dB.
+static const float osc_halfband_last[13] = {
+  3.40292572e-05f, -0.000192569074f, 0.000575437851f, -0.0013417321f,
+  0.00270675588f, -0.00495228684f, 0.00845080148f, -0.0137302671f,
+  0.021650767f, -0.0339205675f, 0.0548958629f, -0.100625746f, 0.316449523f
+};
+
+// The ones before it only have to keep 0.1 of their input rate flat, since
+// the next stage takes out everything else, and what they let alias lands
+// above 0.4 of the output rate at worst: 19 taps, -82 dB.
+static const float osc_halfband_early[5] = {
+  6.25742541e-05f, -0.00265855296f, 0.0173063371f, -0.0680584162f,
+  0.303348064f
+};
+
+int osc_oversample_factor(t_float f)
+{
+  return (f == 1 || f == 2 || f == 4 || f == 8) ? (int)f : 0;
+}
+
+void osc_oversample_init(t_osc_oversample *os)
+{
+  os->kernels = osc_kernels_best();
+  os->factor = 1;
+  os->n = 0;
+  os->buf = NULL;
+  for (int i = 0; i < OSC_OVERSAMPLE_STAGES; i++) {
+    t_osc_halfband *h = &os->stage[i];
+    h->taps = i ? osc_halfband_early : osc_halfband_last;
+    h->k = i ? (int)(sizeof(osc_halfband_early) / sizeof(float))
+             : (int)(sizeof(osc_halfband_last) / sizeof(float));
+    h->even = h->odd = NULL;
+  }
+}
+
+// how many samples each of a stage's even and odd buffers holds
+static int osc_halfband_size(const t_osc_halfband *h, int nout)
+{
+  return 2 * h->k - 1 + nout;
+}
+
+void osc_oversample_free(t_osc_oversample *os)
+{
+  int stages = 0;
+  while ((1 << stages) < os->factor) stages++;
+
+  if (os->buf) freebytes(os->buf, os->n * os->factor * sizeof(t_sample));
+  for (int i = 0; i < stages; i++) {
+    t_osc_halfband *h = &os->stage[i];
+    int size = osc_halfband_size(h, os->n << i) * sizeof(t_sample);
+    if (h->even) freebytes(h->even, size);
+    if (h->odd) freebytes(h->odd, size);
+    h->even = h->odd = NULL;
+  }
+  os->buf = NULL;
+  os->factor = 1;
+}
+
+int osc_oversample_set(t_osc_oversample *os, int factor, int n)
+{
+  int stages = 0, ok;
+
+  if (factor == os->factor && n == os->n) return 1;
+  osc_oversample_free(os);
+  os->n = n;
+  if (factor <= 1 || n <= 0) return 1;
+
+  while ((1 << stages) < factor) stages++;
+  os->factor = factor;
+  // getbytes() zeroes, so the filters start from silence
+  os->buf = (t_sample *)getbytes(n * factor * sizeof(t_sample));
+  ok = os->buf != NULL;
+  for (int i = 0; i < stages; i++) {
+    t_osc_halfband *h = &os->stage[i];
+    int size = osc_halfband_size(h, n << i) * sizeof(t_sample);
+    h->even = (t_sample *)getbytes(size);
+    h->odd = (t_sample *)getbytes(size);
+    ok = ok && h->even && h->odd;
+  }
+  if (!ok) osc_oversample_free(os);
+  return ok;
+}
+
+// for the scalar kernel set, see osc_simd_halfband()
+static void osc_halfband_filter(const t_sample *even, const t_sample *odd,
+  const float *taps, int k, t_sample *out, int n)
+{
+  for (int m = 0; m < n; m++) {
+    t_sample acc = 0.5f * odd[m + k - 1];
+    for (int i = 0; i < k; i++)
+      acc += taps[i] * (even[m + i] + even[m + 2 * k - 1 - i]);
+    out[m] = acc;
+  }
+}
+
+// 2n samples of `in` to n of `out`, which can be the same buffer
+static void osc_halfband_run(t_osc_halfband *h, const t_osc_kernels *k,
+  const t_sample *in, t_sample *out, int n)
+{
+  int hist = 2 * h->k - 1;
+  t_sample *even = h->even, *odd = h->odd;
+
+  for (int i = 0; i < n; i++) {
+    even[hist + i] = in[2 * i];
+    odd[hist + i] = in[2 * i + 1];
+  }
+  if (k->width) k->halfband(even, odd, h->taps, h->k, out, n);
+  else osc_halfband_filter(even, odd, h->taps, h->k, out, n);
+  // keep the end for next time
+  memmove(even, even + n, hist * sizeof(t_sample));
+  memmove(odd, odd + n, hist * sizeof(t_sample));
+}
+
+void osc_oversample_decimate(t_osc_oversample *os, t_sample *out)
+{
+  int i = 0;
+  while ((2 << i) < os->factor) i++;
+
+  // in place, from the highest rate down; only the last one goes to `out`
+  for (; i >= 0 && os->factor > 1; i--) {
+    osc_halfband_run(&os->stage[i], os->kernels, os->buf, i ? os->buf : out,
+      os->n << i);
+  }
+}
@@ -0,0 +1,58 @@
+// Oversampling for the oscillators that make harmonics of their own
+// (cubic_osc~'s interpolation, fold_osc~'s folding): they run at 2, 4 or 8
+// times the sample rate into a buffer, and this brings it back down through
+// halfband lowpass filters, one per factor of 2.
+//
+// A halfband filter has every other tap 0 except the middle one, so each
+// output only needs the taps on the even input samples plus one odd one. The
+// even and odd samples are split apart first, so the filter reads them
+// unit-stride and does several outputs per SIMD vector (osc_simd_halfband()).
+//
+// At the output rate fs, the result is flat (within 0.002 dB) up to 0.4 fs,
+// and anything that would alias to below 0.4 fs is down by 78 dB or more.
+// Between 0.4 fs and Nyquist some aliasing is let through, in exchange for
+// far fewer taps. The filters delay the signal by 12.5 samples at 2x, 14.75
+// at 4x and 15.875 at 8x. Include after m_pd.h.
+
+#ifndef OVERSAMPLE_H
+#define OVERSAMPLE_H
+
+#include "kernels.h"
+
+#define OSC_OVERSAMPLE_MAX 8
+#define OSC_OVERSAMPLE_STAGES 3 // log2(OSC_OVERSAMPLE_MAX)
+
+// one decimate-by-2 stage
+typedef struct _osc_halfband {
+  const float *taps; // see oversample.c
+  int k; // number of taps, not counting the middle one or the mirror image
+  t_sample *even, *odd; // 2k - 1 samples of history each, then the block's
+} t_osc_halfband;
+
+typedef struct _osc_oversample {
+  const t_osc_kernels *kernels; // for the filters, see kernels.h
+  int factor; // 1, 2, 4 or 8
+  int n; // output samples per block
+  t_sample *buf; // n * factor samples, for the oscillator to fill
+  // stage[i] decimates n << (i + 1) samples to n << i, so stage[0] is last
+  t_osc_halfband stage[OSC_OVERSAMPLE_STAGES];
+} t_osc_oversample;
+
+// f if it's 1, 2, 4 or 8, otherwise 0
+int osc_oversample_factor(t_float f);
+
+// no buffers yet, factor 1, the best kernels for this CPU
+void osc_oversample_init(t_osc_oversample *os);
+
+// Sets up for `factor` times oversampling of blocks of n samples (call it from
+// the dsp method). Starts the filters from silence if either changed. If the
+// memory runs out, it drops to factor 1 and returns 0.
+int osc_oversample_set(t_osc_oversample *os, int factor, int n);
+
+// decimates the n * factor samples in os->buf into n samples of `out`;
+// nothing to do at factor 1
+void osc_oversample_decimate(t_osc_oversample *os, t_sample *out);
+
+void osc_oversample_free(t_osc_oversample *os);
+
+#endif
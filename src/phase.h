@@ -0,0 +1,116 @@
+// Fixed-point phase accumulator shared by all the oscillators.
+//
+// A phase is an unsigned 32 bit integer where 2^32 is one whole cycle. Adding
+// an increment wraps around for free (unsigned overflow is defined), so there
+// are no `while (phase >= size)` loops or UNITBIT32 tricks, and the phase can't
+// slowly drift from accumulated double rounding: every cycle is exactly 2^32
+// steps, about 1e-5 Hz apart at 44.1 kHz.
+//
+// For a table of 2^bits points the index is the top `bits` bits of the phase
+// and the fraction between two points is whatever is below them. Plain shifts
+// and masks, which also means the SIMD kernels (osc_simd.h) can do the same
+// thing in integer lanes.
+//
+// Include after m_pd.h.
+
+#ifndef OSC_PHASE_H
+#define OSC_PHASE_H
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(_M_X64)
+# include <emmintrin.h>
+#endif
+
+typedef uint32_t t_osc_phase;
+
+#define OSC_PHASE_CYCLE 4294967296.0 // 2^32, one cycle
+
+// phase units per Hz: a frequency times this is the per-sample increment
+static inline double osc_phase_conv(t_float sr)
+{
+  return OSC_PHASE_CYCLE / sr;
+}
+
+// whether x is a number at all, i.e. not NaN or +-inf. Looks at the exponent
+// bits rather than using isfinite(), which -ffast-math (Pd's default cflags)
+// lets the compiler assume is always true.
+static inline int osc_phase_finite(double x)
+{
+  uint64_t b;
+  memcpy(&b, &x, sizeof(b));
+  return (b & 0x7ff0000000000000ull) != 0x7ff0000000000000ull;
+}
+
+// a value in phase units (e.g. freq * conv) as a phase or increment, wrapped
+// around by whole cycles, so negative frequencies just count down. Truncates
+// like the float-to-int casts in the old routines. Anything that doesn't fit
+// an int64_t, about a billion times the sample rate and up, and NaN and
+// +-inf, comes out as 0: a frequency that isn't a number holds the phase where
+// it is. No branches either way, so the cost is the same whatever comes in.
+#if defined(__x86_64__) || defined(_M_X64)
+static inline t_osc_phase osc_phase_wrap(double x)
+{
+  // cvttsd2si is defined for every input: whatever doesn't fit gives
+  // 0x8000000000000000, which is 0 in the bits that make the phase
+  return (t_osc_phase)_mm_cvttsd_si64(_mm_set_sd(x));
+}
+#else
+static inline t_osc_phase osc_phase_wrap(double x)
+{
+  // the same in plain C, where that cast is undefined: zero the bits of
+  // whatever is 2^63 or more (NaN and inf included) first, with a mask
+  // rather than `ok ? x : 0`, which compilers turn into a branch that
+  // mispredicts on input flipping between good and bad
+  uint64_t b;
+  memcpy(&b, &x, sizeof(b));
+  b &= 0ull - (uint64_t)((b & 0x7fffffffffffffffull) < 0x43e0000000000000ull);
+  memcpy(&x, &b, sizeof(x));
+  return (t_osc_phase)(int64_t)x;
+}
+#endif
+
+// The same for a float, which skips the conversion to double where that
+// matters, like a phase modulation feeding back into itself (fm_op~). Floats
+// only hold 24 bits, so this is for offsets rather than phases that keep
+// adding up.
+#if defined(__x86_64__) || defined(_M_X64)
+static inline t_osc_phase osc_phase_wrapf(float x)
+{
+  return (t_osc_phase)_mm_cvttss_si64(_mm_set_ss(x));
+}
+#else
+static inline t_osc_phase osc_phase_wrapf(float x)
+{
+  return osc_phase_wrap(x);
+}
+#endif
+
+// a phase given in cycles (0.25 = a quarter of the way through)
+static inline t_osc_phase osc_phase_from_cycles(double c)
+{
+  return osc_phase_wrap(c * OSC_PHASE_CYCLE);
+}
+
+// index into a table of 2^bits points
+static inline uint32_t osc_phase_index(t_osc_phase p, int bits)
+{
+  return p >> (32 - bits);
+}
+
+// how far p is between table point osc_phase_index() and the next, [0, 1).
+// With a table of 2^8 points or more the bits fit a float exactly.
+static inline float osc_phase_frac(t_osc_phase p, int bits)
+{
+  return (float)(p & ((1u << (32 - bits)) - 1))
+    * (1.0f / (float)(1u << (32 - bits)));
+}
+
+// the phase as a float in [0, 1). Only the top 24 bits are used, so it's
+// exact and can't round up to 1.
+static inline float osc_phase_unit(t_osc_phase p)
+{
+  return (float)(p >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif // OSC_PHASE_H
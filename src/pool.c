@@ -0,0 +1,194 @@
+// See pool.h
+
+#include "m_pd.h"
+#include "pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sched.h>
+# include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+# include <immintrin.h>
+# define osc_pool_pause() _mm_pause()
+#elif defined(__aarch64__)
+# define osc_pool_pause() __asm__ __volatile__("yield")
+#else
+# define osc_pool_pause() ((void)0)
+#endif
+
+// How long to spin before sleeping (a worker) or yielding (the caller), in
+// pauses: tens of microseconds, a fraction of a 64 sample block.
+#define OSC_POOL_SPIN 2048
+
+typedef struct _osc_worker {
+  t_osc_pool *pool;
+  int index;
+  pthread_t thread;
+} t_osc_worker;
+
+struct _osc_pool {
+  int nworkers; // including the caller
+  int nthreads; // how many of them were started
+  t_osc_worker *workers;
+
+  atomic_uint gen; // bumped for every run
+  atomic_int pending; // workers still running this one
+  atomic_int sleepers; // workers waiting on `wake`
+  atomic_int quit;
+
+  // written before gen is bumped, read after it's seen
+  t_osc_poolfn fn;
+  void *owner;
+  int nrun; // the caller and the workers below it run fn this time
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+};
+
+static void osc_pool_yield(void)
+{
+#ifdef _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+static void *osc_pool_worker(void *arg)
+{
+  t_osc_worker *w = (t_osc_worker *)arg;
+  t_osc_pool *p = w->pool;
+  unsigned int seen = 0;
+
+  for (;;) {
+    unsigned int g;
+    int spins = 0;
+    while ((g = atomic_load(&p->gen)) == seen) {
+      if (++spins < OSC_POOL_SPIN) {
+        osc_pool_pause();
+        continue;
+      }
+      // osc_pool_run() bumps gen and then checks sleepers, this does it the
+      // other way round, so one of them sees the other
+      pthread_mutex_lock(&p->lock);
+      atomic_fetch_add(&p->sleepers, 1);
+      while (atomic_load(&p->gen) == seen)
+        pthread_cond_wait(&p->wake, &p->lock);
+      atomic_fetch_sub(&p->sleepers, 1);
+      pthread_mutex_unlock(&p->lock);
+    }
+    seen = g;
+    if (atomic_load(&p->quit)) break;
+    if (w->index < p->nrun) p->fn(p->owner, w->index, p->nrun);
+    atomic_fetch_sub_explicit(&p->pending, 1, memory_order_release);
+  }
+  return NULL;
+}
+
+static void osc_pool_wakeall(t_osc_pool *p)
+{
+  if (atomic_load(&p->sleepers)) {
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+static void osc_pool_stop(t_osc_pool *p)
+{
+  atomic_store(&p->quit, 1);
+  atomic_fetch_add(&p->gen, 1);
+  // the sleepers count could still be 0 for one that's about to wait, but
+  // then it sees gen first
+  osc_pool_wakeall(p);
+  for (int i = 0; i < p->nthreads; i++)
+    pthread_join(p->workers[i].thread, NULL);
+}
+
+t_osc_pool *osc_pool_new(int nworkers)
+{
+  t_osc_pool *p;
+
+  if (nworkers < 2) return NULL;
+  p = (t_osc_pool *)getbytes(sizeof(t_osc_pool));
+  if (!p) return NULL;
+  p->workers = (t_osc_worker *)getbytes((nworkers - 1) * sizeof(t_osc_worker));
+  if (!p->workers) {
+    freebytes(p, sizeof(t_osc_pool));
+    return NULL;
+  }
+  p->nworkers = nworkers;
+  p->nthreads = 0;
+  atomic_init(&p->gen, 0);
+  atomic_init(&p->pending, 0);
+  atomic_init(&p->sleepers, 0);
+  atomic_init(&p->quit, 0);
+  p->fn = NULL;
+  p->owner = NULL;
+  p->nrun = 0;
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->wake, NULL);
+
+  for (int i = 0; i < nworkers - 1; i++) {
+    t_osc_worker *w = &p->workers[i];
+    w->pool = p;
+    w->index = i + 1;
+    if (pthread_create(&w->thread, NULL, osc_pool_worker, w)) {
+      osc_pool_free(p);
+      return NULL;
+    }
+    p->nthreads++;
+  }
+  return p;
+}
+
+void osc_pool_free(t_osc_pool *p)
+{
+  if (!p) return;
+  osc_pool_stop(p);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->wake);
+  freebytes(p->workers, (p->nworkers - 1) * sizeof(t_osc_worker));
+  freebytes(p, sizeof(t_osc_pool));
+}
+
+void osc_pool_run(t_osc_pool *p, t_osc_poolfn fn, void *owner, int nworkers)
+{
+  int spins = 0;
+
+  if (!p) {
+    fn(owner, 0, 1);
+    return;
+  }
+  p->fn = fn;
+  p->owner = owner;
+  p->nrun = nworkers < 1 ? 1 : nworkers > p->nworkers ? p->nworkers
+    : nworkers;
+  atomic_store(&p->pending, p->nthreads);
+  atomic_fetch_add(&p->gen, 1);
+  osc_pool_wakeall(p);
+
+  fn(owner, 0, p->nrun);
+
+  while (atomic_load_explicit(&p->pending, memory_order_acquire)) {
+    if (++spins < OSC_POOL_SPIN) osc_pool_pause();
+    else osc_pool_yield();
+  }
+}
+
+int osc_pool_ncpus(void)
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
@@ -0,0 +1,39 @@
+// Worker threads that share a perform routine's work (additive~).
+//
+// osc_pool_run() hands the same function to the calling thread and as many
+// workers as it's asked for, each with its own index, and returns when
+// they've all finished:
+// once per block, so it's one barrier per block. Starting and finishing are
+// atomic counters rather than locks, and the waiting is spinning at first,
+// since under load the next block comes straight after the last one. A
+// worker that's been waiting longer than that (DSP off, or a patch that only
+// runs now and then) goes to sleep on a condition variable, and the caller
+// only touches the lock to wake it when one did. Waiting for the workers,
+// the caller spins and then yields, so it still works with more threads than
+// cores.
+//
+// The workers are created by the thread that makes the pool, Pd's, and get
+// its scheduling priority with it.
+
+#ifndef OSC_POOL_H
+#define OSC_POOL_H
+
+// worker is 0 for the calling thread, 1 to nworkers - 1 for the pool's own,
+// nworkers how many are running this time
+typedef void (*t_osc_poolfn)(void *owner, int worker, int nworkers);
+
+typedef struct _osc_pool t_osc_pool;
+
+// a pool of nworkers - 1 threads plus the caller, or NULL if that's 1 or the
+// threads couldn't be made
+t_osc_pool *osc_pool_new(int nworkers);
+void osc_pool_free(t_osc_pool *p);
+
+// run fn on the caller and nworkers - 1 of the pool's threads (all of them if
+// there are fewer); a NULL pool runs it on the caller only
+void osc_pool_run(t_osc_pool *p, t_osc_poolfn fn, void *owner, int nworkers);
+
+// how many CPUs there are to go round
+int osc_pool_ncpus(void);
+
+#endif // OSC_POOL_H
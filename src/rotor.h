@@ -0,0 +1,246 @@
+// Cosine by a recursive quadrature oscillator, without a table, for a
+// frequency that holds still: the same all through a block and the
+// OSC_ROTOR_HOLD blocks before (simple_osc~ and modern_osc~ switch to it by
+// themselves, see their `rotor` message and osc_rotor_held()).
+//
+// A rotor is the point (cos, sin) of the phase, turned by the increment's
+// angle every sample: c' = c cos(w) - s sin(w), s' = c sin(w) + s cos(w).
+// That's a few multiply-adds a sample and no memory reads, so a steady tone
+// doesn't keep the cosine table in the cache. One sample after another it's
+// a chain of dependent multiply-adds, though, so there are 16 rotors side by
+// side: lane j starts j samples into the block, and all of them turn by 16
+// samples' worth at a time, a vector of lanes at a time in the kernel sets
+// (kernels.h).
+//
+// In float every turn is off by a rounding error, in the angle and in the
+// radius, and those add up. So the lanes only run for a block, or
+// OSC_ROTOR_SEGMENT samples if that's shorter, from a start worked out in
+// double: each channel keeps (cos, sin) of its phase in double, turns it on
+// by the block's angle, and pulls it back onto the unit circle at the end of
+// every block. That stays within rounding of the fixed-point phase (phase.h),
+// which goes on being advanced as well, so switching back to the table for a
+// block with a changing frequency doesn't jump. When the phase isn't where
+// the rotor left it (the table ran the last block, or a phase offset
+// changed), the rotor starts again from cos and sin of the phase.
+//
+// Measured against double precision cos() of the phase the output is off by
+// about 3e-7 at most, mostly from the float turns, so that's a little closer
+// than modern_osc~'s 4096 point table and further off than simple_osc~'s
+// 16384 point one (oscquality puts its THD+N between the two, at -145 to
+// -149 dB). It doesn't drift: over minutes it's the same. Include after
+// m_pd.h.
+
+#ifndef OSC_ROTOR_H
+#define OSC_ROTOR_H
+
+#include "phase.h"
+#include "kernels.h"
+
+#define OSC_ROTOR_LANES 16 // OSC_KERNELS_MAXWIDTH, one vector for AVX-512
+#define OSC_ROTOR_SEGMENT 64 // 4 turns of the lanes
+#define OSC_ROTOR_HOLD 2 // blocks at one increment before the rotor takes over
+
+// per channel; all zeros is a rotor that hasn't run yet
+typedef struct _osc_rotor {
+  int held; // blocks in a row before this one with the same increment all
+             // through, up to OSC_ROTOR_HOLD
+  t_osc_phase last; // and this was it
+  int running; // c and s are for `phase`
+  t_osc_phase phase;
+  double c, s;
+  int ready; // the rest is for `inc`
+  t_osc_phase inc;
+  double wc, ws; // one sample's turn
+  float lc[OSC_ROTOR_LANES], ls[OSC_ROTOR_LANES]; // j samples' turn
+  float tc, ts; // OSC_ROTOR_LANES samples' turn, for the lanes
+  double segc, segs; // OSC_ROTOR_SEGMENT samples' turn
+  int tail; // what tailc and tails are for, 0 for nothing yet
+  double tailc, tails; // `tail` samples' turn
+} t_osc_rotor;
+
+// cos and sin of a phase or increment, in double. A quarter turn is 2^30 in
+// the fixed-point phase, so taking out the nearest one leaves at most an
+// eighth of a turn, where Taylor series to x^16 are within 1e-16. It's here
+// rather than cos() and sin() because the rotor is the rare path: after a
+// stretch on the table, a call into libm waits for its code to come back
+// into the cache, which oscfuzz sees as a block several times slower.
+static inline void osc_rotor_sincos(t_osc_phase p, double *c, double *s)
+{
+  uint32_t q = (p + 0x20000000u) >> 30;
+  double x = (int32_t)(p - (q << 30))
+    * (2 * 3.14159265358979323846 / 4294967296.0);
+  double x2 = x * x, pc, ps, t;
+
+  pc = 1 + x2 * (-1 / 2. + x2 * (1 / 24. + x2 * (-1 / 720. + x2 * (1 / 40320.
+    + x2 * (-1 / 3628800. + x2 * (1 / 479001600. + x2 * (-1 / 87178291200.
+    + x2 * (1 / 20922789888000.))))))));
+  ps = x * (1 + x2 * (-1 / 6. + x2 * (1 / 120. + x2 * (-1 / 5040.
+    + x2 * (1 / 362880. + x2 * (-1 / 39916800. + x2 * (1 / 6227020800.
+    + x2 * (-1 / 1307674368000.))))))));
+  if (q & 1) {
+    t = pc;
+    pc = -ps;
+    ps = t;
+  }
+  if (q & 2) {
+    pc = -pc;
+    ps = -ps;
+  }
+  *c = pc;
+  *s = ps;
+}
+
+// (wc, ws) turned m times, in *c and *s, by squaring: in double that's as
+// good as cos and sin of m times the angle, for less
+static inline void osc_rotor_pow(double wc, double ws, int m,
+  double *c, double *s)
+{
+  double pc = 1, ps = 0;
+  for (; m; m >>= 1) {
+    double t;
+    if (m & 1) {
+      t = pc * wc - ps * ws;
+      ps = pc * ws + ps * wc;
+      pc = t;
+    }
+    t = wc * wc - ws * ws;
+    ws = 2 * wc * ws;
+    wc = t;
+  }
+  *c = pc;
+  *s = ps;
+}
+
+// The turns for inc. The lanes are one sample's turn multiplied up in
+// double, which is closer than float needs: the first four one after the
+// other, then each from the one four before, which can go side by side.
+static inline void osc_rotor_setinc(t_osc_rotor *r, t_osc_phase inc)
+{
+  double wc, ws, c[OSC_ROTOR_LANES + 4], s[OSC_ROTOR_LANES + 4];
+
+  osc_rotor_sincos(inc, &wc, &ws);
+  c[0] = 1;
+  s[0] = 0;
+  for (int j = 1; j < 5; j++) {
+    c[j] = c[j - 1] * wc - s[j - 1] * ws;
+    s[j] = c[j - 1] * ws + s[j - 1] * wc;
+  }
+  for (int j = 5; j < OSC_ROTOR_LANES + 4; j++) {
+    c[j] = c[j - 4] * c[4] - s[j - 4] * s[4];
+    s[j] = c[j - 4] * s[4] + s[j - 4] * c[4];
+  }
+  for (int j = 0; j < OSC_ROTOR_LANES; j++) {
+    r->lc[j] = (float)c[j];
+    r->ls[j] = (float)s[j];
+  }
+  r->tc = (float)c[OSC_ROTOR_LANES];
+  r->ts = (float)s[OSC_ROTOR_LANES];
+  r->wc = wc;
+  r->ws = ws;
+  osc_rotor_pow(c[OSC_ROTOR_LANES], s[OSC_ROTOR_LANES],
+                OSC_ROTOR_SEGMENT / OSC_ROTOR_LANES, &r->segc, &r->segs);
+  r->inc = inc;
+  r->tail = 0;
+  r->ready = 1;
+}
+
+// turn the double precision rotor on by m samples
+static inline void osc_rotor_turn(t_osc_rotor *r, int m)
+{
+  double tc, ts, c = r->c;
+  if (m == OSC_ROTOR_SEGMENT) {
+    tc = r->segc;
+    ts = r->segs;
+  } else {
+    if (m != r->tail) {
+      osc_rotor_pow(r->wc, r->ws, m, &r->tailc, &r->tails);
+      r->tail = m;
+    }
+    tc = r->tailc;
+    ts = r->tails;
+  }
+  r->c = c * tc - r->s * ts;
+  r->s = c * ts + r->s * tc;
+}
+
+// n samples of the lanes c and s turned by (tc, ts) every OSC_ROTOR_LANES
+// samples, interleaved back into one signal; the kernel sets' `rotor`
+static inline void osc_rotor_run(float *c, float *s, float tc, float ts,
+  t_sample *out, int n)
+{
+  for (; n >= OSC_ROTOR_LANES; n -= OSC_ROTOR_LANES, out += OSC_ROTOR_LANES) {
+    for (int j = 0; j < OSC_ROTOR_LANES; j++) {
+      float cj = c[j];
+      out[j] = cj;
+      c[j] = cj * tc - s[j] * ts;
+      s[j] = cj * ts + s[j] * tc;
+    }
+  }
+  for (int j = 0; j < n; j++) out[j] = c[j];
+}
+
+// n samples of cos() from `phase` on, `inc` a sample, with the kernel set k;
+// returns the new phase, the same as the table routines
+static inline t_osc_phase osc_rotor(t_osc_rotor *r, const t_osc_kernels *k,
+  t_osc_phase phase, t_osc_phase inc, t_sample *out, int n)
+{
+  float c[OSC_ROTOR_LANES], s[OSC_ROTOR_LANES];
+  double g;
+
+  if (!r->ready || r->inc != inc) osc_rotor_setinc(r, inc);
+  if (!r->running || r->phase != phase) {
+    osc_rotor_sincos(phase, &r->c, &r->s);
+    r->running = 1;
+  }
+
+  for (int i = 0; i < n; i += OSC_ROTOR_SEGMENT) {
+    int m = n - i < OSC_ROTOR_SEGMENT ? n - i : OSC_ROTOR_SEGMENT;
+    for (int j = 0; j < OSC_ROTOR_LANES; j++) {
+      c[j] = (float)(r->c * r->lc[j] - r->s * r->ls[j]);
+      s[j] = (float)(r->c * r->ls[j] + r->s * r->lc[j]);
+    }
+    if (k->rotor) k->rotor(c, s, r->tc, r->ts, out + i, m);
+    else osc_rotor_run(c, s, r->tc, r->ts, out + i, m);
+    osc_rotor_turn(r, m);
+  }
+
+  // back onto the circle: one Newton step for 1 / sqrt(), which is plenty
+  // this close to 1
+  g = 1.5 - 0.5 * (r->c * r->c + r->s * r->s);
+  r->c *= g;
+  r->s *= g;
+  r->phase = phase + inc * (t_osc_phase)n;
+  return r->phase;
+}
+
+// Whether to run the rotor for a block whose increment is `inc` (if
+// `steady`, the same all block): only when the OSC_ROTOR_HOLD blocks before
+// had it too. Setting up the turns for a new increment takes time a frequency
+// that moves every block would pay every block, and a rotor that only runs
+// for a block here and there runs with its code out of the cache, several
+// times slower than the table (oscfuzz's spikes pattern finds those), so
+// until then a new increment goes to the table and just gets counted here. A
+// frequency of 0, which is also what NaN, inf and anything too big come to,
+// stays on the table too: there it reads the same two points all block, and
+// a stop between two stretches of one tone would otherwise cost setting up
+// the turns twice.
+static inline int osc_rotor_held(t_osc_rotor *r, int steady, t_osc_phase inc)
+{
+  if (steady && inc && inc == r->last) {
+    if (r->held < OSC_ROTOR_HOLD) r->held++;
+  } else r->held = 0;
+  r->last = steady ? inc : 0;
+  return r->held >= OSC_ROTOR_HOLD;
+}
+
+// whether the n samples of in are all the same, i.e. the frequency is
+// constant over the block (NaN isn't, so that goes to the table)
+static inline int osc_rotor_const(const t_sample *in, int n)
+{
+  t_sample f = in[0];
+  int same = 1;
+  for (int i = 1; i < n; i++) same &= in[i] == f;
+  return same;
+}
+
+#endif // OSC_ROTOR_H
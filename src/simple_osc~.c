@@ -4,91 +4,254 @@
 //
 // for a general overview of the code, (mostly mine with some confirmation from
 // Claude), see `understanding_pure_data_wave_table_oscillator.md`
+//
+// Blocks where the frequency doesn't change are made by the rotor of rotor.h
+// instead of the table; `rotor 0` turns that off, `rotor 1` back on.
 
 #include "m_pd.h"
 #include <math.h>
+#include "wavetable.h"
+#include "connect.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+#include "multichannel.h"
+#include "rotor.h"
 
-#define WAVETABLE_SIZE 16384
+#define WAVETABLE_BITS 14
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS) // 16384
 
 static t_class *simple_osc_class = NULL;
-static t_float *cos_table = NULL; // shared wavetable
-static int table_reference_count = 0; // track how many instances exist
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
 
 typedef struct _simple_osc {
   t_object x_obj;
-  double x_phase;
-  t_float x_conv;
+  t_osc_phase *x_phases; // see phase.h; one per channel (multichannel.h)
+  int x_nphases; // room in x_phases
+  double x_conv; // phase increment per Hz
   t_inlet *x_freq_inlet;
   t_outlet *x_outlet;
   t_float x_f;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
+  int x_rotor; // the `rotor` message
+  t_osc_rotor *x_rotors; // see rotor.h, one per channel
+  int x_nrotors; // room in x_rotors
 } t_simple_osc;
 
-static void wavetable_init(void)
+// The channels (see multichannel.h) come one after the other in `in` and
+// `out`, so the pointers just carry on from one into the next.
+static t_int *simple_osc_perform(t_int *w)
 {
-  if (cos_table == NULL) {
-    cos_table = (t_float *)getbytes(sizeof(t_float) * (WAVETABLE_SIZE + 1));
-    if (cos_table) {
-      for (int i = 0; i <= WAVETABLE_SIZE; i++) {
-        cos_table[i] = cosf((i * 2.0f * M_PI) / WAVETABLE_SIZE);
-      }
-      post("simple_osc~: initialized cosine table of size %d", WAVETABLE_SIZE);
-    } else {
-      post("simple_osc~ error: failed to allocate memory for cosine table");
+  t_simple_osc *x = (t_simple_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+
+  double conv = x->x_conv;
+
+  if (!cos_table) return (w+6);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c];
+
+    for (int i = 0; i < n; i++) {
+      // top bits are the table index, the rest the fraction
+      uint32_t index = osc_phase_index(phase, WAVETABLE_BITS);
+      t_float frac = osc_phase_frac(phase, WAVETABLE_BITS);
+
+      // linear interpolation between table points
+      *out++ = cos_table[index] + frac * (cos_table[index + 1] - cos_table[index]);
+
+      // advance phase based on frequency; wraps around on its own
+      phase += osc_phase_wrap(*in++ * conv);
     }
+
+    x->x_phases[c] = phase;
   }
-  table_reference_count++;
+  return (w + 6);
 }
 
-static void wavetable_free(void)
+// nothing but floats reach the frequency inlet, so the frequency (and the
+// phase increment) is the same for the whole block, and for every channel
+static t_int *simple_osc_perform_const(t_int *w)
 {
-  table_reference_count--;
-  if (table_reference_count <= 0 && cos_table != NULL) {
-    freebytes(cos_table, sizeof(t_float) * (WAVETABLE_SIZE + 1));
-    cos_table = NULL;
-    post("simple_osc~: freed cosine table");
-    table_reference_count = 0; // just to be safe
+  t_simple_osc *x = (t_simple_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
+
+  if (!cos_table) return (w+6);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c];
+
+    for (int i = 0; i < n; i++) {
+      uint32_t index = osc_phase_index(phase, WAVETABLE_BITS);
+      t_float frac = osc_phase_frac(phase, WAVETABLE_BITS);
+
+      *out++ = cos_table[index] + frac * (cos_table[index + 1] - cos_table[index]);
+
+      phase += inc;
+    }
+
+    x->x_phases[c] = phase;
   }
+  return (w + 6);
 }
 
-// TODO: `in` and `out` should have type `t_sample`, not `t_float`
-// `t_sample *in = (t_float *)(w[2]);`
-static t_int *simple_osc_perform(t_int *w)
+// same output as simple_osc_perform (see osc_simd.h), but a vector of samples
+// at a time (see kernels.h)
+static t_int *simple_osc_perform_simd(t_int *w)
 {
   t_simple_osc *x = (t_simple_osc *)(w[1]);
-  t_float *in = (t_float *)(w[2]); // fix the type
-  t_float *out = (t_float *)(w[3]); // fix the type
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
   int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
 
-  double dphase = x->x_phase;
-  double conv = x->x_conv;
+  if (!cos_table) return (w+6);
 
-  if (!cos_table) return (w+5);
+  for (int c = 0; c < nchans; c++, in += n, out += n) {
+    x->x_phases[c] = x->x_kernels->lerp(cos_table, WAVETABLE_BITS,
+                                        x->x_phases[c], in, x->x_conv, out, n);
+  }
+  return (w + 6);
+}
 
-  while (n--) {
-    t_float freq = *in++; // should be t_sample
-    int index = ((int)dphase) & (WAVETABLE_SIZE-1);
-    t_float frac = dphase - index;
+static t_int *simple_osc_perform_simd_const(t_int *w)
+{
+  t_simple_osc *x = (t_simple_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
 
-    // linear interpolation between table points
-    *out++ = cos_table[index] + frac * (cos_table[index + 1] - cos_table[index]);
+  if (!cos_table) return (w+6);
 
-    // advance phase based on frequency
-    dphase += freq * conv;
-    // fairly sure this can be done outside of the while loop
-    while (dphase >= WAVETABLE_SIZE) dphase -= WAVETABLE_SIZE;
-    while (dphase <0) dphase += WAVETABLE_SIZE;
+  for (int c = 0; c < nchans; c++, out += n) {
+    x->x_phases[c] = x->x_kernels->lerp_const(cos_table, WAVETABLE_BITS,
+      x->x_phases[c], inc, out, n);
   }
+  return (w + 6);
+}
 
-  x->x_phase = dphase;
-  return (w + 5);
+// The rotor (rotor.h) for the channels whose frequency holds still (see
+// osc_rotor_held()), the table for the others. With a constant frequency
+// there's no checking the signal: it's one value for the block.
+static t_int *simple_osc_perform_rotor_body(t_int *w,
+  const int freq_signal)
+{
+  t_simple_osc *x = (t_simple_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+  const t_osc_kernels *k = x->x_kernels;
+  double conv = x->x_conv;
+
+  if (!cos_table) return (w+6);
+
+  for (int c = 0; c < nchans; c++, in += freq_signal ? n : 0, out += n) {
+    t_osc_phase phase = x->x_phases[c];
+    t_osc_phase inc = osc_phase_wrap(in[0] * conv);
+
+    if (osc_rotor_held(&x->x_rotors[c],
+                       !freq_signal || osc_rotor_const(in, n), inc)) {
+      phase = osc_rotor(&x->x_rotors[c], k, phase, inc, out, n);
+    } else if (!freq_signal && k->width) {
+      phase = k->lerp_const(cos_table, WAVETABLE_BITS, phase, inc, out, n);
+    } else if (k->width) {
+      phase = k->lerp(cos_table, WAVETABLE_BITS, phase, in, conv, out, n);
+    } else {
+      for (int i = 0; i < n; i++) {
+        uint32_t index = osc_phase_index(phase, WAVETABLE_BITS);
+        t_float frac = osc_phase_frac(phase, WAVETABLE_BITS);
+        out[i] = cos_table[index] + frac * (cos_table[index + 1] - cos_table[index]);
+        phase += freq_signal ? osc_phase_wrap(in[i] * conv) : inc;
+      }
+    }
+    x->x_phases[c] = phase;
+  }
+  return (w + 6);
+}
+
+static t_int *simple_osc_perform_rotor(t_int *w)
+{
+  return simple_osc_perform_rotor_body(w, 1);
+}
+
+static t_int *simple_osc_perform_rotor_const(t_int *w)
+{
+  return simple_osc_perform_rotor_body(w, 0);
 }
 
 static void simple_osc_dsp(t_simple_osc *x, t_signal **sp)
 {
+  t_perfroutine perform;
+  const char *path;
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  // tiny blocks (block~ 1, 2...) aren't worth the vector setup
+  int simd = x->x_kernels->width && sp[0]->s_length >= x->x_kernels->width;
+  // nor the rotor's lanes
+  int rotor = x->x_rotor && sp[0]->s_length >= OSC_ROTOR_LANES;
+
   // calculate the conversion factor for this sample rate
-  x->x_conv = WAVETABLE_SIZE / sp[0]->s_sr;
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+
+  // as many channels out as the frequency has
+  int nchans = osc_mc_phases(&x->x_phases, &x->x_nphases,
+                             osc_mc_nchans(sp[0]));
+
+  if (rotor) {
+    void *state = x->x_rotors;
+    nchans = osc_mc_state(&state, &x->x_nrotors, nchans, sizeof(t_osc_rotor));
+    x->x_rotors = (t_osc_rotor *)state;
+  }
+
+  if (rotor && freq_signal) {
+    perform = simple_osc_perform_rotor;
+    path = simd ? "rotor or simd" : "rotor or scalar";
+  } else if (rotor) {
+    perform = simple_osc_perform_rotor_const;
+    path = simd ? "rotor or simd, constant frequency"
+                : "rotor or scalar, constant frequency";
+  } else if (simd) {
+    perform = freq_signal ? simple_osc_perform_simd : simple_osc_perform_simd_const;
+    path = freq_signal ? "simd" : "simd, constant frequency";
+  } else {
+    perform = freq_signal ? simple_osc_perform : simple_osc_perform_const;
+    path = freq_signal ? "scalar" : "scalar, constant frequency";
+  }
+
+  // signal vectors are inlets first, then the outlet: sp[1] belongs to
+  // x_freq_inlet, which nothing reads (the left inlet is the frequency), so
+  // the output is sp[2]
+  osc_mc_setout(&sp[2], nchans);
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(perform, 5, x, sp[0]->s_vec, sp[2]->s_vec, sp[0]->s_length, nchans);
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length * nchans);
+}
 
-  dsp_add(simple_osc_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+static void simple_osc_rotor(t_simple_osc *x, t_floatarg f)
+{
+  int on = f != 0;
+  if (on != x->x_rotor) {
+    x->x_rotor = on;
+    canvas_update_dsp();
+  }
+}
+
+static void simple_osc_kernel(t_simple_osc *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "simple_osc~", &x->x_kernels, s))
+    canvas_update_dsp();
 }
 
 static void *simple_osc_new(t_floatarg f)
@@ -96,15 +259,23 @@ static void *simple_osc_new(t_floatarg f)
   t_simple_osc *x = (t_simple_osc *)pd_new(simple_osc_class);
 
   // initialize phase and frequency
-  x->x_phase = 0;
+  x->x_phases = NULL;
+  x->x_nphases = 0;
+  osc_mc_phases(&x->x_phases, &x->x_nphases, 1);
   x->x_f = f > 0 ? f : 440;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_kernels = osc_kernels_best();
+  x->x_rotor = 1;
+  x->x_rotors = NULL;
+  x->x_nrotors = 0;
 
   x->x_freq_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   pd_float((t_pd *)x->x_freq_inlet, x->x_f); // sets inlet initial value from
   // arg
   x->x_outlet = outlet_new(&x->x_obj, &s_signal);
 
-  wavetable_init();
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_LINEAR);
 
   return (void *)x;
 }
@@ -113,9 +284,16 @@ static void simple_osc_free(t_simple_osc *x)
 {
   inlet_free(x->x_freq_inlet);
   outlet_free(x->x_outlet);
+  osc_mc_freephases(x->x_phases, x->x_nphases);
+  osc_mc_freestate(x->x_rotors, x->x_nrotors, sizeof(t_osc_rotor));
 
   // decrease reference count and possibly free wavetable
-  wavetable_free();
+  wavetable_release(cos_table);
+}
+
+static void simple_osc_stats(t_simple_osc *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "simple_osc~", argc, argv);
 }
 
 void simple_osc_tilde_setup(void)
@@ -124,11 +302,17 @@ void simple_osc_tilde_setup(void)
                                (t_newmethod)simple_osc_new,
                                (t_method)simple_osc_free,
                                sizeof(t_simple_osc),
-                               CLASS_DEFAULT,
+                               CLASS_DEFAULT | OSC_MC_CLASS,
                                A_DEFFLOAT, 0);
 
   class_addmethod(simple_osc_class, (t_method)simple_osc_dsp, gensym("dsp"), A_CANT, 0);
   CLASS_MAINSIGNALIN(simple_osc_class, t_simple_osc, x_f);
+  class_addmethod(simple_osc_class, (t_method)simple_osc_kernel, gensym("kernel"),
+                  A_DEFSYM, 0);
+  class_addmethod(simple_osc_class, (t_method)simple_osc_rotor, gensym("rotor"),
+                  A_FLOAT, 0);
+  class_addmethod(simple_osc_class, (t_method)simple_osc_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
 
 
@@ -1,46 +1,38 @@
 #include "m_pd.h"
+#include "connect.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+#include "sync.h"
+#include "events.h"
 
 static t_class *simple_phasor_class = NULL;
 
 /*
- * See `pure_data_phasor_external.md` for notes about what's going on with
- * UNITBIT32 and tabfudge. It's a bit of magic that allows the fractional
- * (in the range (0, 1)) phase values to be wrapped without using a modulo
- * operator.
+ * This used the UNITBIT32 "tabfudge" trick from Pd's phasor~ (see
+ * `pure_data_phasor_external.md`): adding 3*2^19 to a double phase puts the
+ * integer part in the high word, and overwriting that word wraps the phase to
+ * (0, 1) without a modulo operator. The fixed-point phase from phase.h gets the
+ * same effect more directly: one cycle is 2^32, so an unsigned 32 bit add wraps
+ * around on its own, and the output is just the phase scaled down to (0, 1).
+ *
+ * The right inlet is hard sync: a phasor there (another one of these, say)
+ * restarts this one at every wrap, at the exact point between samples, see
+ * sync.h. ft1 sets the phase on the sample its logical time falls on rather
+ * than at the next block, see events.h.
  */
-#define UNITBIT32 1572864.  /* 3*2^19; bit 32 has place value 1 */
-
-// I think this is handled elsewhere, but just in case:
-// BYTE_ORDER should be defined by the operation system. Most modern systems are
-// little endian (least significant bytes stored first (remember bytes not bits!))
-#if BYTE_ORDER == LITTLE_ENDIAN
-# define HIOFFSET 1
-# define LOWOFFSET 0
-#else
-# define HIOFFSET 0    /* word offset to find MSB */
-# define LOWOFFSET 1    /* word offset to find LSB */
-#endif
-
-// Overlayes a double (64 bits) with an array of two tf_i values (each has 32
-// bits). 
-// tf_i[HIOFFSET] contains the sign bit, the exponent bits, and the first 20
-// bits of the mantissa (fractional part).
-// tf_i[LOWOFFSET] stores the rest of the mantissa.
-// Because it's a union, both members share the same memory location - updating
-// tf_i[HIOFFSET] in the while loop modifies the corresponding 32 bits in the 64
-// bit tf_d double.
-union tabfudge
-{
-    double tf_d;
-    int32_t tf_i[2];
-};
 
 typedef struct _simple_phasor
 {
   t_object x_obj;
-  double x_phase;
-  t_float x_conv;
+  t_osc_phase x_phase;
+  double x_conv; // phase increment per Hz
   t_float x_f; // scalar frequency
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
+  t_osc_sync x_sync; // see sync.h
+  t_osc_events x_events; // see events.h
 } t_simple_phasor;
 
 static void *simple_phasor_new(t_floatarg f)
@@ -48,53 +40,188 @@ static void *simple_phasor_new(t_floatarg f)
   t_simple_phasor *x = (t_simple_phasor *)pd_new(simple_phasor_class);
   x->x_f = f;
   inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_float, gensym("ft1"));
+  inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   x->x_phase = 0;
   x->x_conv = 0;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_kernels = osc_kernels_best();
+  osc_sync_init(&x->x_sync);
+  osc_events_init(&x->x_events);
 outlet_new(&x->x_obj, gensym("signal"));
 
   return (void *)x;
 }
 
+// the messages that go through x_events
+enum { SIMPLE_PHASOR_FT1 };
+
+static void simple_phasor_apply(void *owner, int type, t_float f)
+{
+  t_simple_phasor *x = (t_simple_phasor *)owner;
+  if (type == SIMPLE_PHASOR_FT1) x->x_phase = osc_phase_from_cycles(f);
+}
+
+// All the performs split the block where a queued ft1 is due, and work
+// through x_phase from one part to the next.
 static t_int *simple_phasor_perform(t_int *w)
 {
   t_simple_phasor *x = (t_simple_phasor *)(w[1]);
-  t_sample *in = (t_float *)(w[2]);
-  t_sample *out = (t_float *)(w[3]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
   int n = (int)(w[4]);
-  double dphase = x->x_phase + (double)UNITBIT32;
-  union tabfudge tf;
-  int normhipart;
-  t_float conv = x->x_conv;
-
-  tf.tf_d = UNITBIT32;
-  normhipart = tf.tf_i[HIOFFSET]; // get the HIOFFSET of UNITBIT32. The binary
-  // representation of 3*2^19.
-  tf.tf_d = dphase; // overwrite tf.tf_d to dphase + UNITBIT32. The high part
-  // now matches UNITBIT32 and the low part carries the fractional value from
-  // dphase
-
-  while (n--)
-  {
-    tf.tf_i[HIOFFSET] = normhipart; // keep setting the hioffset to normhipart
-    dphase += *in++ * conv; // frequency * conv factor
-    *out++ = tf.tf_d - UNITBIT32; // just output the fractional part
-    tf.tf_d = dphase; // reset for next iteration
+  double conv = x->x_conv;
+
+  for (int i = 0, end; i < n; i = end) {
+    t_osc_phase phase;
+    end = osc_events_run(&x->x_events, i, n, x, simple_phasor_apply);
+    phase = x->x_phase;
+    for (int j = i; j < end; j++) {
+      out[j] = osc_phase_unit(phase); // the phase as a fraction of a cycle
+      phase += osc_phase_wrap(in[j] * conv); // frequency * conv factor
+    }
+    x->x_phase = phase;
   }
 
-  tf.tf_i[HIOFFSET] = normhipart;
-  x->x_phase = tf.tf_d - UNITBIT32;
+  osc_events_done(&x->x_events);
   return (w+5);
 }
 
+// same output, a vector of samples at a time (see kernels.h)
+static t_int *simple_phasor_perform_simd(t_int *w)
+{
+  t_simple_phasor *x = (t_simple_phasor *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+
+  for (int i = 0, end; i < n; i = end) {
+    end = osc_events_run(&x->x_events, i, n, x, simple_phasor_apply);
+    x->x_phase = x->x_kernels->phasor(x->x_phase, in + i, x->x_conv, out + i,
+                                      end - i);
+  }
+
+  osc_events_done(&x->x_events);
+  return (w+5);
+}
+
+// same thing when the frequency only comes in as floats: the increment is
+// the same for every sample in the block
+static t_int *simple_phasor_perform_const(t_int *w)
+{
+  t_simple_phasor *x = (t_simple_phasor *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  t_osc_phase inc = osc_phase_wrap(in[0] * x->x_conv);
+
+  for (int i = 0, end; i < n; i = end) {
+    t_osc_phase phase;
+    end = osc_events_run(&x->x_events, i, n, x, simple_phasor_apply);
+    phase = x->x_phase;
+    for (int j = i; j < end; j++) {
+      out[j] = osc_phase_unit(phase);
+      phase += inc;
+    }
+    x->x_phase = phase;
+  }
+
+  osc_events_done(&x->x_events);
+  return (w+5);
+}
+
+// with the sync inlet connected; freq_signal is a constant in both performs
+static inline t_int *simple_phasor_perform_sync_body(t_int *w,
+  const int freq_signal)
+{
+  t_simple_phasor *x = (t_simple_phasor *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *sync = (t_sample *)(w[3]);
+  t_sample *out = (t_sample *)(w[4]);
+  int n = (int)(w[5]);
+  double conv = x->x_conv;
+  t_osc_phase inc = osc_phase_wrap(in[0] * conv);
+
+  for (int i = 0, end; i < n; i = end) {
+    t_osc_phase phase;
+    end = osc_events_run(&x->x_events, i, n, x, simple_phasor_apply);
+    phase = x->x_phase;
+    for (int j = i; j < end; j++) {
+      t_osc_phase before;
+      float d;
+      if (freq_signal) inc = osc_phase_wrap(in[j] * conv);
+      osc_sync_check(&x->x_sync, sync[j], &phase, &before, &d);
+      out[j] = osc_phase_unit(phase);
+      phase += inc;
+      osc_sync_next(&x->x_sync, inc);
+    }
+    x->x_phase = phase;
+  }
+
+  osc_events_done(&x->x_events);
+  return (w+6);
+}
+
+static t_int *simple_phasor_perform_sync(t_int *w)
+{
+  return simple_phasor_perform_sync_body(w, 1);
+}
+
+static t_int *simple_phasor_perform_sync_const(t_int *w)
+{
+  return simple_phasor_perform_sync_body(w, 0);
+}
+
 static void simple_phasor_dsp(t_simple_phasor *x, t_signal **sp)
 {
-  x->x_conv = 1./sp[0]->s_sr;
-  dsp_add(simple_phasor_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, (t_int)sp[0]->s_length);
+  t_perfroutine perform = simple_phasor_perform;
+  const char *path = "scalar";
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  // the sync inlet is inlet 2, after ft1
+  int sync_signal = osc_signal_connected(&x->x_obj, x->x_glist, 2);
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  osc_events_flush(&x->x_events, x, simple_phasor_apply);
+  osc_events_dsp(&x->x_events, sp[0]->s_sr, sp[0]->s_length);
+  if (sync_signal) {
+    perform = freq_signal ? simple_phasor_perform_sync
+                          : simple_phasor_perform_sync_const;
+    path = freq_signal ? "scalar, sync" : "sync, constant frequency";
+  } else {
+    if (x->x_kernels->width && sp[0]->s_length >= x->x_kernels->width) {
+      perform = simple_phasor_perform_simd;
+      path = "simd";
+    }
+    if (!freq_signal) {
+      perform = simple_phasor_perform_const;
+      path = "constant frequency";
+    }
+  }
+  osc_stats_dsp_begin(&x->x_stats);
+  // sp[1] is the sync inlet's signal, the output sp[2]
+  if (sync_signal)
+    dsp_add(perform, 5, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec,
+            (t_int)sp[0]->s_length);
+  else
+    dsp_add(perform, 4, x, sp[0]->s_vec, sp[2]->s_vec,
+            (t_int)sp[0]->s_length);
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length);
 }
 
 static void simple_phasor_ft1(t_simple_phasor *x, t_float f)
 {
-  x->x_phase = (double)f;
+  osc_events_add(&x->x_events, x, simple_phasor_apply, SIMPLE_PHASOR_FT1, f);
+}
+
+static void simple_phasor_kernel(t_simple_phasor *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "simple_phasor~", &x->x_kernels, s))
+    canvas_update_dsp();
+}
+
+static void simple_phasor_stats(t_simple_phasor *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "simple_phasor~", argc, argv);
 }
 
 void simple_phasor_tilde_setup(void)
@@ -106,4 +233,8 @@ void simple_phasor_tilde_setup(void)
                   gensym("dsp"), A_CANT, 0);
   class_addmethod(simple_phasor_class, (t_method)simple_phasor_ft1,
                   gensym("ft1"), A_FLOAT, 0);
+  class_addmethod(simple_phasor_class, (t_method)simple_phasor_kernel,
+                  gensym("kernel"), A_DEFSYM, 0);
+  class_addmethod(simple_phasor_class, (t_method)simple_phasor_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
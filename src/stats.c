@@ -0,0 +1,162 @@
+// See stats.h
+
+#include "m_pd.h"
+#include "stats.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+# ifdef _MSC_VER
+#  include <intrin.h>
+# else
+#  include <x86intrin.h>
+# endif
+#elif !defined(__aarch64__)
+# include <time.h>
+#endif
+
+static inline uint64_t osc_stats_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t t;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  // usually served from the vDSO, without entering the kernel
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static int osc_stats_bucket(uint64_t t)
+{
+  int e = 0, b;
+  if (t < 4) return (int)t;
+  // e = floor(log2(t)), at least 2
+#if defined(__GNUC__)
+  e = 63 - __builtin_clzll(t);
+#else
+  while (t >> (e + 1)) e++;
+#endif
+  b = 4 * (e - 1) + (int)((t >> (e - 2)) & 3);
+  return b < OSC_STATS_BUCKETS ? b : OSC_STATS_BUCKETS - 1;
+}
+
+// the most ticks that land in bucket b
+static uint64_t osc_stats_bucket_top(int b)
+{
+  int e = b / 4 + 2;
+  if (b < 4) return (uint64_t)b;
+  return ((uint64_t)(4 + b % 4 + 1) << (e - 3)) - 1;
+}
+
+static void osc_stats_clear(t_osc_stats *s)
+{
+  s->blocks = s->sum = s->max = 0;
+  memset(s->hist, 0, sizeof(s->hist));
+}
+
+void osc_stats_init(t_osc_stats *s)
+{
+  s->on = 0;
+  s->path[0] = 0;
+  s->n = 0;
+  s->start = 0;
+  osc_stats_clear(s);
+}
+
+static t_int *osc_stats_perform_begin(t_int *w)
+{
+  t_osc_stats *s = (t_osc_stats *)(w[1]);
+  s->start = osc_stats_now();
+  return (w + 2);
+}
+
+static t_int *osc_stats_perform_end(t_int *w)
+{
+  t_osc_stats *s = (t_osc_stats *)(w[1]);
+  uint64_t t = osc_stats_now() - s->start;
+  s->blocks++;
+  s->sum += t;
+  s->max = t > s->max ? t : s->max;
+  s->hist[osc_stats_bucket(t)]++;
+  return (w + 2);
+}
+
+void osc_stats_dsp_begin(t_osc_stats *s)
+{
+  if (s->on) dsp_add(osc_stats_perform_begin, 1, s);
+}
+
+void osc_stats_dsp_end(t_osc_stats *s, const char *path, int n)
+{
+  if (!s->on) return;
+  if (strncmp(path, s->path, OSC_STATS_PATHSIZE - 1) || n != s->n)
+    osc_stats_clear(s);
+  strncpy(s->path, path, OSC_STATS_PATHSIZE - 1);
+  s->path[OSC_STATS_PATHSIZE - 1] = 0;
+  s->n = n;
+  dsp_add(osc_stats_perform_end, 1, s);
+}
+
+// the smallest bucket top that at least 99% of the blocks fit under
+static uint64_t osc_stats_p99(const t_osc_stats *s)
+{
+  uint64_t need = s->blocks - s->blocks / 100, seen = 0;
+  for (int b = 0; b < OSC_STATS_BUCKETS; b++) {
+    seen += s->hist[b];
+    if (seen >= need) {
+      uint64_t top = osc_stats_bucket_top(b);
+      return top < s->max ? top : s->max;
+    }
+  }
+  return s->max;
+}
+
+void osc_stats_message(t_osc_stats *s, void *x, const char *classname,
+  int argc, t_atom *argv)
+{
+  double mean = s->blocks ? (double)s->sum / s->blocks : 0;
+
+  if (argc && argv[0].a_type == A_FLOAT) {
+    int on = atom_getfloatarg(0, argc, argv) != 0;
+    osc_stats_clear(s);
+    if (on != s->on) {
+      s->on = on;
+      canvas_update_dsp(); // to add or take out the timing
+    }
+    return;
+  }
+  if (argc) {
+    t_symbol *name = atom_getsymbolarg(0, argc, argv);
+    t_atom out[4];
+    if (!strcmp(name->s_name, "reset")) {
+      osc_stats_clear(s);
+      return;
+    }
+    if (!name->s_thing) {
+      pd_error(x, "%s: stats: no receive named '%s'", classname,
+               name->s_name);
+      return;
+    }
+    SETFLOAT(&out[0], (t_float)s->blocks);
+    SETFLOAT(&out[1], (t_float)mean);
+    SETFLOAT(&out[2], (t_float)osc_stats_p99(s));
+    SETFLOAT(&out[3], (t_float)s->max);
+    pd_list(name->s_thing, &s_list, 4, out);
+    return;
+  }
+  if (!s->on) {
+    logpost(x, 2, "%s: not timing (`stats 1` starts)", classname);
+  } else if (!s->blocks) {
+    logpost(x, 2, "%s: no blocks timed yet", classname);
+  } else {
+    logpost(x, 2, "%s: %s, %d samples: %llu blocks, ticks per block: "
+            "mean %.0f, p99 %llu, max %llu (mean %.1f per sample)",
+            classname, s->path, s->n, (unsigned long long)s->blocks, mean,
+            (unsigned long long)osc_stats_p99(s),
+            (unsigned long long)s->max, mean / s->n);
+  }
+}
@@ -0,0 +1,64 @@
+// How long each instance's perform routine takes, for finding the expensive
+// ones in a big patch.
+//
+// `stats 1` switches the timing on for an instance: its dsp method then puts
+// a perform routine before and after its own that read the CPU's cycle
+// counter (the TSC on x86, CNTVCT on ARM, nanoseconds elsewhere; "ticks"
+// below). Each block's time goes into a histogram with 4 buckets per octave,
+// so the 99th percentile comes out within 25% without keeping the times
+// themselves. It's all fixed-size and inside the object, and the audio path
+// only adds to it: no allocation, no locks (Pd runs the dsp chain and the
+// messages on one thread) and no system calls. With the timing off, nothing
+// is added to the chain.
+//
+// Messages, for any class that has them:
+//
+//   stats: post the numbers to the Pd console: blocks timed, mean, 99th
+//     percentile and max ticks per block, and which perform routine ran
+//   stats 1 / stats 0: start (from zero) / stop timing
+//   stats reset: start from zero
+//   stats <name>: send `list <blocks> <mean> <p99> <max>` to [receive <name>]
+//
+// The numbers start from zero whenever the dsp method picks a different
+// perform routine or block size, so they always belong to the one reported.
+// Include after m_pd.h.
+
+#ifndef OSC_STATS_H
+#define OSC_STATS_H
+
+#include <stdint.h>
+
+// bucket b < 4 holds b ticks, after that 4 per octave; anything past 2^40
+// ticks (minutes) goes in the last one
+#define OSC_STATS_BUCKETS 160
+
+#define OSC_STATS_PATHSIZE 64
+
+typedef struct _osc_stats {
+  int on;
+  char path[OSC_STATS_PATHSIZE]; // the perform routine, as the dsp method
+                                 // described it
+  int n; // block size
+  uint64_t start; // counter at the start of the block
+  uint64_t blocks;
+  uint64_t sum;
+  uint64_t max;
+  uint32_t hist[OSC_STATS_BUCKETS];
+} t_osc_stats;
+
+// off and empty
+void osc_stats_init(t_osc_stats *s);
+
+// Call these in the dsp method, right before and right after the dsp_add()
+// of the class's own perform routine; they only add anything when the timing
+// is on. `path` says which routine that is (e.g. "simd, constant frequency";
+// it's copied) and n is the block size.
+void osc_stats_dsp_begin(t_osc_stats *s);
+void osc_stats_dsp_end(t_osc_stats *s, const char *path, int n);
+
+// The `stats` message (A_GIMME), see above. `x` and `classname` are for the
+// console.
+void osc_stats_message(t_osc_stats *s, void *x, const char *classname,
+  int argc, t_atom *argv);
+
+#endif
@@ -0,0 +1,88 @@
+// Hard sync (the sync inlets of modern_osc~ and simple_phasor~).
+//
+// The sync input is another oscillator's phase, e.g. a [phasor~], and every
+// time it wraps around the oscillator starts its cycle again. It isn't read
+// at block boundaries like a phase message but per sample, and the restart
+// lands between samples where the master actually wrapped: if the master went
+// from 0.95 to 0.05 in a sample that moved it 0.1, it wrapped half a sample
+// ago, so the restarted phase is already half an increment along. The master
+// is read through the fixed-point phase (phase.h), so only its position in
+// the cycle counts. It wraps when that goes down by way of a step forwards,
+// i.e. less than half a cycle forwards through 0: a master running
+// backwards, like [phasor~ -220], goes down all the time without ever
+// wrapping. NaN or inf in it is no position at all, so the master is taken to
+// stay where it was (rather than jump to 0, which could look like a wrap).
+//
+// Restarting is a jump in the wave, which aliases like a sawtooth's does. The
+// cosine gets a 2-point polyBLEP for it: the jump is smoothed over the sample
+// before and the one after. The one before has already been computed by then,
+// so synced output comes one sample late. (The phasor's own jump isn't
+// smoothed, it's a phase for other objects to read, so neither is its sync.)
+//
+// Include after m_pd.h.
+
+#ifndef OSC_SYNC_H
+#define OSC_SYNC_H
+
+#include "phase.h"
+
+// per channel
+typedef struct _osc_sync {
+  t_osc_phase master; // the sync input at the last sample
+  t_osc_phase inc; // the increment since the last sample
+  float held; // the last sample, held back for osc_sync_blep()
+} t_osc_sync;
+
+static inline void osc_sync_init(t_osc_sync *s)
+{
+  s->master = 0;
+  s->inc = 0;
+  s->held = 0;
+}
+
+// Read the sync input `in` for this sample, with *phase where the oscillator
+// would be now. If the master wrapped since the last sample, *phase is moved
+// to where it is after restarting, *before gets where it was when the master
+// wrapped, *d how long ago that was (in samples, [0, 1]), and this returns 1.
+// Call osc_sync_next() after every sample either way.
+static inline int osc_sync_check(t_osc_sync *s, t_sample in,
+  t_osc_phase *phase, t_osc_phase *before, float *d)
+{
+  t_osc_phase last = s->master;
+  t_osc_phase m = osc_phase_finite(in) ? osc_phase_from_cycles(in) : last;
+  t_osc_phase since;
+
+  s->master = m;
+  if (m >= last || (int32_t)(m - last) <= 0) return 0;
+  // the master's step is m - last through the wrap, m of which came after
+  // it, so it's m / step of a sample ago
+  *d = (float)m / (float)(t_osc_phase)(m - last);
+  since = osc_phase_wrap((double)(int32_t)s->inc * *d);
+  *before = *phase - since;
+  *phase = since;
+  return 1;
+}
+
+static inline void osc_sync_next(t_osc_sync *s, t_osc_phase inc)
+{
+  s->inc = inc;
+}
+
+// The 2-point polyBLEP for a jump of h, d samples ago: the correction for the
+// held sample goes straight onto it, the one for this sample `y` is returned.
+static inline float osc_sync_blep(t_osc_sync *s, float y, float h, float d)
+{
+  float u = 1.0f - d;
+  s->held += h * 0.5f * d * d;
+  return y - h * 0.5f * u * u;
+}
+
+// hold `y` back for a sample, returning the one held before it
+static inline float osc_sync_out(t_osc_sync *s, float y)
+{
+  float out = s->held;
+  s->held = y;
+  return out;
+}
+
+#endif // OSC_SYNC_H
@@ -2,150 +2,184 @@
 
 #include "m_pd.h"
 #include <math.h>
+#include "wavetable.h"
+#include "connect.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+#include "multichannel.h"
 
 // I'm not sure the table needs to be so big. It does need to be a power of 2
 // though
-#define WAVETABLE_SIZE 16384 // 2^14
-
-// 3*2^19
-// When added to a fractional value between 0 and 1, and assigned as a double, the integer part of the
-// result is stored in the high word of the double. This will be used to get the
-// index of the cosine table.
-#define UNITBIT32 1572864.0
-
-#if BYTE_ORDER == LITTLE_ENDIAN
-# define HIOFFSET 1
-# define LOWOFFSET 0
-#else
-# define HIOFFSET 0    /* word offset to find MSB */
-# define LOWOFFSET 1    /* word offset to find LSB */
-#endif
+#define WAVETABLE_BITS 14
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS) // 16384
+
+// The name comes from Pd's osc~, which adds UNITBIT32 (3*2^19) to a double
+// phase so that the integer part lands in the high word and the fraction in
+// the low one, then wraps by overwriting the high word (see
+// pure_data_osc_perform.md). The integer phase from phase.h is the same idea
+// without the union: the table index is the top bits of a uint32_t, the
+// fraction the bits below, and the wrap is plain unsigned overflow.
 
 static t_class *tabfudge_osc_class = NULL;
 // using `float` intentionally here, see pd_floattype.md
-static float *cos_table = NULL; 
-static int table_reference_count = 0; // tracks shared instances of cos_table
-
-union tabfudge {
-  double tf_d;
-  int32_t tf_i[2];
-};
+static const float *cos_table = NULL; // shared wavetable, see wavetable.h
 
 typedef struct _tabfudge_osc {
   t_object x_obj;
-  double x_phase;
-  t_float x_conv;
+  t_osc_phase *x_phases; // one per channel, see multichannel.h
+  int x_nphases; // room in x_phases
+  double x_conv;
   t_inlet *x_freq_inlet;
   t_outlet *x_outlet;
   t_float x_f;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
 } t_tabfudge_osc;
 
 
-static void wavetable_init(void)
+// The channels (see multichannel.h) follow each other in in1 and out1, each
+// with its own phase.
+static t_int *tabfudge_osc_perform(t_int *w)
 {
-  if (cos_table == NULL) {
-    // NOTE: I'm unsure/undecided about WAVETABLE_SIZE + 1; it makes the perform
-    // function a little simpler
-    cos_table = (float *)getbytes(sizeof(float) * (WAVETABLE_SIZE + 1));
-    if (cos_table) {
-      for (int i = 0; i <= WAVETABLE_SIZE; i++) { // <= account for the +1
-        cos_table[i] = cosf((i * 2.0f * (float)M_PI) / (float)WAVETABLE_SIZE);
-      }
-      post("tabfudge_osc~: initialized cosine table of size %d", WAVETABLE_SIZE);
-    } else {
-      post("tabfudge_osc~ error: failed to allocate memory for cosine table");
+  t_tabfudge_osc *x = (t_tabfudge_osc *)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *out1 = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+
+  const float *tab = cos_table;
+  const float *addr;
+  t_sample f1, f2, frac;
+  double conv = x->x_conv;
+
+  if (!tab) return (w+6);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c];
+
+    for (int i = 0; i < n; i++) {
+      // pointer to wavetable + index; the shift does the modulo too
+      addr = tab + osc_phase_index(phase, WAVETABLE_BITS);
+      // the bits below the index are the fractional part
+      frac = osc_phase_frac(phase, WAVETABLE_BITS);
+      // update phase with freq_input * sample rate conversion
+      phase += osc_phase_wrap(*in1++ * conv);
+      f1 = addr[0];
+      // the +1 guard point (WAVETABLE_LINEAR) allows for this
+      // the last wavetable memory slot should hold an equal value to the first
+      // slot
+      f2 = addr[1];
+      // interpolation; unsure why amplitudes don't need to be scaled
+      *out1++ = f1 + frac * (f2 - f1);
     }
+
+    // no wrapping needed at the end, it's already in range
+    x->x_phases[c] = phase;
   }
-  table_reference_count++;
+
+  return (w+6);
 }
 
-static void wavetable_free(void)
+// Same as tabfudge_osc_perform, for when the frequency inlet only gets floats:
+// the increment is computed once instead of once per sample
+static t_int *tabfudge_osc_perform_const(t_int *w)
 {
-  table_reference_count--;
-  if (table_reference_count <= 0 && cos_table != NULL) {
-    // NOTE: if + 1 is removed from the init function, remove it here as well
-    freebytes(cos_table, sizeof(float) * (WAVETABLE_SIZE + 1));
-    cos_table = NULL;
-    post("tabfudge_osc~: freed cosine table");
-    table_reference_count = 0; // just to be safe
+  t_tabfudge_osc *x = (t_tabfudge_osc *)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *out1 = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+
+  const float *tab = cos_table;
+  const float *addr;
+  t_sample f1, f2, frac;
+  t_osc_phase inc = osc_phase_wrap(in1[0] * x->x_conv);
+
+  if (!tab) return (w+6);
+
+  for (int c = 0; c < nchans; c++) {
+    t_osc_phase phase = x->x_phases[c];
+
+    for (int i = 0; i < n; i++) {
+      addr = tab + osc_phase_index(phase, WAVETABLE_BITS);
+      frac = osc_phase_frac(phase, WAVETABLE_BITS);
+      phase += inc;
+      f1 = addr[0];
+      f2 = addr[1];
+      *out1++ = f1 + frac * (f2 - f1);
+    }
+
+    x->x_phases[c] = phase;
   }
+
+  return (w+6);
 }
 
-static t_int *tabfudge_osc_perform(t_int *w)
+// With the double phase the SSE2 kernel lost to the loop above and this was
+// AVX2 only; with integer lanes it wins at both widths.
+static t_int *tabfudge_osc_perform_simd(t_int *w)
 {
   t_tabfudge_osc *x = (t_tabfudge_osc *)(w[1]);
   t_sample *in1 = (t_sample *)(w[2]);
   t_sample *out1 = (t_sample *)(w[3]);
   int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
 
-  float *tab = cos_table;
-  float *addr;
-  t_sample f1, f2, frac;
-  // when assigned to tf.tf_d:
-  // - the high word of this double will be the wavetable index
-  // - subtracting UNITBIT32 will give the fractional part of the index
-  double dphase = x->x_phase + UNITBIT32;
-  int normhipart;
-  union tabfudge tf;
-  float conv = x->x_conv;
-
-  if (!tab) return (w+5);
-
-  tf.tf_d = UNITBIT32; // initialize union 
-  normhipart = tf.tf_i[HIOFFSET]; // save the high word of (double)UNITBIT32
-
-  while (n--) {
-    tf.tf_d = dphase; // see dphase comment
-    // update dphase with freq_input * sample rate conversion
-    dphase += *in1 * conv;
-    // pointer to wavetable + index % wavetable (using bit mask)
-    // performs index extraction and modulo operation in 1 step
-    addr = tab + (tf.tf_i[HIOFFSET] & (WAVETABLE_SIZE - 1));
-    // reset hi word to isolate fractional part
-    tf.tf_i[HIOFFSET] = normhipart;
-    // extract just the fractional part by subtracting UNITBIT32
-    frac = tf.tf_d - UNITBIT32;
-    f1 = addr[0];
-    // the +1 in wavetable_init allows for this
-    // the last wavetable memory slot should hold an equal value to the first
-    // slot
-    f2 = addr[1];
-    // interpolation; unsure why amplitudes don't need to be scaled
-    *out1++ = f1 + frac * (f2 - f1);
+  if (!cos_table) return (w+6);
+
+  for (int c = 0; c < nchans; c++, in1 += n, out1 += n) {
+    x->x_phases[c] = x->x_kernels->lerp(cos_table, WAVETABLE_BITS,
+                                        x->x_phases[c], in1, x->x_conv, out1,
+                                        n);
   }
+  return (w+6);
+}
 
-  // oh no... 
-  // the code below is a more effecient version of
-  // x->x_phase = fmod(dphase - UNITBIT32, WAVETABLE_SIZE);
-  //
-  // establish a reference value that represents one cycle in the bit-encoded
-  // number space
-  // this is a more efficient version of
-  tf.tf_d = UNITBIT32 * WAVETABLE_SIZE;
-  // the high word of the value is stored in normhipart
-  normhipart = tf.tf_i[HIOFFSET];
-  // set tf.tf_d again, this time as current dphase plus one complete cycle
-  // minus UNITBIT32
-  tf.tf_d = dphase + (UNITBIT32 * WAVETABLE_SIZE - UNITBIT32);
-  // reset HIOFFSET to the normhipart of the reference value
-  // effectively performing a modulo operation on the phase
-  tf.tf_i[HIOFFSET] = normhipart;
-  // subtract a full table size from the value
-  // results in a value in the range [0, WAVETABLE_SIZE]
-  x->x_phase = tf.tf_d - UNITBIT32 * WAVETABLE_SIZE;
-
-#if 0 // human readable equivalent
-while (dphase >= WAVETABLE_SIZE) dphase -= WAVETABLE_SIZE;
-while (dphase < 0) dphase += WAVETABLE_SIZE;
-#endif
-
-  return (w+5);
+static t_int *tabfudge_osc_perform_simd_const(t_int *w)
+{
+  t_tabfudge_osc *x = (t_tabfudge_osc *)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *out1 = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+  int nchans = (int)(w[5]);
+  t_osc_phase inc = osc_phase_wrap(in1[0] * x->x_conv);
+
+  if (!cos_table) return (w+6);
+
+  for (int c = 0; c < nchans; c++, out1 += n) {
+    x->x_phases[c] = x->x_kernels->lerp_const(cos_table, WAVETABLE_BITS,
+      x->x_phases[c], inc, out1, n);
+  }
+  return (w+6);
 }
 
 static void tabfudge_osc_dsp(t_tabfudge_osc *x, t_signal **sp)
 {
-  x->x_conv = (float)WAVETABLE_SIZE / sp[0]->s_sr;
-  dsp_add(tabfudge_osc_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+  t_perfroutine perform;
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  int simd = x->x_kernels->width && sp[0]->s_length >= x->x_kernels->width;
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  // as many channels out as the frequency has
+  int nchans = osc_mc_phases(&x->x_phases, &x->x_nphases,
+                             osc_mc_nchans(sp[0]));
+  if (simd)
+    perform = freq_signal ? tabfudge_osc_perform_simd : tabfudge_osc_perform_simd_const;
+  else
+    perform = freq_signal ? tabfudge_osc_perform : tabfudge_osc_perform_const;
+
+  // signal vectors are inlets first, then the outlet: sp[1] belongs to
+  // x_freq_inlet, which nothing reads (the left inlet is the frequency), so
+  // the output is sp[2]
+  osc_mc_setout(&sp[2], nchans);
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(perform, 5, x, sp[0]->s_vec, sp[2]->s_vec, sp[0]->s_length, nchans);
+  osc_stats_dsp_end(&x->x_stats, simd
+    ? (freq_signal ? "simd" : "simd, constant frequency")
+    : (freq_signal ? "scalar" : "scalar, constant frequency"),
+    sp[0]->s_length * nchans);
 }
 
 static void tabfudge_osc_free(t_tabfudge_osc *x)
@@ -158,7 +192,15 @@ static void tabfudge_osc_free(t_tabfudge_osc *x)
     outlet_free(x->x_outlet);
   }
 
-  wavetable_free();
+  osc_mc_freephases(x->x_phases, x->x_nphases);
+
+  wavetable_release(cos_table);
+}
+
+static void tabfudge_osc_kernel(t_tabfudge_osc *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "tabfudge_osc~", &x->x_kernels, s))
+    canvas_update_dsp();
 }
 
 static void *tabfudge_osc_new(t_floatarg f)
@@ -166,29 +208,43 @@ static void *tabfudge_osc_new(t_floatarg f)
   t_tabfudge_osc *x = (t_tabfudge_osc *)pd_new(tabfudge_osc_class);
 
   x->x_f = f > 0 ? (t_float)f : (t_float)220.0;
-  x->x_phase = (double)0.0;
+  x->x_phases = NULL;
+  x->x_nphases = 0;
+  osc_mc_phases(&x->x_phases, &x->x_nphases, 1);
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_kernels = osc_kernels_best();
 
   x->x_freq_inlet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   pd_float((t_pd *)x->x_freq_inlet, x->x_f);
 
   x->x_outlet = outlet_new(&x->x_obj, &s_signal);
 
-  wavetable_init();
+  cos_table = wavetable_cos_acquire(WAVETABLE_SIZE, WAVETABLE_LINEAR);
 
   return (void *)x;
 }
 
+static void tabfudge_osc_stats(t_tabfudge_osc *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "tabfudge_osc~", argc, argv);
+}
+
 void tabfudge_osc_tilde_setup(void)
 {
   tabfudge_osc_class = class_new(gensym("tabfudge_osc~"),
                                  (t_newmethod)tabfudge_osc_new,
                                  (t_method)tabfudge_osc_free,
                                  sizeof(t_tabfudge_osc),
-                                 CLASS_DEFAULT,
+                                 CLASS_DEFAULT | OSC_MC_CLASS,
                                  A_DEFFLOAT, 0);
 
   class_addmethod(tabfudge_osc_class, (t_method)tabfudge_osc_dsp, gensym("dsp"), A_CANT, 0);
   CLASS_MAINSIGNALIN(tabfudge_osc_class, t_tabfudge_osc, x_f);
+  class_addmethod(tabfudge_osc_class, (t_method)tabfudge_osc_kernel, gensym("kernel"),
+                  A_DEFSYM, 0);
+  class_addmethod(tabfudge_osc_class, (t_method)tabfudge_osc_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
 
 
@@ -1,33 +1,45 @@
 #include "m_pd.h"
 #include <math.h>
+#include <stdio.h>
+#include "connect.h"
+#include "phase.h"
+#include "blep.h"
+#include "kernels.h"
+#include "stats.h"
+#include "multichannel.h"
+#include "events.h"
 
 static t_class *tri_phase_class = NULL;
 
-/*
- * See `simple_phasor.c` for detailed notes
- */
-#define UNITBIT32 1572864.  /* 3*2^19; bit 32 has place value 1 */
-
-// I suspect this is already set via the Pure Data environment.
-#if BYTE_ORDER == LITTLE_ENDIAN
-# define HIOFFSET 1
-# define LOWOFFSET 0
+// for the perform routines' bodies, see tri_phase_perform_body()
+#ifdef __GNUC__
+# define TRI_PHASE_INLINE static inline __attribute__((always_inline))
 #else
-# define HIOFFSET 0    /* word offset to find MSB */
-# define LOWOFFSET 1    /* word offset to find LSB */
+# define TRI_PHASE_INLINE static inline
 #endif
 
-union tabfudge
-{
-    double tf_d;
-    int32_t tf_i[2];
-};
+/*
+ * The phase is the fixed-point one from phase.h, see `simple_phasor~.c`
+ *
+ * `bandlimit 1` rounds off the triangle's corners with polyBLAMP (blep.h)
+ * before the folding. The folding adds corners of its own, which are left
+ * alone. Without it, the triangle comes from the SIMD kernels (kernels.h)
+ * when there are some.
+ *
+ * With multichannel signals (multichannel.h) each channel of the frequency
+ * input has a phase of its own; a float to the phase inlet sets them all.
+ *
+ * The phase, softness, low and hi messages take effect on the sample their
+ * logical time falls on, not at the next block (events.h), so a sequencer's
+ * resets are sample-accurate at the usual block size.
+ */
 
 typedef struct _tri_phase
 {
   t_object x_obj;
-  double x_phase;
-  t_float x_conv;
+  t_osc_phase *x_phases; // one per channel
+  int x_nphases; // room in x_phases
+  double x_conv;
   t_float x_f;
 
   t_float x_low;
@@ -42,143 +54,428 @@ typedef struct _tri_phase
   t_inlet *in_3; // fold_threshold
   t_inlet *in_4; // fold softness
   t_inlet *in_5; // phase
+
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  int x_bandlimit;
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
+  t_osc_events x_events; // see events.h
 } t_tri_phase;
 
-static float tri_phase_fold(float sample, float threshold, float softness)
-{
-  float transition_region = softness * threshold;
-  if (transition_region > 0.0f) {
-    while (1) {
-      if (sample > threshold) {
-        float overshoot = sample - threshold;
-        if (overshoot <= transition_region) {
-          // apply cubic curve in transition region
-          float t = overshoot / transition_region;
-          float fold_amount = t*t * (3.0f - 2.0f*t); // cubic hermite
-          sample = threshold - fold_amount * overshoot;
-          break;
-        } else {
-          // regular fold, but account for transition region
-          sample = 2.0f * threshold - sample;
-        }
-      } else if (sample < -threshold)
-      {
-        float overshoot = -threshold - sample;
-        if (overshoot <= transition_region) {
-          float t = overshoot / transition_region;
-          float fold_amount = t*t * (3.0f - 2.0f*t); // cubic hermite
-          sample = -threshold + fold_amount * overshoot;
-          break;
-        } else {
-          // regular fold, but account for transition region
-          sample = -2.0f * threshold - sample;
-        }
-      } else {
-        break; // no folding needed
-      }
+// Folding, worked out in one go instead of bouncing the sample back and forth
+// between +-threshold until it lands, which took longer the further out it
+// started (forever, nearly, with a tiny threshold and a big lo/hi range).
+// No branches either, so it vectorizes.
+//
+// Past the threshold, every 2 * threshold of overshoot is one more bounce off
+// alternating edges. A sample that ends up within `softness * threshold` past
+// an edge bends back along a cubic instead of the sharp corner; one further
+// out is reflected straight back. Everything that only depends on the
+// softness and the threshold is in t_tri_fold: tri_fold_init() once per block
+// for the softness, tri_fold_set() for the threshold, once per sample only if
+// the threshold inlet has a signal (and then it's one division).
+typedef struct _tri_fold {
+  float softness;
+  float rsoftness; // 1 / softness, or 0 for a hard fold
+  float threshold;
+  float soft; // size of the soft region, softness * threshold
+  float span; // the most a sample can be past the last edge it bounces off
+  float rperiod; // 1 / (2 * threshold)
+  float rsoft; // 1 / soft, or 0 for a hard fold
+} t_tri_fold;
+
+// threshold 0 would be a division by 0; this small it folds to silence
+#define TRI_FOLD_MINTHRESH 1e-9f
+
+static inline void tri_fold_init(t_tri_fold *f, float softness)
+{
+  f->softness = softness > 0.0f ? softness : 0.0f;
+  f->rsoftness = softness > 0.0f ? 1.0f / softness : 0.0f;
+}
 
-    }
-  } else {
-    // regular hard folding
-    while (sample > threshold) {
-      sample = 2.0f * threshold - sample;
-    }
-    while (sample < -threshold) {
-      sample = -2.0f * threshold - sample;
-    }
-  }
+static inline void tri_fold_set(t_tri_fold *f, float threshold)
+{
+  threshold = threshold > TRI_FOLD_MINTHRESH ? threshold : TRI_FOLD_MINTHRESH;
+  f->threshold = threshold;
+  f->soft = f->softness * threshold;
+  // the soft region can be wider than the gap between the edges, and then a
+  // sample within it of the edge it's past doesn't bounce any further
+  f->span = f->soft > 2.0f * threshold ? f->soft : 2.0f * threshold;
+  f->rperiod = 0.5f / threshold;
+  f->rsoft = f->rsoftness * (2.0f * f->rperiod);
+}
 
-  return sample;
+static inline float tri_fold(const t_tri_fold *f, float sample)
+{
+  float threshold = f->threshold;
+  float a = fabsf(sample);
+  float over = a - threshold;
+
+  // bounces off an edge before it lands: ceil((over - span) / 2t), at least
+  // 0. Capped where floats stop counting whole bounces; the clamp on `r`
+  // below keeps the output in range even then.
+  float x = (over - f->span) * f->rperiod;
+  x = x > 0.0f ? x : 0.0f;
+  x = x < 4194304.0f ? x : 4194304.0f;
+  int k = (int)x;
+  k += (float)k < x;
+
+  // how far past the last edge it is
+  float r = over - (float)k * (2.0f * threshold);
+  r = r > 0.0f ? r : 0.0f;
+  r = r < f->span ? r : f->span;
+
+  // cubic hermite in the soft region, a straight reflection past it
+  float t = r * f->rsoft;
+  float bend = r < f->soft ? t * t * (3.0f - 2.0f * t) : 1.0f;
+  float y = threshold - bend * r;
+
+  // every bounce flips the side, and negative samples fold the other way
+  y = (k & 1) ? -y : y;
+  y = sample < 0.0f ? -y : y;
+  return a > threshold ? y : sample;
 }
 
+// the messages that go through x_events
+enum { TRI_PHASE_FT1, TRI_PHASE_SOFTNESS, TRI_PHASE_LOW, TRI_PHASE_HI };
 
-static t_int *tri_phase_perform(t_int *w)
+static void tri_phase_apply(void *owner, int type, t_float f)
 {
-  t_tri_phase *x = (t_tri_phase *)(w[1]);
-  t_sample *in1 = (t_float *)(w[2]); // frequency input
-  t_sample *in2 = (t_float *)(w[3]); // peak input
-  t_sample *in3 = (t_float *)(w[4]); // fold threshold input
-  t_sample *out = (t_float *)(w[5]); // output
-  int n = (int)(w[6]);
+  t_tri_phase *x = (t_tri_phase *)owner;
+  switch (type) {
+  case TRI_PHASE_FT1:
+    for (int c = 0; c < x->x_nphases; c++)
+      x->x_phases[c] = osc_phase_from_cycles(f);
+    break;
+  case TRI_PHASE_SOFTNESS:
+    x->x_softness = f;
+    break;
+  case TRI_PHASE_LOW:
+    x->x_low = f;
+    x->x_range = x->x_hi - f;
+    break;
+  case TRI_PHASE_HI:
+    x->x_hi = f;
+    x->x_range = f - x->x_low;
+    break;
+  }
+}
+
+// The first three flags say which of the signal inlets actually have a signal
+// connected, the last one whether to band-limit. They're always constants (see
+// the performs below), so every combination compiles to its own loop, and the
+// inlets that only get floats are read, clamped etc. once per block instead of
+// once per sample.
+static inline void tri_phase_perform_chan(t_tri_phase *x, int c,
+                                          t_sample *in1, t_sample *in2,
+                                          t_sample *in3, t_sample *out, int n,
+                                          const int freq_signal,
+                                          const int peak_signal,
+                                          const int thresh_signal,
+                                          const int bl)
+{
+  int nblock = n;
+  t_sample *out0 = out;
 
-  double dphase = x->x_phase + (double)UNITBIT32;
-  union tabfudge tf;
-  int normhipart;
-  t_float conv = x->x_conv;
+  t_osc_phase phase = x->x_phases[c];
+  double conv = x->x_conv;
   // hardcoded for now
   float low = x->x_low;
   float range = x->x_range;
 
   float softness = x->x_softness;
 
-  tf.tf_d = UNITBIT32;
-  normhipart = tf.tf_i[HIOFFSET];
-  tf.tf_d = dphase;
+  // values for the inlets that don't change during the block. With a constant
+  // peak the two slopes can be turned into multiplications
+  t_osc_phase inc = osc_phase_wrap(in1[0] * conv);
+  float peak = in2[0];
+  peak = (peak < 0.0f) ? 0.0f : (peak > 1.0f) ? 1.0f : peak;
+  float rise = (peak > 0.0f) ? 1.0f / peak : 0.0f;
+  float fall = (peak < 1.0f) ? 1.0f / (1.0f - peak) : 0.0f;
+  float threshold = in3[0];
+  threshold = (threshold < 0.0f) ? 0.0f : threshold;
+  t_tri_fold fold;
+  tri_fold_init(&fold, softness);
+  tri_fold_set(&fold, threshold);
+
+  // for band-limiting (unused otherwise); only needs setting again per sample
+  // if the frequency or the peak is a signal
+  t_osc_tri tri;
+  osc_tri_init(&tri);
+  osc_tri_set(&tri, peak, (float)(int32_t)inc * (1.0f / 4294967296.0f));
 
   while (n--)
   {
-    float peak = *in2++;
-    peak = (peak < 0.0f) ? 0.0f : (peak > 1.0f) ? 1.0f : peak;
+    if (peak_signal) {
+      peak = *in2++;
+      peak = (peak < 0.0f) ? 0.0f : (peak > 1.0f) ? 1.0f : peak;
+    }
 
-    float threshold = *in3++;
-    threshold = (threshold < 0.0f) ? 0.0f : threshold;
+    if (thresh_signal) {
+      threshold = *in3++;
+      threshold = (threshold < 0.0f) ? 0.0f : threshold;
+      tri_fold_set(&fold, threshold);
+    }
 
     // update phase
-    tf.tf_i[HIOFFSET] = normhipart;
-    dphase += *in1++ * conv;
-    float ph = tf.tf_d - UNITBIT32;
+    t_osc_phase p = phase;
+    float ph = osc_phase_unit(p);
+    if (freq_signal) inc = osc_phase_wrap(*in1++ * conv);
+    phase += inc;
 
     // generate triangle wave with variable peak
     float tri_value;
-    if (ph < peak) {
-      tri_value = (peak > 0.0f) ? ph / peak : 0.0f;
-    } else if (peak < 1.0f) {
-      tri_value = (1.0f - peak > 0.0f) ? (1.0f - ph) / (1.0f - peak) : 0.0f;
+    if (bl) {
+      if (freq_signal || peak_signal) {
+        osc_tri_set(&tri, peak, (float)(int32_t)inc * (1.0f / 4294967296.0f));
+      }
+      tri_value = osc_tri_blamp(&tri, p);
+    } else if (!peak_signal) {
+      // ph is in [0, 1), so ph < peak means peak > 0; the other side gets 0
+      // from `fall` when peak is 1
+      tri_value = (ph < peak) ? ph * rise : (1.0f - ph) * fall;
     } else {
-      tri_value = 0.0f;
+      // one division, see triangle~.c
+      int up = ph < peak;
+      tri_value = (up ? ph : 1.0f - ph) / (up ? peak : 1.0f - peak);
     }
 
     // scale to output range
     float s = low + tri_value * range;
 
-    // apply wave folding
-    s = tri_phase_fold(s, threshold, softness);
+    // apply wave folding, here only if the threshold changes every sample
+    if (thresh_signal) s = tri_fold(&fold, s);
 
     *out++ = s;
-    tf.tf_d = dphase;
   }
 
-  tf.tf_i[HIOFFSET] = normhipart;
-  x->x_phase = tf.tf_d - UNITBIT32;
-  return (w+7);
+  // otherwise it's a loop of its own, which vectorizes (this is after the
+  // inputs are read, so it doesn't matter if Pd gave `out` the same buffer)
+  if (!thresh_signal) {
+    for (int i = 0; i < nblock; i++) out0[i] = tri_fold(&fold, out0[i]);
+  }
+
+  x->x_phases[c] = phase;
+}
+
+// w[7] channels of frequency and output (see multichannel.h), w[8] of peak
+// and w[9] of threshold. The block is split where queued messages are due.
+// With tri_phase_perform_chan() in it, this is more than GCC inlines on its
+// own, and the flags are only sure to become separate loops if it is.
+TRI_PHASE_INLINE t_int *tri_phase_perform_body(t_int *w, const int freq_signal,
+                                            const int peak_signal,
+                                            const int thresh_signal,
+                                            const int bl)
+{
+  t_tri_phase *x = (t_tri_phase *)(w[1]);
+  t_sample *in1 = (t_float *)(w[2]); // frequency input
+  t_sample *in2 = (t_float *)(w[3]); // peak input
+  t_sample *in3 = (t_float *)(w[4]); // fold threshold input
+  t_sample *out = (t_float *)(w[5]); // output
+  int n = (int)(w[6]);
+  int nchans = (int)(w[7]);
+  int peakchans = (int)(w[8]);
+  int threshchans = (int)(w[9]);
+
+  for (int i = 0, end; i < n; i = end) {
+    end = osc_events_run(&x->x_events, i, n, x, tri_phase_apply);
+    for (int c = 0; c < nchans; c++) {
+      tri_phase_perform_chan(x, c, in1 + c * n + i,
+                             osc_mc_chan(in2, peakchans, n, c) + i,
+                             osc_mc_chan(in3, threshchans, n, c) + i,
+                             out + c * n + i, end - i, freq_signal,
+                             peak_signal, thresh_signal, bl);
+    }
+  }
+  osc_events_done(&x->x_events);
+  return (w+10);
+}
+
+// Without band-limiting, with the SIMD kernels (see kernels.h). The kernel
+// reads each vector of its inputs before it writes the same samples of
+// `out`, so it doesn't matter if Pd gave them the same buffer. A threshold
+// signal, though, has to be read before the kernel writes over it, so then it
+// goes a chunk at a time through `buf`. The flags are arguments here rather
+// than compiled in: checking them costs nothing next to the kernel.
+#define TRI_PHASE_CHUNK 64
+
+static void tri_phase_perform_simd_chan(t_tri_phase *x, int c,
+                                        t_sample *in1, t_sample *in2,
+                                        t_sample *in3, t_sample *out, int n,
+                                        int freq_signal, int peak_signal,
+                                        int thresh_signal)
+{
+  const t_osc_kernels *k = x->x_kernels;
+  t_osc_phase phase = x->x_phases[c];
+  t_osc_phase inc = osc_phase_wrap(in1[0] * x->x_conv);
+  float peak = in2[0];
+  float threshold = in3[0];
+  t_tri_fold fold;
+
+  threshold = (threshold < 0.0f) ? 0.0f : threshold;
+  tri_fold_init(&fold, x->x_softness);
+  tri_fold_set(&fold, threshold);
+
+  if (!thresh_signal) {
+    phase = k->tri_phasor(phase, freq_signal ? in1 : NULL, x->x_conv, inc,
+      peak_signal ? in2 : NULL, peak, x->x_low, x->x_range, out, n);
+    for (int i = 0; i < n; i++) out[i] = tri_fold(&fold, out[i]);
+    x->x_phases[c] = phase;
+    return;
+  }
+
+  for (int i = 0; i < n; i += TRI_PHASE_CHUNK) {
+    int m = n - i < TRI_PHASE_CHUNK ? n - i : TRI_PHASE_CHUNK;
+    t_sample buf[TRI_PHASE_CHUNK];
+
+    phase = k->tri_phasor(phase, freq_signal ? in1 + i : NULL, x->x_conv, inc,
+      peak_signal ? in2 + i : NULL, peak, x->x_low, x->x_range, buf, m);
+    for (int j = 0; j < m; j++) {
+      threshold = in3[i + j];
+      threshold = (threshold < 0.0f) ? 0.0f : threshold;
+      tri_fold_set(&fold, threshold);
+      out[i + j] = tri_fold(&fold, buf[j]);
+    }
+  }
+
+  x->x_phases[c] = phase;
+}
+
+// the channels as in tri_phase_perform_body, in w[10] to w[12]
+static t_int *tri_phase_perform_simd(t_int *w)
+{
+  t_tri_phase *x = (t_tri_phase *)(w[1]);
+  t_sample *in1 = (t_sample *)(w[2]);
+  t_sample *in2 = (t_sample *)(w[3]);
+  t_sample *in3 = (t_sample *)(w[4]);
+  t_sample *out = (t_sample *)(w[5]);
+  int n = (int)(w[6]);
+  int freq_signal = (int)(w[7]);
+  int peak_signal = (int)(w[8]);
+  int thresh_signal = (int)(w[9]);
+  int nchans = (int)(w[10]);
+  int peakchans = (int)(w[11]);
+  int threshchans = (int)(w[12]);
+
+  for (int i = 0, end; i < n; i = end) {
+    end = osc_events_run(&x->x_events, i, n, x, tri_phase_apply);
+    for (int c = 0; c < nchans; c++) {
+      tri_phase_perform_simd_chan(x, c, in1 + c * n + i,
+                                  osc_mc_chan(in2, peakchans, n, c) + i,
+                                  osc_mc_chan(in3, threshchans, n, c) + i,
+                                  out + c * n + i, end - i, freq_signal,
+                                  peak_signal, thresh_signal);
+    }
+  }
+  osc_events_done(&x->x_events);
+  return (w + 13);
 }
 
+// tri_phase_perform_FPTB, with F, P and T 1 if the frequency, peak and
+// threshold inlets have a signal connected and B 1 when band-limiting
+#define TRI_PHASE_PERFORM(f, p, t, b) \
+  static t_int *tri_phase_perform_##f##p##t##b(t_int *w) \
+  { \
+    return tri_phase_perform_body(w, f, p, t, b); \
+  }
+
+#define TRI_PHASE_PERFORMS(f, p, t) \
+  TRI_PHASE_PERFORM(f, p, t, 0) \
+  TRI_PHASE_PERFORM(f, p, t, 1)
+
+TRI_PHASE_PERFORMS(0, 0, 0)
+TRI_PHASE_PERFORMS(0, 0, 1)
+TRI_PHASE_PERFORMS(0, 1, 0)
+TRI_PHASE_PERFORMS(0, 1, 1)
+TRI_PHASE_PERFORMS(1, 0, 0)
+TRI_PHASE_PERFORMS(1, 0, 1)
+TRI_PHASE_PERFORMS(1, 1, 0)
+TRI_PHASE_PERFORMS(1, 1, 1)
+
+static const t_perfroutine tri_phase_performs[2][2][2][2] = {
+  {{{tri_phase_perform_0000, tri_phase_perform_0001},
+    {tri_phase_perform_0010, tri_phase_perform_0011}},
+   {{tri_phase_perform_0100, tri_phase_perform_0101},
+    {tri_phase_perform_0110, tri_phase_perform_0111}}},
+  {{{tri_phase_perform_1000, tri_phase_perform_1001},
+    {tri_phase_perform_1010, tri_phase_perform_1011}},
+   {{tri_phase_perform_1100, tri_phase_perform_1101},
+    {tri_phase_perform_1110, tri_phase_perform_1111}}},
+};
+
 static void tri_phase_dsp(t_tri_phase *x, t_signal **sp)
 {
-  x->x_conv = 1.0 / sp[0]->s_sr;
-  dsp_add(tri_phase_perform, 6, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec, (t_int)sp[0]->s_length);
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+  int peak_signal = osc_signal_connected(&x->x_obj, x->x_glist, 1);
+  int thresh_signal = osc_signal_connected(&x->x_obj, x->x_glist, 2);
+  int simd = !x->x_bandlimit && x->x_kernels->width
+    && sp[0]->s_length >= x->x_kernels->width;
+  char path[OSC_STATS_PATHSIZE];
+  // the output gets as many channels as the frequency
+  int nchans = osc_mc_phases(&x->x_phases, &x->x_nphases,
+                             osc_mc_nchans(sp[0]));
+  int peakchans = osc_mc_nchans(sp[1]);
+  int threshchans = osc_mc_nchans(sp[2]);
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  osc_events_flush(&x->x_events, x, tri_phase_apply);
+  osc_events_dsp(&x->x_events, sp[0]->s_sr, sp[0]->s_length);
+  osc_mc_setout(&sp[3], nchans);
+  osc_stats_dsp_begin(&x->x_stats);
+  if (simd) {
+    dsp_add(tri_phase_perform_simd, 12, x, sp[0]->s_vec, sp[1]->s_vec,
+            sp[2]->s_vec, sp[3]->s_vec, (t_int)sp[0]->s_length,
+            (t_int)freq_signal, (t_int)peak_signal, (t_int)thresh_signal,
+            (t_int)nchans, (t_int)peakchans, (t_int)threshchans);
+  } else {
+    dsp_add(tri_phase_performs[freq_signal][peak_signal][thresh_signal]
+              [x->x_bandlimit],
+            9, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec,
+            (t_int)sp[0]->s_length, (t_int)nchans, (t_int)peakchans,
+            (t_int)threshchans);
+  }
+  snprintf(path, sizeof(path), "signals:%s%s%s%s%s",
+           freq_signal ? " frequency" : "", peak_signal ? " peak" : "",
+           thresh_signal ? " threshold" : "",
+           freq_signal || peak_signal || thresh_signal ? "" : " none",
+           x->x_bandlimit ? ", bandlimited" : simd ? ", simd" : "");
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length * nchans);
 }
 
 static void tri_phase_ft1(t_tri_phase *x, t_float f)
 {
-  x->x_phase = (double)f;
+  osc_events_add(&x->x_events, x, tri_phase_apply, TRI_PHASE_FT1, f);
 }
 
 static void tri_phase_softness(t_tri_phase *x, t_float f)
 {
-  x->x_softness = f;
+  osc_events_add(&x->x_events, x, tri_phase_apply, TRI_PHASE_SOFTNESS, f);
+}
+
+// switching the perform routine needs the DSP chain rebuilt
+static void tri_phase_bandlimit(t_tri_phase *x, t_floatarg f)
+{
+  int bl = f != 0;
+  if (bl != x->x_bandlimit) {
+    x->x_bandlimit = bl;
+    canvas_update_dsp();
+  }
+}
+
+static void tri_phase_kernel(t_tri_phase *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "tri_phase~", &x->x_kernels, s))
+    canvas_update_dsp();
 }
 
 static void tri_phase_low(t_tri_phase *x, t_floatarg f)
 {
-  x->x_low = f;
-  x->x_range = x->x_hi - f;
+  osc_events_add(&x->x_events, x, tri_phase_apply, TRI_PHASE_LOW, f);
 }
 
 static void tri_phase_hi(t_tri_phase *x, t_floatarg f)
 {
-  x->x_hi = f;
-  x->x_range = f - x->x_low;
+  osc_events_add(&x->x_events, x, tri_phase_apply, TRI_PHASE_HI, f);
 }
 
 static void tri_phase_free(t_tri_phase *x)
@@ -187,16 +484,24 @@ static void tri_phase_free(t_tri_phase *x)
   inlet_free(x->in_3);
   inlet_free(x->in_4);
   inlet_free(x->in_5);
+  osc_mc_freephases(x->x_phases, x->x_nphases);
 }
 
 static void *tri_phase_new(t_floatarg f)
 {
   t_tri_phase *x = (t_tri_phase *)pd_new(tri_phase_class);
   x->x_f = f;
-  x->x_phase = 0;
+  x->x_phases = NULL;
+  x->x_nphases = 0;
+  osc_mc_phases(&x->x_phases, &x->x_nphases, 1);
   x->x_conv = 0;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_bandlimit = 0;
+  x->x_kernels = osc_kernels_best();
+  osc_events_init(&x->x_events);
 
-  // TODO: make configurable
+  // the output range, see the low and hi messages
   x->x_low = -1.0;
   x->x_hi = 1.0;
 
@@ -225,13 +530,18 @@ static void *tri_phase_new(t_floatarg f)
   return (void *)x;
 }
 
+static void tri_phase_stats(t_tri_phase *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "tri_phase~", argc, argv);
+}
+
 void tri_phase_tilde_setup(void)
 {
   tri_phase_class = class_new(gensym("tri_phase~"),
                               (t_newmethod)tri_phase_new,
                               (t_method)tri_phase_free,
                               sizeof(t_tri_phase),
-                              CLASS_DEFAULT,
+                              CLASS_DEFAULT | OSC_MC_CLASS,
                               A_DEFFLOAT, 0);
 
   CLASS_MAINSIGNALIN(tri_phase_class, t_tri_phase, x_f);
@@ -241,4 +551,14 @@ void tri_phase_tilde_setup(void)
                   gensym("ft1"), A_FLOAT, 0);
   class_addmethod(tri_phase_class, (t_method)tri_phase_softness,
                   gensym("softness"), A_FLOAT, 0);
+  class_addmethod(tri_phase_class, (t_method)tri_phase_low,
+                  gensym("low"), A_FLOAT, 0);
+  class_addmethod(tri_phase_class, (t_method)tri_phase_hi,
+                  gensym("hi"), A_FLOAT, 0);
+  class_addmethod(tri_phase_class, (t_method)tri_phase_bandlimit,
+                  gensym("bandlimit"), A_FLOAT, 0);
+  class_addmethod(tri_phase_class, (t_method)tri_phase_kernel,
+                  gensym("kernel"), A_DEFSYM, 0);
+  class_addmethod(tri_phase_class, (t_method)tri_phase_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
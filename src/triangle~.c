@@ -1,7 +1,21 @@
 // Copied (by hand) from the cyclone library. There may be typos.
+//
+// `bandlimit 1` (or @bandlimit 1 as an argument) rounds off the corners with
+// polyBLAMP (see blep.h), so high notes don't alias. The phase input doesn't
+// say how fast it's moving, so that's taken from the difference between
+// consecutive input samples.
+//
+// Without it, the shaping runs in the SIMD kernels (osc_simd_tri(), see
+// kernels.h) when there are some.
 
 #include "m_pd.h"
 #include <string.h>
+#include "connect.h"
+#include "phase.h"
+#include "blep.h"
+#include "kernels.h"
+#include "stats.h"
+#include "multichannel.h"
 
 #define TRIANGLE_DEFPEAK 0.5
 #define TRIANGLE_DEFLO -1.0
@@ -15,6 +29,13 @@ typedef struct _triangle {
   t_float x_f; // why t_float here and float above?
   t_inlet *x_peaklet;
   t_outlet *x_outlet;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  int x_bandlimit;
+  t_osc_phase *x_last; // previous input, to tell the increment when
+                       // bandlimiting; one per channel (multichannel.h)
+  int x_nlast; // room in x_last
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
 } t_triangle;
 
 static t_class *triangle_class = NULL;
@@ -31,50 +52,189 @@ static void triangle_hi(t_triangle *x, t_floatarg f)
   x->x_range = f - x->x_low;
 }
 
-static t_int *triangle_perform(t_int *w)
+// peak_signal and bl are constants in all the performs below, so the compiler
+// builds one loop that follows the peak inlet and one that only looks at it
+// once, each with and without the band-limiting
+static inline void triangle_perform_chan(t_triangle *x, int c, int nblock,
+                                         t_float *in1, t_float *in2,
+                                         t_float *out, const int peak_signal,
+                                         const int bl)
 {
-  t_triangle *x = (t_triangle *)(w[1]);
-  int nblock = (int)(w[2]);
-  t_float *in1 = (t_float *)(w[3]);
-  t_float *in2 = (t_float *)(w[4]);
-  t_float *out = (t_float *)(w[5]);
   float low = x->x_low;
   float range = x->x_range;
 
-  while (nblock --) {
-    float ph = *in1++;
-    float peakph = *in2++;
+  // a peak that's only set by floats is clamped once, and the divisions below
+  // become multiplications
+  float peakph = *in2;
+  if (peakph < 0.0) {
+    peakph = 0.0;
+  } else if (peakph > 1.0) {
+    peakph = 1.0;
+  }
+  float rise = peakph > 0.0 ? 1.0 / peakph : 0.0;
+  float fall = peakph < 1.0 ? 1.0 / (1.0 - peakph) : 0.0;
 
-    if (ph < 0.0) {
-      ph -= (int)ph - 1.0; // negative samples get converted to 1
-    } else if (ph > 1.0) {
-      ph -= (int)ph; // samples > 1 get converted to 0
-    }
+  if (bl) {
+    t_osc_phase last = x->x_last[c];
+    t_osc_tri tri;
+    osc_tri_init(&tri);
+    while (nblock--) {
+      t_osc_phase p = osc_phase_from_cycles(*in1++);
+      // the input's step since the last sample, the short way round
+      float dt = (float)(int32_t)(p - last) * (1.0f / 4294967296.0f);
+      last = p;
 
-    if (peakph < 0.0) {
-      peakph = 0.0;
-    } else if (peakph > 1.0) {
-      peakph = 1.0;
+      if (peak_signal) {
+        peakph = *in2++;
+        peakph = peakph < 0.0f ? 0.0f : peakph > 1.0f ? 1.0f : peakph;
+      }
+      osc_tri_set(&tri, peakph, dt);
+      *out++ = low + osc_tri_blamp(&tri, p) * range;
     }
+    x->x_last[c] = last;
+    return;
+  }
 
-    if (ph < peakph) {
-      ph /= peakph;
-    } else if (peakph < 1.0) {
-      ph = (1.0 - ph) / (1.0 - peakph);
-    } else {
-      ph = 0.0;
+  while (nblock --) {
+    // wrap into [0, 1) through the fixed-point phase (phase.h) instead of
+    // branching on the sign: -0.25 becomes 0.75, 1.25 becomes 0.25. Whole
+    // numbers all go to 0 (the old code left 1 and -1 at 1), which only makes
+    // a difference right at the jump of a peak 0 sawtooth.
+    float ph = osc_phase_unit(osc_phase_from_cycles(*in1++));
+
+    if (!peak_signal) {
+      // ph is in [0, 1) here, so ph < peakph means peakph > 0
+      *out++ = low + (ph < peakph ? ph * rise : (1.0f - ph) * fall) * range;
+      continue;
     }
 
+    peakph = *in2++;
+    peakph = peakph < 0.0f ? 0.0f : peakph > 1.0f ? 1.0f : peakph;
+
+    // one division for either slope, picking what to divide first. Neither
+    // side can divide by 0: ph < peakph means peakph > 0, and 1 - peakph is
+    // only 0 when ph < 1 = peakph.
+    int up = ph < peakph;
+    ph = (up ? ph : 1.0f - ph) / (up ? peakph : 1.0f - peakph);
+
     *out++ = low + ph * range;
   }
+}
+
+// the phase and the output have w[6] channels (see multichannel.h), the peak
+// w[7]
+static inline t_int *triangle_perform_body(t_int *w, const int peak_signal,
+                                           const int bl)
+{
+  t_triangle *x = (t_triangle *)(w[1]);
+  int n = (int)(w[2]);
+  t_float *in1 = (t_float *)(w[3]);
+  t_float *in2 = (t_float *)(w[4]);
+  t_float *out = (t_float *)(w[5]);
+  int nchans = (int)(w[6]);
+  int peakchans = (int)(w[7]);
+
+  for (int c = 0; c < nchans; c++) {
+    triangle_perform_chan(x, c, n, in1 + c * n,
+                          osc_mc_chan(in2, peakchans, n, c), out + c * n,
+                          peak_signal, bl);
+  }
+  return (w + 8);
+}
+
+static t_int *triangle_perform(t_int *w)
+{
+  return triangle_perform_body(w, 1, 0);
+}
+
+static t_int *triangle_perform_const_peak(t_int *w)
+{
+  return triangle_perform_body(w, 0, 0);
+}
+
+static t_int *triangle_perform_bl(t_int *w)
+{
+  return triangle_perform_body(w, 1, 1);
+}
+
+static t_int *triangle_perform_bl_const_peak(t_int *w)
+{
+  return triangle_perform_body(w, 0, 1);
+}
+
+// without band-limiting, a vector of samples at a time (see kernels.h)
+static t_int *triangle_perform_simd(t_int *w)
+{
+  t_triangle *x = (t_triangle *)(w[1]);
+  int n = (int)(w[2]);
+  t_sample *in1 = (t_sample *)(w[3]);
+  t_sample *in2 = (t_sample *)(w[4]);
+  t_sample *out = (t_sample *)(w[5]);
+  int nchans = (int)(w[6]);
+  int peakchans = (int)(w[7]);
+
+  for (int c = 0; c < nchans; c++, in1 += n, out += n) {
+    x->x_kernels->tri(in1, osc_mc_chan(in2, peakchans, n, c), 0, x->x_low,
+                      x->x_range, out, n);
+  }
+  return (w + 8);
+}
 
-  return (w + 6);
+static t_int *triangle_perform_simd_const_peak(t_int *w)
+{
+  t_triangle *x = (t_triangle *)(w[1]);
+  int n = (int)(w[2]);
+  t_sample *in1 = (t_sample *)(w[3]);
+  t_sample *in2 = (t_sample *)(w[4]);
+  t_sample *out = (t_sample *)(w[5]);
+  int nchans = (int)(w[6]);
+
+  // the whole phase input is one vector, however many channels it has
+  x->x_kernels->tri(in1, NULL, in2[0], x->x_low, x->x_range, out, n * nchans);
+  return (w + 8);
 }
 
 static void triangle_dsp(t_triangle *x, t_signal **sp)
 {
-  dsp_add(triangle_perform, 5, x, sp[0]->s_length,
-          sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec);
+  t_perfroutine perform;
+  const char *path;
+  // the output gets as many channels as the phase input
+  int nchans = osc_mc_phases(&x->x_last, &x->x_nlast, osc_mc_nchans(sp[0]));
+  int simd = !x->x_bandlimit && x->x_kernels->width
+    && sp[0]->s_length >= x->x_kernels->width;
+  if (osc_signal_connected(&x->x_obj, x->x_glist, 1)) {
+    perform = x->x_bandlimit ? triangle_perform_bl
+            : simd ? triangle_perform_simd : triangle_perform;
+    path = x->x_bandlimit ? "signal peak, bandlimited"
+         : simd ? "signal peak, simd" : "signal peak";
+  } else {
+    perform = x->x_bandlimit ? triangle_perform_bl_const_peak
+            : simd ? triangle_perform_simd_const_peak
+            : triangle_perform_const_peak;
+    path = x->x_bandlimit ? "constant peak, bandlimited"
+         : simd ? "constant peak, simd" : "constant peak";
+  }
+  osc_mc_setout(&sp[2], nchans);
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(perform, 7, x, sp[0]->s_length, sp[0]->s_vec, sp[1]->s_vec,
+          sp[2]->s_vec, nchans, osc_mc_nchans(sp[1]));
+  osc_stats_dsp_end(&x->x_stats, path, sp[0]->s_length * nchans);
+}
+
+// switching the perform routine needs the DSP chain rebuilt
+static void triangle_bandlimit(t_triangle *x, t_floatarg f)
+{
+  int bl = f != 0;
+  if (bl != x->x_bandlimit) {
+    x->x_bandlimit = bl;
+    canvas_update_dsp();
+  }
+}
+
+static void triangle_kernel(t_triangle *x, t_symbol *s)
+{
+  if (osc_kernels_select(x, "triangle~", &x->x_kernels, s))
+    canvas_update_dsp();
 }
 
 static void *triangle_new(t_symbol *s, int argc, t_atom *argv)
@@ -84,6 +244,9 @@ static void *triangle_new(t_symbol *s, int argc, t_atom *argv)
   t_float tripeak = TRIANGLE_DEFPEAK;
   t_float trilo = x->x_low = TRIANGLE_DEFLO;
   t_float trihi = x->x_high = TRIANGLE_DEFHI;
+  x->x_bandlimit = 0;
+  x->x_last = NULL;
+  x->x_nlast = 0;
 
   int argnum = 0;
   while(argc > 0) {
@@ -109,6 +272,14 @@ static void *triangle_new(t_symbol *s, int argc, t_atom *argv)
         } else {
           goto errstate;
         }
+      } else if (strcmp(curarg->s_name, "@bandlimit") == 0) {
+        if (argc >= 2) {
+          x->x_bandlimit = atom_getfloatarg(1, argc, argv) != 0;
+          argc -= 2;
+          argv += 2;
+        } else {
+          goto errstate;
+        }
       } else if (strcmp(curarg->s_name, "@hi") == 0) {
         if (argc >= 2) {
           trihi = atom_getfloatarg(1, argc, argv);
@@ -127,6 +298,10 @@ static void *triangle_new(t_symbol *s, int argc, t_atom *argv)
 
   triangle_lo(x, trilo);
   triangle_hi(x, trihi);
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_kernels = osc_kernels_best();
+  osc_mc_phases(&x->x_last, &x->x_nlast, 1);
 
   x->x_peaklet = inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
   pd_float((t_pd *)x->x_peaklet, tripeak);
@@ -142,17 +317,23 @@ void *triangle_free(t_triangle *x)
 {
   inlet_free(x->x_peaklet);
   outlet_free(x->x_outlet);
+  osc_mc_freephases(x->x_last, x->x_nlast);
 
   return (void *)x;
 }
 
+static void triangle_stats(t_triangle *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "triangle~", argc, argv);
+}
+
 void triangle_tilde_setup(void)
 {
   triangle_class = class_new(gensym("triangle~"),
                              (t_newmethod)triangle_new,
                              (t_method)triangle_free,
                              sizeof(t_triangle),
-                             CLASS_DEFAULT,
+                             CLASS_DEFAULT | OSC_MC_CLASS,
                              A_GIMME, 0);
 
   class_addmethod(triangle_class, (t_method)triangle_dsp, gensym("dsp"), A_CANT, 0);
@@ -161,5 +342,11 @@ void triangle_tilde_setup(void)
                   gensym("lo"), A_DEFFLOAT, 0);
   class_addmethod(triangle_class, (t_method)triangle_hi,
                   gensym("hi"), A_DEFFLOAT, 0);
+  class_addmethod(triangle_class, (t_method)triangle_bandlimit,
+                  gensym("bandlimit"), A_FLOAT, 0);
+  class_addmethod(triangle_class, (t_method)triangle_kernel,
+                  gensym("kernel"), A_DEFSYM, 0);
+  class_addmethod(triangle_class, (t_method)triangle_stats, gensym("stats"),
+                  A_GIMME, 0);
 }
 
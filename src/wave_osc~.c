@@ -0,0 +1,263 @@
+// Band-limited wavetable oscillator: modern_osc~'s table lookup, reading from a
+// mipmap of band-limited tables (see wavetable.h) instead of the cosine.
+//
+// Every block, the fastest frequency in the block picks the level: the one
+// with the most harmonics that still all stay below Nyquist. In the last
+// quarter of each octave it fades into the next level up, and the fade follows
+// the frequency through the block, so sweeps go from one level to the next
+// without steps. Outside the fades that's one table read pair per sample, same
+// as modern_osc~; inside, two.
+//
+// [wave_osc~ 220 saw]: frequency and shape (sine, saw, square or triangle;
+// default saw), either order. Messages:
+//
+//   shape <name>
+//   harmonics <a1> <a2> ...: a shape of your own, the amplitudes of the
+//     harmonics in sine phase, like an array's `sinesum`. Scaled to +-1.
+
+#include "m_pd.h"
+#include <math.h>
+#include "wavetable.h"
+#include "connect.h"
+#include "phase.h"
+#include "kernels.h"
+#include "stats.h"
+
+#define WAVETABLE_BITS WAVETABLE_MIP_BITS
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+
+// how much of each octave is spent fading into the next level
+#define WAVE_OSC_FADE 0.25f
+
+static t_class *wave_osc_class = NULL;
+
+typedef struct _wave_osc {
+  t_object x_obj;
+  t_osc_phase x_phase; // see phase.h
+  double x_conv;
+  t_float x_f;
+  const float *x_tables; // the mipmap, shared unless it came from `harmonics`
+  float x_level; // where the last block was, see wave_osc_level()
+  t_outlet *x_outlet;
+  t_glist *x_glist; // for checking what's connected, see connect.h
+  const t_osc_kernels *x_kernels; // see kernels.h
+  t_osc_stats x_stats; // see stats.h
+} t_wave_osc;
+
+// Where in the mipmap a phase increment of `inc` per sample belongs: the
+// integer part is the level, the fraction how far through that level's octave
+// it is. Level k is alias-free below 2^k / WAVETABLE_SIZE cycles per sample,
+// so anything above log2(cycles * WAVETABLE_SIZE) would do; the + 1 keeps the
+// level it fades into on the safe side too. A frequency that isn't a number
+// gets the top level, which is safe for any increment; that check comes
+// first, as under -ffast-math the clamps can't be trusted with NaN, and
+// (int)NaN as the level would index anywhere.
+static float wave_osc_level(double inc)
+{
+  if (!osc_phase_finite(inc)) return WAVETABLE_MIP_LEVELS - 1;
+  float l = (float)(log2(inc * (WAVETABLE_SIZE / OSC_PHASE_CYCLE)) + 1.0);
+  l = l > 0.0f ? l : 0.0f; // also catches 0 Hz (-inf)
+  return l < WAVETABLE_MIP_LEVELS - 1 ? l : WAVETABLE_MIP_LEVELS - 1;
+}
+
+// how much of the next level up to mix in, f of the way through an octave
+static float wave_osc_fade(float f)
+{
+  f = (f - (1.0f - WAVE_OSC_FADE)) * (1.0f / WAVE_OSC_FADE);
+  return f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f;
+}
+
+// a + w * (b - a), w going up by dw per sample; a == b reads one table only
+static t_osc_phase wave_osc_read(const float *a, const float *b,
+  t_osc_phase phase, const t_sample *in, double conv, t_osc_phase inc,
+  float w, float dw, t_sample *out, int n)
+{
+  while (n--) {
+    uint32_t idx = osc_phase_index(phase, WAVETABLE_BITS);
+    float frac = osc_phase_frac(phase, WAVETABLE_BITS);
+    float fa = a[idx] + frac * (a[idx + 1] - a[idx]);
+    if (a != b) {
+      float fb = b[idx] + frac * (b[idx + 1] - b[idx]);
+      fa += w * (fb - fa);
+      w += dw;
+    }
+    *out++ = fa;
+    phase += in ? osc_phase_wrap(*in++ * conv) : inc;
+  }
+  return phase;
+}
+
+// freq_signal is a constant in both performs below
+static inline t_int *wave_osc_perform_body(t_int *w, const int freq_signal)
+{
+  t_wave_osc *x = (t_wave_osc *)(w[1]);
+  t_sample *in = (t_sample *)(w[2]);
+  t_sample *out = (t_sample *)(w[3]);
+  int n = (int)(w[4]);
+
+  const float *tabs = x->x_tables;
+  const t_osc_kernels *kern = x->x_kernels;
+  double conv = x->x_conv;
+  t_osc_phase inc = osc_phase_wrap(in[0] * conv);
+  float fmax = fabsf(in[0]);
+
+  if (!tabs) {
+    while (n--) *out++ = 0;
+    return (w + 5);
+  }
+
+  // the level has to suit the fastest the phase moves in this block
+  if (freq_signal) {
+    for (int i = 1; i < n; i++) {
+      float f = fabsf(in[i]);
+      fmax = f > fmax ? f : fmax;
+    }
+  }
+  float level = wave_osc_level(fmax * conv);
+  int k = (int)level;
+  // the fade is ramped from where the last block left it; if that was in
+  // another level, it's 0 or 1 here, which is the same table
+  float w0 = wave_osc_fade(x->x_level - k);
+  float w1 = wave_osc_fade(level - k);
+  const float *a = tabs + k * WAVETABLE_MIP_STRIDE;
+  const float *b = k + 1 < WAVETABLE_MIP_LEVELS ? a + WAVETABLE_MIP_STRIDE : a;
+  x->x_level = level;
+
+  // outside the fades there's only one table to read
+  if (w0 == w1 && (w0 == 0.0f || w0 == 1.0f)) {
+    a = w0 == 0.0f ? a : b;
+    b = a;
+  }
+
+  if (!kern->width) {
+    x->x_phase = wave_osc_read(a, b, x->x_phase, freq_signal ? in : NULL, conv,
+                               inc, w0, (w1 - w0) / n, out, n);
+  } else if (a == b) {
+    x->x_phase = freq_signal
+      ? kern->lerp(a, WAVETABLE_BITS, x->x_phase, in, conv, out, n)
+      : kern->lerp_const(a, WAVETABLE_BITS, x->x_phase, inc, out, n);
+  } else {
+    x->x_phase = kern->xfade(a, b, WAVETABLE_BITS, x->x_phase,
+                             freq_signal ? in : NULL, conv, inc, w0,
+                             (w1 - w0) / n, out, n);
+  }
+
+  return (w + 5);
+}
+
+static t_int *wave_osc_perform(t_int *w)
+{
+  return wave_osc_perform_body(w, 1);
+}
+
+// the frequency inlet only gets floats
+static t_int *wave_osc_perform_const(t_int *w)
+{
+  return wave_osc_perform_body(w, 0);
+}
+
+static void wave_osc_dsp(t_wave_osc *x, t_signal **sp)
+{
+  int freq_signal = osc_signal_connected(&x->x_obj, x->x_glist, 0);
+
+  x->x_conv = osc_phase_conv(sp[0]->s_sr);
+  osc_stats_dsp_begin(&x->x_stats);
+  dsp_add(freq_signal ? wave_osc_perform : wave_osc_perform_const,
+          4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_length);
+  osc_stats_dsp_end(&x->x_stats,
+                    freq_signal ? "signal frequency" : "constant frequency",
+                    sp[0]->s_length);
+}
+
+static void wave_osc_settables(t_wave_osc *x, const float *tables)
+{
+  if (!tables) return; // keep the old ones, the registry has complained
+  wavetable_release(x->x_tables);
+  x->x_tables = tables;
+}
+
+static void wave_osc_shape(t_wave_osc *x, t_symbol *s)
+{
+  int shape = wavetable_shape_find(s->s_name);
+  if (shape < 0) {
+    pd_error(x, "wave_osc~: no shape '%s' (sine, saw, square, triangle)",
+             s->s_name);
+    return;
+  }
+  wave_osc_settables(x, wavetable_mip_acquire((t_wavetable_shape)shape));
+}
+
+static void wave_osc_harmonics(t_wave_osc *x, t_symbol *s, int argc,
+                               t_atom *argv)
+{
+  float *amps;
+  if (argc < 1) {
+    pd_error(x, "wave_osc~: harmonics needs at least one amplitude");
+    return;
+  }
+  if (!(amps = (float *)getbytes(argc * sizeof(float)))) return;
+  for (int i = 0; i < argc; i++) amps[i] = atom_getfloatarg(i, argc, argv);
+  wave_osc_settables(x, wavetable_mip_build(amps, argc));
+  freebytes(amps, argc * sizeof(float));
+}
+
+static void wave_osc_kernel(t_wave_osc *x, t_symbol *s)
+{
+  osc_kernels_select(x, "wave_osc~", &x->x_kernels, s);
+}
+
+static void *wave_osc_new(t_symbol *s, int argc, t_atom *argv)
+{
+  t_wave_osc *x = (t_wave_osc *)pd_new(wave_osc_class);
+  t_symbol *shape = gensym("saw");
+
+  x->x_phase = 0;
+  x->x_f = 220;
+  x->x_level = 0;
+  x->x_tables = NULL;
+  x->x_glist = canvas_getcurrent();
+  osc_stats_init(&x->x_stats);
+  x->x_kernels = osc_kernels_best();
+
+  for (int i = 0; i < argc; i++) {
+    if (argv[i].a_type == A_FLOAT) x->x_f = atom_getfloatarg(i, argc, argv);
+    else shape = atom_getsymbolarg(i, argc, argv);
+  }
+  wave_osc_shape(x, shape);
+  if (!x->x_tables) wave_osc_shape(x, gensym("saw"));
+
+  x->x_outlet = outlet_new(&x->x_obj, &s_signal);
+  return (void *)x;
+}
+
+static void wave_osc_free(t_wave_osc *x)
+{
+  outlet_free(x->x_outlet);
+  wavetable_release(x->x_tables);
+}
+
+static void wave_osc_stats(t_wave_osc *x, t_symbol *s, int argc, t_atom *argv)
+{
+  osc_stats_message(&x->x_stats, x, "wave_osc~", argc, argv);
+}
+
+void wave_osc_tilde_setup(void)
+{
+  wave_osc_class = class_new(gensym("wave_osc~"),
+                             (t_newmethod)wave_osc_new,
+                             (t_method)wave_osc_free,
+                             sizeof(t_wave_osc),
+                             CLASS_DEFAULT,
+                             A_GIMME, 0);
+
+  class_addmethod(wave_osc_class, (t_method)wave_osc_dsp, gensym("dsp"), A_CANT, 0);
+  CLASS_MAINSIGNALIN(wave_osc_class, t_wave_osc, x_f);
+  class_addmethod(wave_osc_class, (t_method)wave_osc_shape, gensym("shape"),
+                  A_SYMBOL, 0);
+  class_addmethod(wave_osc_class, (t_method)wave_osc_harmonics,
+                  gensym("harmonics"), A_GIMME, 0);
+  class_addmethod(wave_osc_class, (t_method)wave_osc_kernel, gensym("kernel"),
+                  A_DEFSYM, 0);
+  class_addmethod(wave_osc_class, (t_method)wave_osc_stats, gensym("stats"),
+                  A_GIMME, 0);
+}
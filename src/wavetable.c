@@ -0,0 +1,295 @@
+// See wavetable.h
+
+#include "m_pd.h"
+#include "wavetable.h"
+#include "wavetable_gen.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WAVETABLE_HUGEPAGES) && defined(__linux__)
+# include <sys/mman.h>
+# define WAVETABLE_USE_ARENA 1
+#else
+# define WAVETABLE_USE_ARENA 0
+#endif
+
+#ifdef _WIN32
+# include <malloc.h>
+#endif
+
+// w_kind of the cosine tables and of one-off mipmaps (the built-in shapes are
+// all in wavetable_data.c)
+#define WAVETABLE_KIND_COS -1
+#define WAVETABLE_KIND_USER -2
+
+static const char *wavetable_shape_names[WAVETABLE_NSHAPES] = {
+  "sine", "saw", "square", "triangle"
+};
+
+typedef struct _wavetable
+{
+  int w_kind;
+  int w_size;
+  t_wavetable_layout w_layout;
+  int w_refcount;
+  float *w_tab; // what the classes index, inside w_mem
+  void *w_mem;
+  size_t w_bytes;
+  int w_inarena;
+  struct _wavetable *w_next;
+} t_wavetable;
+
+static t_wavetable *wavetable_list = NULL;
+
+#if WAVETABLE_USE_ARENA
+
+#define WAVETABLE_ARENA_SIZE (2 * 1024 * 1024)
+
+// Bump allocator over one 2MB region. Tables don't get their space back
+// individually; the whole arena is unmapped once the last table in it is
+// released. Everything in this library fits with room to spare.
+static char *arena = NULL;
+static size_t arena_used = 0;
+static int arena_tables = 0;
+
+static int arena_map(void)
+{
+  void *p;
+# ifdef MAP_HUGETLB
+  // explicit huge pages, if the admin has reserved some
+  p = mmap(NULL, WAVETABLE_ARENA_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    arena = (char *)p;
+    return 1;
+  }
+# endif
+  // otherwise ask for a transparent huge page: map twice the size and trim it
+  // to a 2MB boundary, since THP only backs aligned ranges
+  p = mmap(NULL, 2 * WAVETABLE_ARENA_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) return 0;
+  {
+    char *start = (char *)p;
+    char *aligned = (char *)(((size_t)start + WAVETABLE_ARENA_SIZE - 1)
+                             & ~(size_t)(WAVETABLE_ARENA_SIZE - 1));
+    if (aligned > start) munmap(start, aligned - start);
+    munmap(aligned + WAVETABLE_ARENA_SIZE,
+           start + 2 * WAVETABLE_ARENA_SIZE - (aligned + WAVETABLE_ARENA_SIZE));
+    arena = aligned;
+  }
+# ifdef MADV_HUGEPAGE
+  madvise(arena, WAVETABLE_ARENA_SIZE, MADV_HUGEPAGE);
+# endif
+  return 1;
+}
+
+static void *arena_alloc(size_t bytes, size_t align)
+{
+  size_t start = (arena_used + align - 1) & ~(align - 1);
+  if (!arena && !arena_map()) return NULL;
+  if (start + bytes > WAVETABLE_ARENA_SIZE) return NULL;
+  arena_used = start + bytes;
+  arena_tables++;
+  return arena + start;
+}
+
+static void arena_free(void)
+{
+  if (--arena_tables == 0) {
+    munmap(arena, WAVETABLE_ARENA_SIZE);
+    arena = NULL;
+    arena_used = 0;
+  }
+}
+
+#endif // WAVETABLE_USE_ARENA
+
+static void *wavetable_alloc(t_wavetable *wt, size_t bytes, size_t align)
+{
+  void *mem = NULL;
+
+#if WAVETABLE_USE_ARENA
+  if ((mem = arena_alloc(bytes, align))) {
+    wt->w_inarena = 1;
+    return mem;
+  }
+#else
+  (void)wt;
+#endif
+#ifdef _WIN32
+  mem = _aligned_malloc(bytes, align);
+#else
+  if (posix_memalign(&mem, align, bytes)) mem = NULL;
+#endif
+  return mem;
+}
+
+static void wavetable_dealloc(t_wavetable *wt)
+{
+#if WAVETABLE_USE_ARENA
+  if (wt->w_inarena) {
+    arena_free();
+    return;
+  }
+#endif
+#ifdef _WIN32
+  _aligned_free(wt->w_mem);
+#else
+  free(wt->w_mem);
+#endif
+}
+
+// allocate a table of `size` points plus the guard points for `layout`, or
+// `levels` of them WAVETABLE_MIP_STRIDE apart for a mipmap; not filled in yet
+static t_wavetable *wavetable_new(int kind, int size, t_wavetable_layout layout,
+                                  int levels)
+{
+  t_wavetable *wt;
+  int first, last; // guard points: tab[first] .. tab[last] are valid
+  size_t align, lead, points;
+
+  if (layout == WAVETABLE_CUBIC) {
+    first = -1;
+    last = size + 1;
+  } else {
+    first = 0;
+    last = size;
+  }
+  points = levels > 1 ? (size_t)levels * WAVETABLE_MIP_STRIDE
+                      : (size_t)(last + 1);
+
+  wt = (t_wavetable *)getbytes(sizeof(t_wavetable));
+  if (!wt) return NULL;
+  wt->w_kind = kind;
+  wt->w_size = size;
+  wt->w_layout = layout;
+  // leading guard points get a whole alignment unit in front of tab[0], so
+  // tab[0] itself stays aligned
+  align = sizeof(float) * size >= WAVETABLE_PAGE ? WAVETABLE_PAGE
+                                                 : WAVETABLE_CACHELINE;
+  lead = first < 0 ? align / sizeof(float) : 0;
+  wt->w_bytes = sizeof(float) * (lead + points);
+  wt->w_mem = wavetable_alloc(wt, wt->w_bytes, align);
+  if (!wt->w_mem) {
+    pd_error(NULL, "oscillators: failed to allocate memory for %s",
+             kind == WAVETABLE_KIND_COS ? "cosine table" : "wavetables");
+    freebytes(wt, sizeof(t_wavetable));
+    return NULL;
+  }
+  wt->w_tab = (float *)wt->w_mem + lead;
+  wt->w_refcount = 1;
+  return wt;
+}
+
+static void wavetable_post(const char *what, t_wavetable *wt)
+{
+  if (wt->w_kind == WAVETABLE_KIND_COS) {
+    post("oscillators: %s cosine table of size %d%s", what, wt->w_size,
+         wt->w_inarena ? " (huge page arena)" : "");
+  }
+  // one-off mipmaps come and go with their object, no need to say so
+}
+
+const float *wavetable_cos_acquire(int size, t_wavetable_layout layout)
+{
+  t_wavetable *wt;
+  int first, last;
+
+  // the sizes the classes use were built with the library
+  for (const t_wavetable_builtin *b = wavetable_builtin_cos; b->size; b++) {
+    if (b->size == size) return b->tab;
+  }
+
+  for (wt = wavetable_list; wt; wt = wt->w_next) {
+    if (wt->w_kind == WAVETABLE_KIND_COS && wt->w_size == size
+        && wt->w_layout == layout) {
+      wt->w_refcount++;
+      return wt->w_tab;
+    }
+  }
+
+  if (!(wt = wavetable_new(WAVETABLE_KIND_COS, size, layout, 1))) return NULL;
+
+  first = layout == WAVETABLE_CUBIC ? -1 : 0;
+  last = layout == WAVETABLE_CUBIC ? size + 1 : size;
+  for (int i = first; i <= last; i++) wt->w_tab[i] = wavetable_gen_cos(i, size);
+
+  wt->w_next = wavetable_list;
+  wavetable_list = wt;
+  wavetable_post("initialized", wt);
+  return wt->w_tab;
+}
+
+// see wavetable_gen_mip()
+static int wavetable_mip_fill(float *tab, const float *amps, int n)
+{
+  int size = WAVETABLE_MIP_SIZE;
+  double *sine = (double *)getbytes(size * sizeof(double));
+  double *acc = (double *)getbytes(size * sizeof(double));
+
+  if (!sine || !acc) {
+    if (sine) freebytes(sine, size * sizeof(double));
+    if (acc) freebytes(acc, size * sizeof(double));
+    return 0;
+  }
+  wavetable_gen_mip(tab, amps, n, sine, acc);
+  freebytes(sine, size * sizeof(double));
+  freebytes(acc, size * sizeof(double));
+  return 1;
+}
+
+static const float *wavetable_mip_new(int kind, const float *amps, int n)
+{
+  t_wavetable *wt = wavetable_new(kind, WAVETABLE_MIP_SIZE, WAVETABLE_LINEAR,
+                                  WAVETABLE_MIP_LEVELS);
+  if (!wt) return NULL;
+  if (!wavetable_mip_fill(wt->w_tab, amps, n)) {
+    pd_error(NULL, "oscillators: failed to allocate memory for wavetables");
+    wavetable_dealloc(wt);
+    freebytes(wt, sizeof(t_wavetable));
+    return NULL;
+  }
+  wt->w_next = wavetable_list;
+  wavetable_list = wt;
+  wavetable_post("initialized", wt);
+  return wt->w_tab;
+}
+
+int wavetable_shape_find(const char *name)
+{
+  for (int i = 0; i < WAVETABLE_NSHAPES; i++) {
+    if (!strcmp(name, wavetable_shape_names[i])) return i;
+  }
+  return -1;
+}
+
+const float *wavetable_mip_acquire(t_wavetable_shape shape)
+{
+  if (shape < 0 || shape >= WAVETABLE_NSHAPES) return NULL;
+  return wavetable_builtin_mip[shape];
+}
+
+const float *wavetable_mip_build(const float *amps, int n)
+{
+  return wavetable_mip_new(WAVETABLE_KIND_USER, amps, n);
+}
+
+void wavetable_release(const float *tab)
+{
+  t_wavetable **wp;
+
+  if (!tab) return;
+  for (wp = &wavetable_list; *wp; wp = &(*wp)->w_next) {
+    t_wavetable *wt = *wp;
+    if (wt->w_tab != tab) continue;
+    if (--wt->w_refcount <= 0) {
+      *wp = wt->w_next;
+      wavetable_post("freed", wt);
+      wavetable_dealloc(wt);
+      freebytes(wt, sizeof(t_wavetable));
+    }
+    return;
+  }
+  // not in the list: one of the built-in ones, which are never freed
+}
@@ -0,0 +1,74 @@
+// Library-wide registry of wavetables.
+//
+// Every class in the oscillators library gets its tables from here instead of
+// building its own, so two classes that use the same size and layout share one
+// copy (and stop evicting each other's copy from the cache). Tables are
+// reference counted: acquire one per instance and release it in the free
+// method. The registry lives in the shared library (see `shared.sources` in the
+// Makefile), so the sharing works across the separate class binaries too.
+//
+// The tables the classes use by default (the cosines of the sizes they ask
+// for, and the built-in shapes' mipmaps) are computed at build time by
+// wavetable_gen.c and compiled in as const data. They sit in the library's
+// read-only pages, which every Pd process on the machine shares, and getting
+// one costs nothing. Only other sizes and `harmonics` mipmaps are computed
+// (and allocated) at run time. Either way they're read-only.
+
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+// where the guard points go around the `size` points of one cycle
+typedef enum _wavetable_layout
+{
+  // size + 1 points, tab[size] == tab[0]: linear interpolation reads idx + 1
+  // without masking
+  WAVETABLE_LINEAR,
+  // tab[-1] and tab[size], tab[size + 1] are valid too, for 4-point (cubic)
+  // interpolation
+  WAVETABLE_CUBIC
+} t_wavetable_layout;
+
+// one cycle of cos() over `size` (a power of 2) points; NULL if the allocation
+// fails. tab[0] is aligned to a cache line, and tables of a page or more to a
+// page. Built with -DWAVETABLE_HUGEPAGES, the tables made at run time come out
+// of a 2MB arena backed by a huge page where the OS allows it, so all of them
+// share one TLB entry.
+const float *wavetable_cos_acquire(int size, t_wavetable_layout layout);
+
+// Band-limited waveforms for wave_osc~, as a stack ("mipmap") of tables, one
+// per octave. Level k holds the harmonics up to WAVETABLE_MIP_SIZE >> (k + 1),
+// so it's alias-free for increments below 2^k / WAVETABLE_MIP_SIZE cycles per
+// sample; the last level is just the fundamental. Every level is
+// WAVETABLE_MIP_SIZE points with a guard point like WAVETABLE_LINEAR, and
+// level k starts at tab + k * WAVETABLE_MIP_STRIDE. All levels are scaled by
+// the same amount so that none of them goes past +-1.
+#define WAVETABLE_MIP_BITS 11
+#define WAVETABLE_MIP_SIZE (1 << WAVETABLE_MIP_BITS)
+#define WAVETABLE_MIP_LEVELS WAVETABLE_MIP_BITS
+// size + guard point, rounded up so every level starts on a cache line
+#define WAVETABLE_MIP_STRIDE (WAVETABLE_MIP_SIZE + 16)
+
+typedef enum _wavetable_shape
+{
+  WAVETABLE_SINE,
+  WAVETABLE_SAW, // rising, jumps at phase 0
+  WAVETABLE_SQUARE, // high for the first half
+  WAVETABLE_TRIANGLE, // 0 at phase 0, peaks at 1/4
+  WAVETABLE_NSHAPES
+} t_wavetable_shape;
+
+// the shape called `name` ("saw" etc.), or -1 if there's none
+int wavetable_shape_find(const char *name);
+
+// the mipmap for one of the built-in shapes, shared like the cosine tables
+const float *wavetable_mip_acquire(t_wavetable_shape shape);
+
+// a mipmap of your own: amps[h - 1] is the amplitude of harmonic h, all in
+// sine phase like Pd's `sinesum`. Harmonics past WAVETABLE_MIP_SIZE / 2 - 1
+// are ignored. Not shared with anyone, but released the same way.
+const float *wavetable_mip_build(const float *amps, int n);
+
+// drop one reference; the table is freed with the last one
+void wavetable_release(const float *tab);
+
+#endif
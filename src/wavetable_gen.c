@@ -0,0 +1,104 @@
+// Writes wavetable_data.c: the cosine tables the classes use and the mipmaps
+// of the built-in shapes, as const arrays, so they end up in the library's
+// .rodata. Run by the Makefile at build time, not part of the library.
+//
+// Usage: wavetable_gen > wavetable_data.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "wavetable_gen.h"
+
+// the sizes the classes ask wavetable_cos_acquire() for
+static const int cos_bits[] = {12, 14, 16};
+#define NCOS (int)(sizeof(cos_bits) / sizeof(cos_bits[0]))
+
+static const char *shape_names[WAVETABLE_NSHAPES] = {
+  "sine", "saw", "square", "triangle"
+};
+
+// hex floats, so the compiler reads back exactly what was computed
+static void print_points(const float *p, int n)
+{
+  for (int i = 0; i < n; i++) {
+    printf("%s%af,", i % 4 ? " " : "\n  ", (double)p[i]);
+  }
+  printf("\n};\n\n");
+}
+
+// like wavetable.c allocates them
+static int cos_align(int size)
+{
+  return size * (int)sizeof(float) >= WAVETABLE_PAGE ? WAVETABLE_PAGE
+                                                     : WAVETABLE_CACHELINE;
+}
+
+static int print_cos(int bits)
+{
+  int size = 1 << bits;
+  int align = cos_align(size);
+  // tab[-1] gets a whole alignment unit in front of tab[0], so tab[0] itself
+  // stays aligned
+  int lead = align / (int)sizeof(float);
+  int n = lead + size + 2;
+  float *p = (float *)calloc(n, sizeof(float));
+
+  if (!p) return 0;
+  for (int i = -1; i <= size + 1; i++) p[lead + i] = wavetable_gen_cos(i, size);
+  printf("WAVETABLE_ALIGNED(%d) static const float wavetable_cos_%d[%d] = {",
+         align, bits, n);
+  print_points(p, n);
+  free(p);
+  return 1;
+}
+
+static int print_mip(t_wavetable_shape shape)
+{
+  int n = WAVETABLE_MIP_SIZE / 2 - 1;
+  int points = WAVETABLE_MIP_LEVELS * WAVETABLE_MIP_STRIDE;
+  float *amps = (float *)calloc(n, sizeof(float));
+  double *sine = (double *)calloc(WAVETABLE_MIP_SIZE, sizeof(double));
+  double *acc = (double *)calloc(WAVETABLE_MIP_SIZE, sizeof(double));
+  float *tab = (float *)calloc(points, sizeof(float));
+
+  if (!amps || !sine || !acc || !tab) return 0;
+  wavetable_gen_shape(shape, amps, n);
+  wavetable_gen_mip(tab, amps, n, sine, acc);
+  printf("WAVETABLE_ALIGNED(%d) static const float wavetable_mip_%s[%d] = {",
+         WAVETABLE_PAGE, shape_names[shape], points);
+  print_points(tab, points);
+  free(amps);
+  free(sine);
+  free(acc);
+  free(tab);
+  return 1;
+}
+
+int main(void)
+{
+  printf("// Generated by wavetable_gen.c at build time, don't edit.\n\n"
+         "#include \"wavetable_gen.h\"\n\n");
+  for (int i = 0; i < NCOS; i++) {
+    if (!print_cos(cos_bits[i])) goto nomem;
+  }
+  for (int s = 0; s < WAVETABLE_NSHAPES; s++) {
+    if (!print_mip((t_wavetable_shape)s)) goto nomem;
+  }
+
+  printf("const t_wavetable_builtin wavetable_builtin_cos[] = {\n");
+  for (int i = 0; i < NCOS; i++) {
+    int size = 1 << cos_bits[i];
+    printf("  {%d, wavetable_cos_%d + %d},\n", size, cos_bits[i],
+           cos_align(size) / (int)sizeof(float));
+  }
+  printf("  {0, 0}\n};\n\n");
+
+  printf("const float *const wavetable_builtin_mip[WAVETABLE_NSHAPES] = {\n");
+  for (int s = 0; s < WAVETABLE_NSHAPES; s++) {
+    printf("  wavetable_mip_%s,\n", shape_names[s]);
+  }
+  printf("};\n");
+  return 0;
+nomem:
+  fprintf(stderr, "wavetable_gen: out of memory\n");
+  return 1;
+}
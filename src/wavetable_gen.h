@@ -0,0 +1,109 @@
+// How the library's tables are computed, shared by the build-time generator
+// (wavetable_gen.c, which writes the built-in tables into wavetable_data.c)
+// and wavetable.c (which still computes whatever the build didn't make: odd
+// cosine sizes and `harmonics` mipmaps). Keeping the arithmetic in one place
+// is what makes the two come out the same to the bit. Nothing here needs Pd,
+// since the generator runs without it.
+
+#ifndef WAVETABLE_GEN_H
+#define WAVETABLE_GEN_H
+
+#include <math.h>
+#include "wavetable.h"
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+// tab[0] of a table of a page or more starts a page, smaller ones a cache line
+#define WAVETABLE_CACHELINE 64
+#define WAVETABLE_PAGE 4096
+
+#ifdef _MSC_VER
+# define WAVETABLE_ALIGNED(n) __declspec(align(n))
+#else
+# define WAVETABLE_ALIGNED(n) __attribute__((aligned(n)))
+#endif
+
+// The tables in wavetable_data.c, all in .rodata. The cosines are in the
+// WAVETABLE_CUBIC layout, which has the WAVETABLE_LINEAR guard point too, so
+// one table does for both; the list ends with a size of 0.
+typedef struct _wavetable_builtin
+{
+  int size;
+  const float *tab;
+} t_wavetable_builtin;
+
+extern const t_wavetable_builtin wavetable_builtin_cos[];
+extern const float *const wavetable_builtin_mip[WAVETABLE_NSHAPES];
+
+// point i of a cosine table of `size` points; the guard points (i = -1, size,
+// size + 1) come from the wrapped index, so they're exactly equal to the
+// points they stand in for
+static inline float wavetable_gen_cos(int i, int size)
+{
+  int j = i & (size - 1);
+  return (float)cos((j * 2.0 * M_PI) / size);
+}
+
+// the Fourier series of a built-in shape, leaving the overall scale to
+// wavetable_gen_mip()
+static inline void wavetable_gen_shape(t_wavetable_shape shape, float *amps,
+                                       int n)
+{
+  for (int h = 1; h <= n; h++) {
+    float a;
+    switch (shape) {
+      case WAVETABLE_SAW: a = -1.0f / h; break;
+      case WAVETABLE_SQUARE: a = h & 1 ? 1.0f / h : 0.0f; break;
+      case WAVETABLE_TRIANGLE:
+        a = h & 1 ? ((h & 2) ? -1.0f : 1.0f) / ((float)h * h) : 0.0f;
+        break;
+      default: a = h == 1; break;
+    }
+    amps[h - 1] = a;
+  }
+}
+
+// Fill in all the levels of a mipmap, starting from the top (fewest harmonics)
+// and adding the ones each level further down gets on top of the level above.
+// Harmonic h at point j is sine[h * j mod size], exactly, so every harmonic
+// costs a multiply-add per point and no sin() calls. `sine` and `acc` are
+// WAVETABLE_MIP_SIZE doubles of scratch, `acc` all zeros.
+static inline void wavetable_gen_mip(float *tab, const float *amps, int n,
+                                     double *sine, double *acc)
+{
+  int size = WAVETABLE_MIP_SIZE;
+  double peak = 0;
+  int h = 1;
+
+  for (int j = 0; j < size; j++) sine[j] = sin((j * 2.0 * M_PI) / size);
+  if (n > size / 2 - 1) n = size / 2 - 1;
+
+  for (int k = WAVETABLE_MIP_LEVELS - 1; k >= 0; k--) {
+    float *level = tab + k * WAVETABLE_MIP_STRIDE;
+    int top = size >> (k + 1);
+    for (; h <= top && h <= n; h++) {
+      if (amps[h - 1] == 0) continue;
+      for (int j = 0; j < size; j++) {
+        acc[j] += amps[h - 1] * sine[(h * j) & (size - 1)];
+      }
+    }
+    for (int j = 0; j < size; j++) {
+      level[j] = (float)acc[j];
+      if (fabs(acc[j]) > peak) peak = fabs(acc[j]);
+    }
+  }
+
+  // every level gets the same scaling, so switching levels doesn't change the
+  // loudness
+  for (int k = 0; k < WAVETABLE_MIP_LEVELS; k++) {
+    float *level = tab + k * WAVETABLE_MIP_STRIDE;
+    if (peak > 0) {
+      for (int j = 0; j < size; j++) level[j] = (float)(level[j] / peak);
+    }
+    level[size] = level[0];
+  }
+}
+
+#endif